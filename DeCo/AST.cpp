@@ -0,0 +1,118 @@
+#include "AST.h"
+
+static_assert(sizeof(Node) <= 32, "AST nodes should stay compact");
+
+static const char* kindNames[] = {
+    "PROGRAM", "VAR_DECL", "NAME", "TYPE", "FUNC_DECL", "PARAM", "BLOCK",
+    "ASSIGN", "CALL", "IF", "WHILE", "DO_WHILE", "REPEAT", "FOR", "RETURN",
+    "BINARY", "NOT", "LITERAL", "DESIGNATOR", "EMPTY",
+};
+
+static_assert(sizeof(kindNames) / sizeof(kindNames[0]) == Node::SIZE, "Missing node kind name");
+
+// NODE ========================================================================
+
+size_t Node::childCount() const {
+    size_t count = 0;
+    for (Node* c = child; c; c = c->next) {
+        count++;
+    }
+    return count;
+}
+
+Node* Node::childAt(size_t i) const {
+    Node* c = child;
+    for (; c && i > 0; i--) {
+        c = c->next;
+    }
+    return c;
+}
+
+// COMPILATION UNIT ============================================================
+
+// Programs average about two nodes for every three tokens; start the arena
+// with room for a little more than that so most files fit in a single block
+CompilationUnit::CompilationUnit(TokenStream ts)
+    : _tokens(std::move(ts)), arena(_tokens.size() * sizeof(Node) * 3 / 4), _root(nullptr), nodeCount(0) {}
+
+const char* CompilationUnit::kindName(Node::Kind kind) {
+    return kindNames[kind];
+}
+
+std::string_view CompilationUnit::text(const Node* n) const {
+    std::string_view lex = _tokens.lexeme(n->tok);
+    if (n->kind == Node::LITERAL && (n->aux & Node::SPLIT_SIGN)) {
+        lex.remove_prefix(1);
+    }
+    return lex;
+}
+
+int CompilationUnit::charPosition(const Node* n) const {
+    int charPos = _tokens.charPosition(n->tok);
+    if (n->kind == Node::LITERAL && (n->aux & Node::SPLIT_SIGN)) {
+        charPos++;
+    }
+    return charPos;
+}
+
+// PRINTING ====================================================================
+
+void CompilationUnit::print(std::ostream& out, const Node* n, int depth) const {
+    out << std::string(depth * 2, ' ') << kindName(n->kind);
+
+    switch (n->kind) {
+        case Node::PROGRAM:
+        case Node::BLOCK:
+        case Node::IF:
+        case Node::WHILE:
+        case Node::DO_WHILE:
+        case Node::REPEAT:
+        case Node::FOR:
+        case Node::RETURN:
+        case Node::NOT:
+        case Node::EMPTY:
+            break;
+        case Node::TYPE:
+            out << " " << Token::spelling(n->opKind());
+            for (int i = 0; i < n->aux; i++) {
+                out << "[]";
+            }
+            break;
+        case Node::FUNC_DECL:
+            out << " " << text(n) << " : " << Token::spelling(n->opKind());
+            break;
+        case Node::ASSIGN:
+        case Node::BINARY:
+            out << " " << Token::spelling(n->opKind());
+            break;
+        default:
+            out << " " << text(n);
+            break;
+    }
+    out << " (" << lineNumber(n) << "," << charPosition(n) << ")\n";
+
+    for (const Node* c = n->child; c; c = c->next) {
+        print(out, c, depth + 1);
+    }
+}
+
+void CompilationUnit::printTree(std::ostream& out) const {
+    if (_root) {
+        print(out, _root, 0);
+    }
+}
+
+void CompilationUnit::printMemoryReport(std::ostream& out) const {
+    size_t tokenCount = _tokens.size();
+    size_t tokenBytes = _tokens.bytesUsed();
+    size_t treeBytes = arena.bytesUsed();
+    double perToken = tokenCount ? 1.0 / tokenCount : 0;
+
+    out << "MEMORY REPORT:" << std::endl;
+    out << "--------------------------------------------------------------------" << std::endl;
+    out << "Source: " << _tokens.buffer()->size() << " bytes, " << tokenCount << " tokens\n";
+    out << "Tokens: " << tokenBytes << " bytes (" << tokenBytes * perToken << " per token)\n";
+    out << "AST:    " << nodeCount << " nodes, " << treeBytes << " bytes used, "
+        << arena.bytesReserved() << " reserved (" << treeBytes * perToken << " per token)\n";
+    out << "Total:  " << (tokenBytes + treeBytes) * perToken << " bytes per token" << std::endl;
+}
@@ -0,0 +1,143 @@
+#ifndef _AST_H_
+#define _AST_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include "Arena.h"
+#include "Scanner.h"
+#include "SymbolTable.h"
+#include "TokenStream.h"
+#include "Types.h"
+
+// A node of the abstract syntax tree. Nodes are 32 bytes, tagged by kind, and
+// link to their children as a first-child/next-sibling list. Everything else
+// is found through the token the node was built from, or through its symbol
+// (-1 for nodes without one, and for names that could not be resolved).
+//
+//  Kind        op                  aux                 tok         children
+//  ----------- ------------------- ------------------- ----------- -----------------------------
+//  PROGRAM                                             first token declarations, then main
+//  VAR_DECL                                            first name  TYPE, NAME...
+//  NAME                                                ident
+//  TYPE        BOOL, INT, FLOAT    unsized dimensions  type        LITERAL per sized dimension
+//  FUNC_DECL   return type         parameter count     ident       PARAM..., BLOCK
+//  PARAM                                               ident       TYPE
+//  BLOCK                                               "{"         statements
+//  ASSIGN      assign/unary op                         operator    DESIGNATOR, [ expression ]
+//  CALL                            argument count      ident       arguments
+//  IF                                                  "if"        condition, BLOCK, [ BLOCK ]
+//  WHILE                                               "while"     condition, BLOCK
+//  DO_WHILE                                            "do"        BLOCK, condition
+//  REPEAT                                              "repeat"    BLOCK, condition
+//  FOR                                                 "for"       init, condition, update, BLOCK
+//  RETURN                                              "return"    [ expression ]
+//  BINARY      operator                                operator    left, right
+//  NOT                                                 "!"         operand
+//  LITERAL     token kind          SPLIT_SIGN          literal
+//  DESIGNATOR                      index count         ident       index expressions
+//  EMPTY                                                           (missing part of a for loop)
+//
+// sym is the symbol declared by NAME, PARAM and FUNC_DECL nodes, and the one
+// a DESIGNATOR or CALL resolved to. Literal token kinds are INT_VAL,
+// FLOAT_VAL, TRUE and FALSE. Parentheses leave no node behind. main is stored
+// as a FUNC_DECL with a VOID return type and no parameters.
+struct Node {
+    enum Kind : uint8_t {
+        PROGRAM, VAR_DECL, NAME, TYPE, FUNC_DECL, PARAM, BLOCK,
+        ASSIGN, CALL, IF, WHILE, DO_WHILE, REPEAT, FOR, RETURN,
+        BINARY, NOT, LITERAL, DESIGNATOR, EMPTY,
+
+        // Used for getting size of enum
+        SIZE,
+    };
+
+    // LITERAL aux flag: the literal's "-" was read as a subtraction, so the
+    // token text must be used without its first character
+    static const uint16_t SPLIT_SIGN = 1;
+
+    Kind kind;
+    uint8_t op;         // A Token::Kind, see table above
+    uint16_t aux;
+    uint32_t tok;       // Index into the unit's TokenStream
+    int32_t sym;        // Index into the unit's SymbolTable
+    uint32_t type;      // Index into the unit's TypeTable, set by the TypeChecker
+    Node* child;
+    Node* next;
+
+    Token::Kind opKind() const { return Token::Kind(op); }
+
+    // Number of children (walks the sibling list)
+    size_t childCount() const;
+    // The i-th child, or nullptr
+    Node* childAt(size_t i) const;
+};
+
+// Appends children to a node in order without walking its child list
+struct NodeList {
+    Node** tail;
+
+    explicit NodeList(Node* parent): tail(&parent->child) {}
+
+    void add(Node* n) {
+        *tail = n;
+        tail = &n->next;
+    }
+};
+
+// Everything produced from one source file: its tokens, the tree built over
+// them and the symbols and types the tree refers to. The tree lives in the unit's arena,
+// so it is released in one go together with the unit.
+class CompilationUnit {
+private:
+
+    TokenStream _tokens;
+    Arena arena;
+    SymbolTable _symbols;
+    TypeTable _types;
+    Node* _root;
+    size_t nodeCount;
+
+    void print(std::ostream& out, const Node* n, int depth) const;
+
+public:
+
+    CompilationUnit(TokenStream ts);
+
+    CompilationUnit(const CompilationUnit&) = delete;
+    CompilationUnit& operator=(const CompilationUnit&) = delete;
+    CompilationUnit(CompilationUnit&&) = default;
+
+    Node* node(Node::Kind kind, uint32_t tok, Token::Kind op = Token::Kind(0), uint16_t aux = 0) {
+        nodeCount++;
+        return arena.make<Node>(kind, uint8_t(op), aux, tok, -1, uint32_t(TypeTable::ERROR), nullptr, nullptr);
+    }
+
+    Node* root() const { return _root; }
+    void setRoot(Node* n) { _root = n; }
+
+    const TokenStream& tokens() const { return _tokens; }
+
+    SymbolTable& symbols() { return _symbols; }
+    const SymbolTable& symbols() const { return _symbols; }
+
+    TypeTable& types() { return _types; }
+    const TypeTable& types() const { return _types; }
+
+    // Source text of a node's token (without a split-off sign)
+    std::string_view text(const Node* n) const;
+    int lineNumber(const Node* n) const { return _tokens.lineNumber(n->tok); }
+    int charPosition(const Node* n) const;
+
+    size_t nodes() const { return nodeCount; }
+
+    // Print the tree, one node per line
+    void printTree(std::ostream& out = std::cout) const;
+
+    // Print how much memory the tokens and the tree take, in total and per token
+    void printMemoryReport(std::ostream& out = std::cout) const;
+
+    static const char* kindName(Node::Kind kind);
+};
+
+#endif
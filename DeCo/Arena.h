@@ -0,0 +1,85 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that lives exactly as long as its owner, such as
+// the nodes of an AST. Objects are carved out of large blocks and are never
+// freed one by one; dropping the arena releases every block at once without
+// running any destructors, so only trivially destructible types may be made.
+class Arena {
+private:
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* limit;
+    size_t nextBlockSize;
+    size_t used;        // Bytes handed out, including alignment padding
+    size_t reserved;    // Bytes in all blocks
+
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 20;
+
+    // Start a new block large enough for bytes at the given alignment
+    char* grow(size_t bytes, size_t align) {
+        size_t size = std::max(nextBlockSize, bytes + align);
+        nextBlockSize = std::min(nextBlockSize * 2, MAX_BLOCK_SIZE);
+
+        blocks.emplace_back(new char[size]);
+        cursor = blocks.back().get();
+        limit = cursor + size;
+        reserved += size;
+        return alignUp(cursor, align);
+    }
+
+    static char* alignUp(char* p, size_t align) {
+        return (char*)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+public:
+
+    explicit Arena(size_t firstBlockSize = 64 << 10)
+        : cursor(nullptr), limit(nullptr), nextBlockSize(std::max<size_t>(firstBlockSize, 256)),
+          used(0), reserved(0) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // The moved-from arena is left empty and can still be used
+    Arena(Arena&& other)
+        : blocks(std::move(other.blocks)), cursor(other.cursor), limit(other.limit),
+          nextBlockSize(other.nextBlockSize), used(other.used), reserved(other.reserved) {
+        other.blocks.clear();
+        other.cursor = other.limit = nullptr;
+        other.used = other.reserved = 0;
+    }
+
+    void* allocate(size_t bytes, size_t align) {
+        char* p = alignUp(cursor, align);
+        if (!cursor || p + bytes > limit) {
+            p = grow(bytes, align);
+        }
+        used += p + bytes - cursor;
+        cursor = p + bytes;
+        return p;
+    }
+
+    // Construct a T in the arena
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "Arena objects are released without running destructors");
+        return new (allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+};
+
+#endif
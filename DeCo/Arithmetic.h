@@ -0,0 +1,116 @@
+#ifndef _ARITHMETIC_H_
+#define _ARITHMETIC_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "IR.h"
+
+// What DeCo's operators compute, shared by the optimizer's constant folding
+// and everything that executes IR, so a folded expression always gives the
+// value it would have given at run time.
+//
+// int is 64-bit two's complement and wraps on overflow. Division truncates
+// toward zero; x / 0 is 0 and x % 0 is x, which keeps x == x / y * y + x % y
+// true for every y. A negative power of an int is the truncated reciprocal:
+// 1 and -1 keep their magnitude and everything else gives 0. float follows
+// IEEE 754, with % as C's fmod and ^ as pow.
+//
+// Values are passed around as the 64 bits of an IR slot: bools are 0 or 1 and
+// floats are the bits of a double.
+namespace Arithmetic {
+
+inline double toFloat(int64_t bits) {
+    double d;
+    std::memcpy(&d, &bits, sizeof d);
+    return d;
+}
+
+inline int64_t fromFloat(double d) {
+    int64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    return bits;
+}
+
+inline int64_t add(int64_t a, int64_t b) { return int64_t(uint64_t(a) + uint64_t(b)); }
+inline int64_t sub(int64_t a, int64_t b) { return int64_t(uint64_t(a) - uint64_t(b)); }
+inline int64_t mul(int64_t a, int64_t b) { return int64_t(uint64_t(a) * uint64_t(b)); }
+
+inline int64_t div(int64_t a, int64_t b) {
+    if (b == 0) {
+        return 0;
+    }
+    // INT64_MIN / -1 overflows in C++; negating wraps instead
+    return b == -1 ? sub(0, a) : a / b;
+}
+
+inline int64_t mod(int64_t a, int64_t b) {
+    if (b == 0) {
+        return a;
+    }
+    return b == -1 ? 0 : a % b;
+}
+
+// Repeated squaring, wrapping like mul
+inline int64_t pow(int64_t a, int64_t b) {
+    if (b < 0) {
+        return a == 1 ? 1 : a == -1 ? (b & 1 ? -1 : 1) : 0;
+    }
+    uint64_t result = 1;
+    uint64_t base = a;
+    for (uint64_t e = b; e; e >>= 1) {
+        if (e & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return int64_t(result);
+}
+
+// Apply a binary arithmetic, boolean or comparison op to operands of the given
+// type (for NOT, b is ignored). Returns false for ops that do not compute a
+// value from their operands alone, such as loads and calls.
+inline bool evaluate(Instr::Op op, Instr::Type type, int64_t a, int64_t b, int64_t& result) {
+    if (type == Instr::FLOAT) {
+        double x = toFloat(a);
+        double y = toFloat(b);
+        switch (op) {
+            case Instr::ADD: result = fromFloat(x + y); return true;
+            case Instr::SUB: result = fromFloat(x - y); return true;
+            case Instr::MUL: result = fromFloat(x * y); return true;
+            case Instr::DIV: result = fromFloat(x / y); return true;
+            case Instr::MOD: result = fromFloat(std::fmod(x, y)); return true;
+            case Instr::POW: result = fromFloat(std::pow(x, y)); return true;
+            case Instr::EQ: result = x == y; return true;
+            case Instr::NE: result = x != y; return true;
+            case Instr::LT: result = x < y; return true;
+            case Instr::LE: result = x <= y; return true;
+            case Instr::GT: result = x > y; return true;
+            case Instr::GE: result = x >= y; return true;
+            default: return false;
+        }
+    }
+
+    switch (op) {
+        case Instr::ADD: result = add(a, b); return true;
+        case Instr::SUB: result = sub(a, b); return true;
+        case Instr::MUL: result = mul(a, b); return true;
+        case Instr::DIV: result = div(a, b); return true;
+        case Instr::MOD: result = mod(a, b); return true;
+        case Instr::POW: result = pow(a, b); return true;
+        case Instr::AND: result = a && b; return true;
+        case Instr::OR: result = a || b; return true;
+        case Instr::NOT: result = !a; return true;
+        case Instr::EQ: result = a == b; return true;
+        case Instr::NE: result = a != b; return true;
+        case Instr::LT: result = a < b; return true;
+        case Instr::LE: result = a <= b; return true;
+        case Instr::GT: result = a > b; return true;
+        case Instr::GE: result = a >= b; return true;
+        default: return false;
+    }
+}
+
+}
+
+#endif
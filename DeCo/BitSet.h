@@ -0,0 +1,42 @@
+#ifndef _BIT_SET_H_
+#define _BIT_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A set of the integers below some bound, one bit each. Passes keep one per
+// function they work on, so assign() reuses the storage of the last one.
+class BitSet {
+private:
+
+    std::vector<uint64_t> words;
+
+public:
+
+    // Make the set empty, with room for 0 to n - 1
+    void assign(size_t n) { words.assign((n + 63) / 64, 0); }
+
+    bool test(size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+    void set(size_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(size_t i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+    // Add i, returning whether it was missing
+    bool insert(size_t i) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        uint64_t& word = words[i / 64];
+        bool missing = !(word & bit);
+        word |= bit;
+        return missing;
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (uint64_t w : words) {
+            n += __builtin_popcountll(w);
+        }
+        return n;
+    }
+};
+
+#endif
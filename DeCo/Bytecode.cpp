@@ -0,0 +1,106 @@
+#include "Bytecode.h"
+
+static const char* opNames[] = {
+    "mov", "getx", "setx", "loadi", "loadw", "loadk",
+    "add", "sub", "mul", "div", "mod", "pow",
+    "fadd", "fsub", "fmul", "fdiv", "fmod", "fpow",
+    "and", "or", "not",
+    "eq", "ne", "lt", "le", "gt", "ge",
+    "feq", "fne", "flt", "fle", "fgt", "fge",
+    "loadg", "storeg", "gaddr", "alloca", "load", "store",
+    "jmp", "jt", "jf", "call", "ret", "retv",
+};
+
+static_assert(sizeof(opNames) / sizeof(opNames[0]) == Bytecode::OP_COUNT, "Missing opcode name");
+
+const char* Bytecode::opName(Op op) {
+    return opNames[op];
+}
+
+void Program::print(std::ostream& out) const {
+    if (globalSlots) {
+        out << "globals: " << globalSlots << " slots\n\n";
+    }
+    for (size_t fi = 0; fi < functions.size(); fi++) {
+        const BytecodeFunction& f = functions[fi];
+        out << (fi ? "\n" : "") << "function " << f.name << "(";
+        for (size_t p = 0; p < f.params.size(); p++) {
+            out << (p ? ", " : "") << "r" << f.params[p];
+        }
+        out << "), " << f.registers << " registers";
+        if (f.frameSlots) {
+            out << ", frame " << f.frameSlots << " slots";
+        }
+        out << "\n";
+
+        for (uint32_t pc = f.entry; pc < f.end; pc++) {
+            uint32_t w = code[pc];
+            Bytecode::Op op = Bytecode::op(w);
+            uint32_t a = Bytecode::a(w);
+            out << "    " << pc << ": " << Bytecode::opName(op);
+            switch (op) {
+                case Bytecode::GETX:
+                    out << " r" << a << ", r" << Bytecode::bx(w);
+                    break;
+                case Bytecode::SETX:
+                    out << " r" << Bytecode::bx(w) << ", r" << a;
+                    break;
+                case Bytecode::LOADI:
+                    out << " r" << a << ", " << Bytecode::sbx(w);
+                    break;
+                case Bytecode::LOADW:
+                    out << " r" << a << ", " << int32_t(code[++pc]);
+                    break;
+                case Bytecode::LOADK: {
+                    uint32_t k = code[++pc];
+                    out << " r" << a << ", k" << k << " (" << constants[k] << ")";
+                    break;
+                }
+                case Bytecode::LOADG:
+                case Bytecode::GADDR:
+                    out << " r" << a << ", @" << Bytecode::bx(w);
+                    break;
+                case Bytecode::STOREG:
+                    out << " @" << Bytecode::bx(w) << ", r" << a;
+                    break;
+                case Bytecode::ALLOCA:
+                    out << " r" << a << ", %" << Bytecode::bx(w) << ", " << code[++pc];
+                    break;
+                case Bytecode::MOV:
+                case Bytecode::NOT:
+                    out << " r" << a << ", r" << Bytecode::b(w);
+                    break;
+                case Bytecode::JMP:
+                    out << " " << Bytecode::ax(w);
+                    break;
+                case Bytecode::JT:
+                case Bytecode::JF:
+                    out << " r" << a << ", " << code[++pc];
+                    break;
+                case Bytecode::CALL: {
+                    uint32_t result = code[++pc];
+                    out << " " << functions[Bytecode::bx(w)].name << "(";
+                    for (uint32_t k = 0; k < a; k++) {
+                        uint32_t pair = code[pc + 1 + k / 2];
+                        out << (k ? ", " : "") << "r" << (k % 2 ? pair >> 16 : pair & 0xFFFF);
+                    }
+                    out << ")";
+                    if (result != Bytecode::NO_RESULT) {
+                        out << " -> r" << result;
+                    }
+                    pc += (a + 1) / 2;
+                    break;
+                }
+                case Bytecode::RET:
+                    out << " r" << a;
+                    break;
+                case Bytecode::RETV:
+                    break;
+                default:
+                    out << " r" << a << ", r" << Bytecode::b(w) << ", r" << Bytecode::c(w);
+                    break;
+            }
+            out << "\n";
+        }
+    }
+}
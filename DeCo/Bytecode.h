@@ -0,0 +1,110 @@
+#ifndef _BYTECODE_H_
+#define _BYTECODE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Register bytecode for the VM. Every instruction is one 32-bit word: an
+// 8-bit opcode in the low byte, then either three 8-bit operands A, B and C,
+// an 8-bit A and a 16-bit Bx, or a 24-bit Ax. The few that need more read
+// the words after them.
+//
+// Registers belong to the running function's frame. Operands name registers
+// 0 to 255; GETX and SETX reach the registers of frames larger than that,
+// and the generator keeps 253 to 255 free as scratch for them. Values are 64
+// bits, as in the IR: ints, bools as 0 or 1, the bits of a double, or
+// pointers, which index the VM's memory of 8-byte slots.
+//
+//  Op              Operands        Effect
+//  --------------- --------------- ------------------------------------------
+//  MOV             A B             R[A] = R[B]
+//  GETX            A Bx            R[A] = R[Bx]
+//  SETX            A Bx            R[Bx] = R[A]
+//  LOADI           A sBx           R[A] = sBx
+//  LOADW           A, word         R[A] = word, sign extended
+//  LOADK           A, word         R[A] = constants[word]
+//  ADD..POW        A B C           R[A] = R[B] op R[C], on ints
+//  FADD..FPOW      A B C           the same on floats
+//  AND, OR         A B C           R[A] = R[B] op R[C], on bools
+//  NOT             A B             R[A] = !R[B]
+//  EQ..GE          A B C           R[A] = R[B] op R[C], on ints, bools or pointers
+//  FEQ..FGE        A B C           the same on floats
+//  LOADG           A Bx            R[A] = memory[Bx]
+//  STOREG          A Bx            memory[Bx] = R[A]
+//  GADDR           A Bx            R[A] = Bx
+//  ALLOCA          A Bx, word      R[A] = frame + Bx; zero word slots there
+//  LOAD            A B C           R[A] = memory[R[B] + R[C]]
+//  STORE           A B C           memory[R[B] + R[C]] = R[A]
+//  JMP             Ax              goto Ax
+//  JT, JF          A, word         goto word if R[A] is true (JT) or false (JF)
+//  CALL            A Bx, words     call function Bx with A arguments, see below
+//  RET             A               return R[A]
+//  RETV                            return nothing
+//
+// The word after a CALL is the register for the result, or NO_RESULT; the
+// arguments follow, two 16-bit registers to a word, low half first. They are
+// copied into the callee's parameter registers, listed in its
+// BytecodeFunction. Jump targets are positions in Program::code.
+struct Bytecode {
+    enum Op : uint8_t {
+        MOV, GETX, SETX, LOADI, LOADW, LOADK,
+
+        // Each group in Instr::Op order
+        ADD, SUB, MUL, DIV, MOD, POW,
+        FADD, FSUB, FMUL, FDIV, FMOD, FPOW,
+        AND, OR, NOT,
+        EQ, NE, LT, LE, GT, GE,
+        FEQ, FNE, FLT, FLE, FGT, FGE,
+
+        LOADG, STOREG, GADDR, ALLOCA, LOAD, STORE,
+
+        JMP, JT, JF, CALL, RET, RETV,
+
+        // Used for getting size of enum
+        OP_COUNT,
+    };
+
+    static constexpr uint32_t NO_RESULT = UINT32_MAX;
+    static constexpr uint32_t MAX_BX = UINT16_MAX;
+    static constexpr uint32_t MAX_AX = (1u << 24) - 1;
+
+    static uint32_t abc(Op op, uint32_t a, uint32_t b, uint32_t c) { return op | a << 8 | b << 16 | c << 24; }
+    static uint32_t abx(Op op, uint32_t a, uint32_t bx) { return op | a << 8 | bx << 16; }
+    static uint32_t ax(Op op, uint32_t ax) { return op | ax << 8; }
+
+    static Op op(uint32_t w) { return Op(w & 0xFF); }
+    static uint32_t a(uint32_t w) { return w >> 8 & 0xFF; }
+    static uint32_t b(uint32_t w) { return w >> 16 & 0xFF; }
+    static uint32_t c(uint32_t w) { return w >> 24; }
+    static uint32_t bx(uint32_t w) { return w >> 16; }
+    static int32_t sbx(uint32_t w) { return int16_t(w >> 16); }
+    static uint32_t ax(uint32_t w) { return w >> 8; }
+
+    static const char* opName(Op op);
+};
+
+struct BytecodeFunction {
+    std::string name;
+    uint32_t entry;                     // Position of the first instruction
+    uint32_t end;                       // And one past the last
+    uint32_t registers;                 // Frame size
+    uint32_t frameSlots;                // Memory for local arrays
+    std::vector<uint32_t> params;       // Register of each parameter
+};
+
+// A whole module compiled for the VM. Memory starts with globalSlots slots
+// of globals; frames for local arrays are stacked after them.
+struct Program {
+    std::vector<uint32_t> code;
+    std::vector<int64_t> constants;
+    std::vector<BytecodeFunction> functions;
+    uint32_t globalSlots;
+    int32_t main;
+
+    // Disassemble, one instruction per line
+    void print(std::ostream& out = std::cout) const;
+};
+
+#endif
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include "BytecodeGen.h"
+
+BytecodeGen::BytecodeGen(Module& m)
+    : module(m), allocator({32, ~uint32_t(0)}, {32, ~uint32_t(0)}), fn(nullptr), registers(0) {}
+
+void BytecodeGen::reportLimit(const std::string& what) {
+    errBuf.push_back("BytecodeError(" + fn->name + ")[" + what + " does not fit in an operand]");
+}
+
+void BytecodeGen::printErrorReport() {
+    std::cout << "BYTECODE ERROR REPORT:" << std::endl;
+    std::cout << "--------------------------------------------------------------------" << std::endl;
+    for (const std::string& msg : errBuf) {
+        std::cout << msg << "\n";
+    }
+}
+
+bool BytecodeGen::hasError() {
+    return !errBuf.empty();
+}
+
+// REGISTERS ==================================================================
+
+// Registers the allocator handed out come first, general then float, so
+// frames stay small; spilled vregs follow, stepping over the scratch registers
+void BytecodeGen::assignLocations() {
+    allocator.allocate(*fn);
+
+    uint32_t number[2][32];
+    uint32_t next = 0;
+    for (int c = 0; c < 2; c++) {
+        uint32_t used = allocator.usedRegisters(RegisterAllocator::Class(c));
+        for (int r = 0; r < 32; r++) {
+            number[c][r] = next;
+            next += used >> r & 1;
+        }
+    }
+
+    read.assign(fn->vregCount(), false);
+    for (Instr& in : fn->code) {
+        fn->forEachUse(in, [&](int32_t& v) { read[v] = true; });
+    }
+
+    location.assign(fn->vregCount(), 0);
+    registers = 0;
+    for (size_t v = 0; v < location.size(); v++) {
+        if (allocator.reg(v) >= 0) {
+            location[v] = number[RegisterAllocator::classOf(fn->vregs[v])][allocator.reg(v)];
+        } else if (allocator.slot(v) >= 0) {
+            location[v] = next + allocator.slot(v);
+            location[v] += location[v] >= SCRATCH ? 3 : 0;
+        } else {
+            continue;
+        }
+        registers = std::max(registers, location[v] + 1);
+    }
+    if (registers > Bytecode::MAX_BX + 1) {
+        reportLimit("Frame of " + std::to_string(registers) + " registers");
+    }
+}
+
+// The register holding v, fetched into scratch if it is out of reach
+uint32_t BytecodeGen::source(int32_t v, uint32_t scratch) {
+    if (location[v] < SCRATCH) {
+        return location[v];
+    }
+    registers = std::max(registers, uint32_t(256));
+    emit(Bytecode::abx(Bytecode::GETX, scratch, location[v]));
+    return scratch;
+}
+
+// The register to write v to; finish() stores it if that was scratch
+uint32_t BytecodeGen::target(int32_t v) {
+    return location[v] < SCRATCH ? location[v] : SCRATCH + 2;
+}
+
+void BytecodeGen::finish(int32_t v, uint32_t reg) {
+    if (reg != location[v]) {
+        registers = std::max(registers, uint32_t(256));
+        emit(Bytecode::abx(Bytecode::SETX, reg, location[v]));
+    }
+}
+
+void BytecodeGen::move(uint32_t to, uint32_t from) {
+    if (to == from) {
+        return;
+    }
+    if (to < 256 && from < 256) {
+        emit(Bytecode::abc(Bytecode::MOV, to, from, 0));
+    } else if (to < 256) {
+        emit(Bytecode::abx(Bytecode::GETX, to, from));
+    } else if (from < 256) {
+        emit(Bytecode::abx(Bytecode::SETX, from, to));
+    } else {
+        emit(Bytecode::abx(Bytecode::GETX, SCRATCH + 1, from));
+        emit(Bytecode::abx(Bytecode::SETX, SCRATCH + 1, to));
+    }
+    registers = std::max(registers, to < 256 && from < 256 ? 0 : uint32_t(256));
+}
+
+// CONTROL FLOW ===============================================================
+
+// The moves for the PHIs of block to, coming from block from. PHIs nothing
+// reads are left out, so no two moves ever write the same register
+void BytecodeGen::edgeMoves(int32_t from, int32_t to) {
+    moves.clear();
+    for (uint32_t i = fn->blocks[to].start; i < fn->blocks[to].end && fn->code[i].op == Instr::PHI; i++) {
+        const Instr& phi = fn->code[i];
+        if (!read[phi.dst]) {
+            continue;
+        }
+        for (int pair = 0; pair < phi.count; pair++) {
+            if (fn->operands[phi.b + 2 * pair] == from) {
+                uint32_t value = location[fn->operands[phi.b + 2 * pair + 1]];
+                if (value != location[phi.dst]) {
+                    moves.push_back({location[phi.dst], value});
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Emit the moves as if done at once: a move goes when no other still reads
+// its target, and a cycle of them is broken by parking one value in scratch
+void BytecodeGen::parallelCopy() {
+    while (!moves.empty()) {
+        size_t ready = moves.size();
+        for (size_t k = 0; k < moves.size() && ready == moves.size(); k++) {
+            bool read = false;
+            for (size_t j = 0; j < moves.size() && !read; j++) {
+                read = j != k && moves[j].second == moves[k].first;
+            }
+            ready = read ? ready : k;
+        }
+        if (ready < moves.size()) {
+            move(moves[ready].first, moves[ready].second);
+            moves[ready] = moves.back();
+            moves.pop_back();
+            continue;
+        }
+        uint32_t parked = moves[0].second;
+        registers = std::max(registers, uint32_t(256));
+        move(SCRATCH + 2, parked);
+        for (auto& m : moves) {
+            m.second = m.second == parked ? SCRATCH + 2 : m.second;
+        }
+    }
+}
+
+// Jumps are filled in once every block has a position. A JMP carries its
+// target in Ax, while JT and JF are followed by a word left 0 until then
+void BytecodeGen::jump(int32_t block) {
+    fixups.push_back({uint32_t(program.code.size()), block});
+    emit(Bytecode::ax(Bytecode::JMP, 0));
+}
+
+void BytecodeGen::branchTarget(int32_t block) {
+    fixups.push_back({uint32_t(program.code.size()), block});
+    emit(0);
+}
+
+void BytecodeGen::terminator(int32_t b, const Instr& in) {
+    if (in.op == Instr::RET) {
+        if (in.a >= 0) {
+            emit(Bytecode::abc(Bytecode::RET, source(in.a, SCRATCH), 0, 0));
+        } else {
+            emit(Bytecode::abc(Bytecode::RETV, 0, 0, 0));
+        }
+        return;
+    }
+    if (in.op == Instr::JMP) {
+        edgeMoves(b, in.a);
+        parallelCopy();
+        if (in.a != b + 1) {
+            jump(in.a);
+        }
+        return;
+    }
+
+    uint32_t cond = source(in.a, SCRATCH);
+    int32_t whenTrue = in.b;
+    int32_t whenFalse = in.dst;
+    edgeMoves(b, whenTrue);
+    bool trueMoves = !moves.empty();
+    edgeMoves(b, whenFalse);
+    bool falseMoves = !moves.empty();
+
+    if (!trueMoves && !falseMoves) {
+        if (whenTrue == b + 1) {
+            emit(Bytecode::abc(Bytecode::JF, cond, 0, 0));
+            branchTarget(whenFalse);
+        } else {
+            emit(Bytecode::abc(Bytecode::JT, cond, 0, 0));
+            branchTarget(whenTrue);
+            if (whenFalse != b + 1) {
+                jump(whenFalse);
+            }
+        }
+        return;
+    }
+
+    // Moves for one side go after the branch, for the other in a stub
+    // after those, unless that side needs none and the branch can go
+    // straight to its block
+    bool trueFirst = trueMoves;
+    emit(Bytecode::abc(trueFirst ? Bytecode::JF : Bytecode::JT, cond, 0, 0));
+    int32_t first = trueFirst ? whenTrue : whenFalse;
+    int32_t second = trueFirst ? whenFalse : whenTrue;
+    bool stub = trueMoves && falseMoves;
+    uint32_t stubTarget = program.code.size();
+    if (stub) {
+        emit(0);
+    } else {
+        branchTarget(second);
+    }
+    edgeMoves(b, first);
+    parallelCopy();
+    if (stub || first != b + 1) {
+        jump(first);
+    }
+    if (stub) {
+        program.code[stubTarget] = program.code.size();
+        edgeMoves(b, second);
+        parallelCopy();
+        if (second != b + 1) {
+            jump(second);
+        }
+    }
+}
+
+// INSTRUCTIONS ===============================================================
+
+// Constants whose bits fit sign-extended in 16 or 32 bits go in the code;
+// others go in the constant pool, once each
+void BytecodeGen::constant(const Instr& in) {
+    int64_t bits = in.bits();
+    uint32_t d = target(in.dst);
+    if (bits == int16_t(bits)) {
+        emit(Bytecode::abx(Bytecode::LOADI, d, uint16_t(bits)));
+    } else if (bits == int32_t(bits)) {
+        emit(Bytecode::abx(Bytecode::LOADW, d, 0));
+        emit(uint32_t(bits));
+    } else {
+        auto found = constantIndex.emplace(bits, program.constants.size());
+        if (found.second) {
+            program.constants.push_back(bits);
+        }
+        emit(Bytecode::abx(Bytecode::LOADK, d, 0));
+        emit(found.first->second);
+    }
+    finish(in.dst, d);
+}
+
+void BytecodeGen::binary(Bytecode::Op op, const Instr& in) {
+    uint32_t x = source(in.a, SCRATCH);
+    uint32_t y = source(in.b, SCRATCH + 1);
+    uint32_t d = target(in.dst);
+    emit(Bytecode::abc(op, d, x, y));
+    finish(in.dst, d);
+}
+
+void BytecodeGen::instruction(const Instr& in) {
+    // Where globals and local arrays start; the arrays themselves can run on
+    bool slotOperand = in.op == Instr::LOADG || in.op == Instr::STOREG || in.op == Instr::GADDR || in.op == Instr::ALLOCA;
+    if (slotOperand && uint32_t(in.a) > Bytecode::MAX_BX) {
+        reportLimit(std::string(in.op == Instr::ALLOCA ? "Frame slot " : "Global slot ") + std::to_string(in.a));
+    }
+
+    switch (in.op) {
+        case Instr::NOP:
+        case Instr::PHI:
+            break;
+        case Instr::CONST:
+            constant(in);
+            break;
+        case Instr::MOV:
+            move(location[in.dst], location[in.a]);
+            break;
+        case Instr::ADD:
+        case Instr::SUB:
+        case Instr::MUL:
+        case Instr::DIV:
+        case Instr::MOD:
+        case Instr::POW:
+            binary(Bytecode::Op((in.type == Instr::FLOAT ? Bytecode::FADD : Bytecode::ADD) + (in.op - Instr::ADD)), in);
+            break;
+        case Instr::AND:
+        case Instr::OR:
+            binary(Bytecode::Op(Bytecode::AND + (in.op - Instr::AND)), in);
+            break;
+        case Instr::NOT: {
+            uint32_t x = source(in.a, SCRATCH);
+            uint32_t d = target(in.dst);
+            emit(Bytecode::abc(Bytecode::NOT, d, x, 0));
+            finish(in.dst, d);
+            break;
+        }
+        case Instr::EQ:
+        case Instr::NE:
+        case Instr::LT:
+        case Instr::LE:
+        case Instr::GT:
+        case Instr::GE:
+            binary(Bytecode::Op((in.type == Instr::FLOAT ? Bytecode::FEQ : Bytecode::EQ) + (in.op - Instr::EQ)), in);
+            break;
+        case Instr::LOADG:
+        case Instr::GADDR: {
+            uint32_t d = target(in.dst);
+            emit(Bytecode::abx(in.op == Instr::LOADG ? Bytecode::LOADG : Bytecode::GADDR, d, in.a));
+            finish(in.dst, d);
+            break;
+        }
+        case Instr::STOREG:
+            emit(Bytecode::abx(Bytecode::STOREG, source(in.b, SCRATCH), in.a));
+            break;
+        case Instr::ALLOCA: {
+            uint32_t d = target(in.dst);
+            emit(Bytecode::abx(Bytecode::ALLOCA, d, in.a));
+            emit(in.b);
+            finish(in.dst, d);
+            break;
+        }
+        case Instr::OFFSET:
+            binary(Bytecode::ADD, in);
+            break;
+        case Instr::LOAD:
+            binary(Bytecode::LOAD, in);
+            break;
+        case Instr::STORE: {
+            uint32_t x = source(in.dst, SCRATCH + 2);
+            uint32_t p = source(in.a, SCRATCH);
+            uint32_t i = source(in.b, SCRATCH + 1);
+            emit(Bytecode::abc(Bytecode::STORE, x, p, i));
+            break;
+        }
+        case Instr::CALL:
+            if (in.count > 0xFF) {
+                reportLimit("Call with " + std::to_string(in.count) + " arguments");
+            }
+            emit(Bytecode::abx(Bytecode::CALL, in.count, in.a));
+            emit(in.dst >= 0 ? location[in.dst] : Bytecode::NO_RESULT);
+            for (int k = 0; k < in.count; k += 2) {
+                uint32_t low = location[fn->operands[in.b + k]];
+                uint32_t high = k + 1 < in.count ? location[fn->operands[in.b + k + 1]] : 0;
+                emit(low | high << 16);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// FUNCTIONS ==================================================================
+
+void BytecodeGen::function(size_t index) {
+    fn = &module.functions[index];
+    BytecodeFunction out{fn->name, uint32_t(program.code.size()), 0, 0, fn->frameSlots, {}};
+    assignLocations();
+    for (uint32_t p = 0; p < fn->params; p++) {
+        out.params.push_back(location[p]);
+    }
+
+    blockStart.resize(fn->blocks.size());
+    fixups.clear();
+    for (size_t b = 0; b < fn->blocks.size(); b++) {
+        blockStart[b] = program.code.size();
+        const BasicBlock& block = fn->blocks[b];
+        for (uint32_t i = block.start; i + 1 < block.end; i++) {
+            instruction(fn->code[i]);
+        }
+        terminator(b, fn->code[block.end - 1]);
+    }
+
+    for (const auto& fixup : fixups) {
+        uint32_t& word = program.code[fixup.first];
+        word = word ? Bytecode::ax(Bytecode::JMP, blockStart[fixup.second]) : blockStart[fixup.second];
+    }
+    out.end = program.code.size();
+    out.registers = registers;
+    program.functions.push_back(std::move(out));
+}
+
+Program BytecodeGen::generate() {
+    program = Program{{}, {}, {}, module.globalSlots, module.main};
+    constantIndex.clear();
+    for (size_t i = 0; i < module.functions.size(); i++) {
+        function(i);
+    }
+    if (program.code.size() > Bytecode::MAX_AX) {
+        errBuf.push_back("BytecodeError[" + std::to_string(program.code.size()) + " words of code do not fit in a jump]");
+    }
+    return std::move(program);
+}
@@ -0,0 +1,74 @@
+#ifndef _BYTECODE_GEN_H_
+#define _BYTECODE_GEN_H_
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Bytecode.h"
+#include "IR.h"
+#include "RegisterAllocator.h"
+
+// Compiles a Module in SSA form, as the optimizer leaves it, to bytecode.
+//
+// Vregs get frame registers from RegisterAllocator. The VM gives every call a
+// fresh frame, so all registers count as preserved and nothing is spilled
+// around calls; vregs it spills simply get registers past the ones it
+// allocated. Those past 252 are reached through the scratch registers with
+// GETX and SETX.
+//
+// PHIs become moves at the end of each predecessor, done as one parallel
+// copy. Moves for a branch's targets go in short stubs after the branch.
+// Blocks stay in order, and jumps to the next block are left out.
+class BytecodeGen {
+private:
+
+    Module& module;
+    RegisterAllocator allocator;
+    Program program;
+    std::unordered_map<int64_t, uint32_t> constantIndex;
+    std::vector<std::string> errBuf;
+
+    // The function being compiled
+    Function* fn;
+    std::vector<uint32_t> location;     // Frame register of each vreg
+    std::vector<bool> read;             // Whether anything reads each vreg
+    std::vector<uint32_t> blockStart;   // Position of each block's code
+    std::vector<std::pair<uint32_t, int32_t>> fixups;  // Jump targets to fill in, with their blocks
+    std::vector<std::pair<uint32_t, uint32_t>> moves;  // Parallel copy being built, as (to, from)
+    uint32_t registers;                 // Frame size so far
+
+    static constexpr uint32_t SCRATCH = 253;
+
+    void reportLimit(const std::string& what);
+    void emit(uint32_t word) { program.code.push_back(word); }
+    uint32_t source(int32_t v, uint32_t scratch);
+    uint32_t target(int32_t v);
+    void finish(int32_t v, uint32_t reg);
+    void move(uint32_t to, uint32_t from);
+    void edgeMoves(int32_t from, int32_t to);
+    void parallelCopy();
+    void jump(int32_t block);
+    void branchTarget(int32_t block);
+    void constant(const Instr& in);
+    void binary(Bytecode::Op op, const Instr& in);
+    void instruction(const Instr& in);
+    void terminator(int32_t b, const Instr& in);
+    void assignLocations();
+    void function(size_t index);
+
+public:
+
+    explicit BytecodeGen(Module& m);
+
+    // Compile the whole module
+    Program generate();
+
+    // Print out any errors
+    void printErrorReport();
+
+    // Check if something was too large for the bytecode's operands
+    bool hasError();
+};
+
+#endif
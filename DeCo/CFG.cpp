@@ -0,0 +1,278 @@
+#include <algorithm>
+#include "CFG.h"
+
+// GROUPING ===================================================================
+
+void group(const std::vector<int32_t>& pairs, size_t froms, std::vector<uint32_t>& start,
+        std::vector<int32_t>& items) {
+    start.assign(froms + 1, 0);
+    for (size_t i = 0; i < pairs.size(); i += 2) {
+        start[pairs[i] + 1]++;
+    }
+    for (size_t from = 0; from < froms; from++) {
+        start[from + 1] += start[from];
+    }
+
+    items.resize(pairs.size() / 2);
+    for (size_t i = 0; i < pairs.size(); i += 2) {
+        items[start[pairs[i]]++] = pairs[i + 1];
+    }
+    // Filling moved each start up to where the next one begins
+    for (size_t from = froms; from > 0; from--) {
+        start[from] = start[from - 1];
+    }
+    start[0] = 0;
+}
+
+// EDGES ======================================================================
+
+void CFG::edges(const Function& f) {
+    size_t n = f.blocks.size();
+    pairs.clear();
+    for (size_t b = 0; b < n; b++) {
+        const Instr& last = f.code[f.blocks[b].end - 1];
+        if (last.op == Instr::JMP) {
+            pairs.insert(pairs.end(), {int32_t(b), last.a});
+        } else if (last.op == Instr::BR) {
+            pairs.insert(pairs.end(), {int32_t(b), last.b});
+            if (last.dst != last.b) {
+                pairs.insert(pairs.end(), {int32_t(b), last.dst});
+            }
+        }
+    }
+    group(pairs, n, succStart, succ);
+
+    for (size_t i = 0; i < pairs.size(); i += 2) {
+        std::swap(pairs[i], pairs[i + 1]);
+    }
+    group(pairs, n, predStart, pred);
+}
+
+// Depth-first search from the entry, numbering blocks as they finish
+void CFG::order() {
+    size_t n = size();
+    _rpo.clear();
+    rpoIndex.assign(n, -1);
+    mark.assign(n, 0);          // Successors of each block visited so far
+
+    // rpoIndex doubles as "seen" while searching
+    stack.assign(1, 0);
+    rpoIndex[0] = 0;
+    while (!stack.empty()) {
+        int32_t b = stack.back();
+        if (succStart[b] + mark[b] < succStart[b + 1]) {
+            int32_t s = succ[succStart[b] + mark[b]++];
+            if (rpoIndex[s] < 0) {
+                rpoIndex[s] = 0;
+                stack.push_back(s);
+            }
+            continue;
+        }
+        stack.pop_back();
+        _rpo.push_back(b);
+    }
+
+    std::reverse(_rpo.begin(), _rpo.end());
+    for (size_t i = 0; i < _rpo.size(); i++) {
+        rpoIndex[_rpo[i]] = i;
+    }
+}
+
+// DOMINATORS =================================================================
+
+void CFG::dominators() {
+    _idom.assign(size(), -1);
+    _idom[0] = 0;
+
+    // Walk up from a and b until the paths meet. Dominators come before the
+    // blocks they dominate in reverse postorder, so the block further along
+    // is the one to move.
+    auto intersect = [this](int32_t a, int32_t b) {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b]) {
+                a = _idom[a];
+            }
+            while (rpoIndex[b] > rpoIndex[a]) {
+                b = _idom[b];
+            }
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < _rpo.size(); i++) {
+            int32_t b = _rpo[i];
+            int32_t newIdom = -1;
+            for (int32_t p : predecessors(b)) {
+                if (_idom[p] >= 0) {
+                    newIdom = newIdom < 0 ? p : intersect(p, newIdom);
+                }
+            }
+            if (_idom[b] != newIdom) {
+                _idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+}
+
+// Children lists, and preorder intervals so that dominates() is two compares
+void CFG::tree() {
+    size_t n = size();
+    pairs.clear();
+    for (size_t i = 1; i < _rpo.size(); i++) {
+        pairs.insert(pairs.end(), {_idom[_rpo[i]], _rpo[i]});
+    }
+    group(pairs, n, childStart, child);
+
+    treeFirst.assign(n, UINT32_MAX);
+    treeLast.assign(n, 0);
+    if (_rpo.empty()) {
+        return;
+    }
+
+    // Blocks are pushed once to enter them and left on the stack to be
+    // finished once everything above them is done
+    uint32_t counter = 0;
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+        int32_t b = stack.back();
+        if (treeFirst[b] == UINT32_MAX) {
+            treeFirst[b] = counter++;
+            for (int32_t c : dominated(b)) {
+                stack.push_back(c);
+            }
+            continue;
+        }
+        stack.pop_back();
+        treeLast[b] = counter - 1;
+    }
+}
+
+// For every join point, walk up from each predecessor to the join's immediate
+// dominator; the join is in the frontier of every block passed on the way
+void CFG::frontiers() {
+    size_t n = size();
+    pairs.clear();
+    mark.assign(n, -1);         // Last join added to each block's frontier
+
+    for (int32_t b : _rpo) {
+        if (predecessors(b).size() < 2) {
+            continue;
+        }
+        for (int32_t p : predecessors(b)) {
+            for (int32_t runner = p; reachable(runner) && runner != _idom[b]; runner = _idom[runner]) {
+                if (mark[runner] == b) {
+                    break;
+                }
+                mark[runner] = b;
+                pairs.insert(pairs.end(), {runner, b});
+            }
+        }
+    }
+    group(pairs, n, dfStart, df);
+}
+
+void CFG::loops() {
+    _preheader.assign(size(), NOT_A_LOOP);
+    headers.clear();
+
+    for (int32_t h : _rpo) {
+        int32_t outside = -1;
+        size_t outsideCount = 0;
+        bool header = false;
+        for (int32_t p : predecessors(h)) {
+            if (dominates(h, p)) {
+                header = true;
+            } else if (reachable(p)) {
+                outside = p;
+                outsideCount++;
+            }
+        }
+        if (!header) {
+            continue;
+        }
+
+        headers.push_back(h);
+        bool dedicated = outsideCount == 1 && successors(outside).size() == 1;
+        _preheader[h] = dedicated ? outside : -1;
+    }
+}
+
+void CFG::build(const Function& f) {
+    edges(f);
+    order();
+    dominators();
+    tree();
+    frontiers();
+    loops();
+}
+
+// UNREACHABLE BLOCKS =========================================================
+
+// Keep the blocks keep(b) is true of, renumbering them in order
+template <typename Keep>
+static size_t deleteBlocks(Function& f, Keep keep) {
+    size_t n = f.blocks.size();
+    std::vector<int32_t> number(n, -1);
+    int32_t kept = 0;
+    for (size_t b = 0; b < n; b++) {
+        if (keep(b)) {
+            number[b] = kept++;
+        }
+    }
+    if (size_t(kept) == n) {
+        return 0;
+    }
+
+    // Slide the kept blocks down over the deleted ones
+    uint32_t out = 0;
+    for (size_t b = 0; b < n; b++) {
+        if (number[b] < 0) {
+            continue;
+        }
+
+        BasicBlock block = f.blocks[b];
+        BasicBlock moved{out, 0};
+        for (uint32_t i = block.start; i < block.end; i++) {
+            Instr in = f.code[i];
+            if (in.op == Instr::JMP) {
+                in.a = number[in.a];
+            } else if (in.op == Instr::BR) {
+                in.b = number[in.b];
+                in.dst = number[in.dst];
+            } else if (in.op == Instr::PHI) {
+                int live = 0;
+                for (int pair = 0; pair < in.count; pair++) {
+                    int32_t from = f.operands[in.b + 2 * pair];
+                    if (number[from] >= 0) {
+                        f.operands[in.b + 2 * live] = number[from];
+                        f.operands[in.b + 2 * live + 1] = f.operands[in.b + 2 * pair + 1];
+                        live++;
+                    }
+                }
+                in.count = live;
+            }
+            f.code[out++] = in;
+        }
+        moved.end = out;
+        f.blocks[number[b]] = moved;
+    }
+
+    f.code.resize(out);
+    f.blocks.resize(kept);
+    return n - kept;
+}
+
+size_t removeUnreachable(Function& f, const CFG& cfg) {
+    if (cfg.rpo().size() == f.blocks.size()) {
+        return 0;
+    }
+    return deleteBlocks(f, [&](int32_t b) { return cfg.reachable(b); });
+}
+
+size_t removeBlocks(Function& f, const BitSet& live) {
+    return deleteBlocks(f, [&](int32_t b) { return live.test(b); });
+}
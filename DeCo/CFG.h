@@ -0,0 +1,119 @@
+#ifndef _CFG_H_
+#define _CFG_H_
+
+#include <cstdint>
+#include <vector>
+#include "BitSet.h"
+#include "IR.h"
+
+// A run of block numbers stored in one of the CFG's flat arrays
+class BlockList {
+private:
+
+    const int32_t* first;
+    const int32_t* last;
+
+public:
+
+    BlockList(const int32_t* f, const int32_t* l): first(f), last(l) {}
+
+    const int32_t* begin() const { return first; }
+    const int32_t* end() const { return last; }
+    size_t size() const { return last - first; }
+    int32_t operator[](size_t i) const { return first[i]; }
+};
+
+// Control-flow graph of one function, with its dominator tree, dominance
+// frontiers and loop headers. Every relation is stored as a flat array of
+// block numbers plus a start offset per block, so a graph with n blocks and
+// e edges is a handful of vectors rather than n small ones, and building it
+// again for another function reuses their storage.
+//
+// Dominators are found with the iterative algorithm of Cooper, Harvey and
+// Kennedy ("A Simple, Fast Dominance Algorithm"), which walks the blocks in
+// reverse postorder and intersects dominator tree paths. Blocks that cannot
+// be reached from the entry have no dominator and are not in rpo().
+class CFG {
+private:
+
+    std::vector<uint32_t> succStart;
+    std::vector<int32_t> succ;
+    std::vector<uint32_t> predStart;
+    std::vector<int32_t> pred;
+    std::vector<int32_t> _rpo;
+    std::vector<int32_t> rpoIndex;      // Position in _rpo, or -1 if unreachable
+    std::vector<int32_t> _idom;         // Immediate dominator (the entry's is itself), or -1
+    std::vector<uint32_t> childStart;   // Dominator tree
+    std::vector<int32_t> child;
+    std::vector<uint32_t> treeFirst;    // Preorder number of each block in the dominator tree
+    std::vector<uint32_t> treeLast;     // Highest preorder number below it
+    std::vector<uint32_t> dfStart;
+    std::vector<int32_t> df;
+    std::vector<int32_t> _preheader;    // Of loop headers (-1 if they have none), else NOT_A_LOOP
+    std::vector<int32_t> headers;       // Loop headers in reverse postorder
+
+    // Scratch space
+    std::vector<int32_t> stack;
+    std::vector<int32_t> mark;
+    std::vector<int32_t> pairs;
+
+    void edges(const Function& f);
+    void order();
+    void dominators();
+    void tree();
+    void frontiers();
+    void loops();
+
+    static BlockList list(const std::vector<int32_t>& items, const std::vector<uint32_t>& start, int32_t b) {
+        return BlockList(items.data() + start[b], items.data() + start[b + 1]);
+    }
+
+public:
+
+    // preheader() of blocks that are not loop headers
+    static constexpr int32_t NOT_A_LOOP = -2;
+
+    void build(const Function& f);
+
+    size_t size() const { return succStart.size() - 1; }
+
+    BlockList successors(int32_t b) const { return list(succ, succStart, b); }
+    BlockList predecessors(int32_t b) const { return list(pred, predStart, b); }
+
+    // Reachable blocks in reverse postorder; the entry is first
+    const std::vector<int32_t>& rpo() const { return _rpo; }
+    bool reachable(int32_t b) const { return rpoIndex[b] >= 0; }
+
+    int32_t idom(int32_t b) const { return _idom[b]; }
+    BlockList dominated(int32_t b) const { return list(child, childStart, b); }
+    bool dominates(int32_t a, int32_t b) const {
+        return reachable(b) && treeFirst[a] <= treeFirst[b] && treeFirst[b] <= treeLast[a];
+    }
+
+    // Blocks where b's dominance ends: those with a predecessor b dominates
+    // that b itself does not strictly dominate
+    BlockList frontier(int32_t b) const { return list(df, dfStart, b); }
+
+    // Loop headers are the targets of back edges, edges whose source the
+    // target dominates. A header's preheader is its only predecessor outside
+    // the loop, when that block has no other successor.
+    const std::vector<int32_t>& loopHeaders() const { return headers; }
+    bool isLoopHeader(int32_t b) const { return _preheader[b] != NOT_A_LOOP; }
+    int32_t preheader(int32_t h) const { return _preheader[h]; }
+};
+
+// Turn a flat list of (from, to) pairs into the to's grouped by from: the
+// to's of from are items[start[from]] up to items[start[from + 1]]
+void group(const std::vector<int32_t>& pairs, size_t froms, std::vector<uint32_t>& start,
+    std::vector<int32_t>& items);
+
+// Delete the blocks cfg found unreachable, renumbering the rest and dropping
+// PHI pairs for the edges that went away. Returns how many were deleted; cfg
+// must be built again afterwards if any were.
+size_t removeUnreachable(Function& f, const CFG& cfg);
+
+// The same for the blocks not in live. Every edge into a live block must come
+// from a live block or from a block being deleted.
+size_t removeBlocks(Function& f, const BitSet& live);
+
+#endif
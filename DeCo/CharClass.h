@@ -0,0 +1,56 @@
+#ifndef _CHAR_CLASS_H_
+#define _CHAR_CLASS_H_
+
+#include <cstdint>
+
+// Character classes for the DeCo scanner, as one constexpr lookup table.
+// Unlike <ctype.h> this ignores the locale and inlines to a single load.
+namespace CharClass {
+
+enum Class : uint8_t {
+    SPACE = 1 << 0,         // ' ', '\t', '\n', '\v', '\f', '\r'
+    LETTER = 1 << 1,        // 'a'-'z', 'A'-'Z'
+    DIGIT = 1 << 2,         // '0'-'9'
+    UNDERSCORE = 1 << 3,    // '_'
+    OPERATOR = 1 << 4,      // First character of an operator or comment
+    DELIMITER = 1 << 5,     // ( ) { } [ ] , : ;
+
+    ALNUM = LETTER | DIGIT,
+    IDENT = LETTER | DIGIT | UNDERSCORE,
+    // Characters that may directly follow an identifier or number
+    TOKEN_BOUNDARY = SPACE | LETTER | DIGIT | OPERATOR | DELIMITER,
+};
+
+struct Table {
+    uint8_t classes[256] = {};
+
+    constexpr void add(const char* chars, uint8_t cls) {
+        for (; *chars; chars++) {
+            classes[(unsigned char)*chars] |= cls;
+        }
+    }
+
+    constexpr Table() {
+        add(" \t\n\v\f\r", SPACE);
+        add("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ", LETTER);
+        add("0123456789", DIGIT);
+        add("_", UNDERSCORE);
+        add("&|!+-*/%^=<>", OPERATOR);
+        add("(){}[],:;", DELIMITER);
+    }
+};
+
+inline constexpr Table table;
+
+// Whether c has any of the classes in mask. EOF (or any negative value) has
+// no class, so callers that accept EOF must check for it separately.
+inline bool is(int c, uint8_t mask) {
+    return c >= 0 && (table.classes[(unsigned char)c] & mask);
+}
+
+static_assert(table.classes['_'] == UNDERSCORE && table.classes['/'] == OPERATOR,
+    "Character class table is malformed");
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "CFG.h"
+#include "DeadCode.h"
+
+// Instructions that matter whether or not anything reads their result
+static bool hasEffect(const Instr& in) {
+    switch (in.op) {
+        case Instr::STOREG:
+        case Instr::STORE:
+        case Instr::CALL:
+        case Instr::JMP:
+        case Instr::BR:
+        case Instr::RET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// DEAD CODE ==================================================================
+
+void DeadCodeElimination::mark(Function& f) {
+    defAt.assign(f.vregCount(), -1);
+    live.assign(f.vregCount());
+    work.clear();
+
+    auto use = [&](int32_t& v) {
+        if (live.insert(v)) {
+            work.push_back(v);
+        }
+    };
+
+    for (size_t i = 0; i < f.code.size(); i++) {
+        Instr& in = f.code[i];
+        if (in.definesDst()) {
+            defAt[in.dst] = i;
+        }
+        if (hasEffect(in)) {
+            f.forEachUse(in, use);
+        }
+    }
+
+    while (!work.empty()) {
+        int32_t v = work.back();
+        work.pop_back();
+        // Parameters have no defining instruction
+        if (defAt[v] >= 0) {
+            f.forEachUse(f.code[defAt[v]], use);
+        }
+    }
+}
+
+void DeadCodeElimination::sweep(Function& f) {
+    for (Instr& in : f.code) {
+        if (!in.definesDst() || live.test(in.dst)) {
+            continue;
+        }
+        if (in.op == Instr::CALL) {
+            in.dst = -1;
+            unusedResults++;
+        } else if (!hasEffect(in)) {
+            in.op = Instr::NOP;
+            removed++;
+        }
+    }
+}
+
+void DeadCodeElimination::run(Function& f) {
+    mark(f);
+    sweep(f);
+}
+
+void DeadCodeElimination::printCounters(std::ostream& out) const {
+    out << removed << " dead values, " << unusedResults << " unused call results";
+}
+
+// UNREACHABLE BLOCKS =========================================================
+
+void UnreachableBlockElimination::run(Function& f) {
+    reached.assign(f.blocks.size());
+    reached.set(0);
+    work.assign(1, 0);
+
+    auto reach = [&](int32_t b) {
+        if (reached.insert(b)) {
+            work.push_back(b);
+        }
+    };
+
+    while (!work.empty()) {
+        const Instr& last = f.code[f.blocks[work.back()].end - 1];
+        work.pop_back();
+        if (last.op == Instr::JMP) {
+            reach(last.a);
+        } else if (last.op == Instr::BR) {
+            reach(last.b);
+            reach(last.dst);
+        }
+    }
+
+    removed += removeBlocks(f, reached);
+}
@@ -0,0 +1,68 @@
+#ifndef _DEAD_CODE_H_
+#define _DEAD_CODE_H_
+
+#include <vector>
+#include "BitSet.h"
+#include "IR.h"
+#include "Pass.h"
+
+// Mark-and-sweep dead code elimination over functions in SSA form. Stores,
+// calls and control flow are live; so is every vreg a live instruction
+// reads, found by following each one to the instruction that defines it.
+// Everything else is deleted, including variables that are written but never
+// read and loops of PHIs that only feed each other. A call whose result is
+// never read stays, but stops writing it.
+//
+// Marking uses a bitset over vregs and a worklist instead of recursion, so
+// long dependence chains cost no stack.
+class DeadCodeElimination : public Pass {
+private:
+
+    // Scratch space, reused for every function
+    std::vector<int32_t> defAt;         // Instruction defining each vreg, or -1
+    BitSet live;                        // Vregs some live instruction reads
+    std::vector<int32_t> work;
+
+    // Totals since resetCounters()
+    size_t removed;
+    size_t unusedResults;
+
+    void mark(Function& f);
+    void sweep(Function& f);
+
+public:
+
+    DeadCodeElimination() { resetCounters(); }
+
+    using Pass::run;
+    const char* name() const override { return "dce"; }
+    void run(Function& f) override;
+
+    void resetCounters() override { removed = unusedResults = 0; }
+    void printCounters(std::ostream& out) const override;
+};
+
+// Deletes the blocks that cannot be reached from the entry, such as code
+// after a return or after an endless loop. Works on any function, in SSA
+// form or not: PHIs lose the pairs for the edges that went away.
+// Reachability is a worklist search marking a bitset.
+class UnreachableBlockElimination : public Pass {
+private:
+
+    BitSet reached;
+    std::vector<int32_t> work;
+    size_t removed;                     // Since resetCounters()
+
+public:
+
+    UnreachableBlockElimination() { resetCounters(); }
+
+    using Pass::run;
+    const char* name() const override { return "unreachable"; }
+    void run(Function& f) override;
+
+    void resetCounters() override { removed = 0; }
+    void printCounters(std::ostream& out) const override { out << removed << " blocks removed"; }
+};
+
+#endif
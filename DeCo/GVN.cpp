@@ -0,0 +1,159 @@
+#include <algorithm>
+#include "GVN.h"
+
+// Ops whose result depends on nothing but their fields and operands
+static bool numbered(Instr::Op op) {
+    return op == Instr::CONST || (op >= Instr::ADD && op <= Instr::GE) || op == Instr::GADDR
+        || op == Instr::OFFSET;
+}
+
+static bool commutative(Instr::Op op) {
+    switch (op) {
+        case Instr::ADD:
+        case Instr::MUL:
+        case Instr::AND:
+        case Instr::OR:
+        case Instr::EQ:
+        case Instr::NE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t hash(const Instr& in) {
+    uint64_t h = uint64_t(uint32_t(in.a)) << 32 | uint32_t(in.b);
+    h ^= (uint64_t(in.op) << 8 | in.type) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return uint32_t(h >> 32);
+}
+
+static bool sameExpression(const Instr& x, const Instr& y) {
+    return x.op == y.op && x.type == y.type && x.a == y.a && x.b == y.b;
+}
+
+int32_t ValueNumbering::find(int32_t v) const {
+    while (leader[v] != v) {
+        v = leader[v];
+    }
+    return v;
+}
+
+// Look the instruction's expression up, deleting it if a dominating
+// instruction already computes it and adding it to the table otherwise
+void ValueNumbering::number(Function& f, int32_t i) {
+    Instr& in = f.code[i];
+    if (commutative(in.op) && in.a > in.b) {
+        std::swap(in.a, in.b);
+    }
+
+    uint32_t h = hash(in);
+    size_t mask = slots.size() - 1;
+    for (size_t s = h & mask;; s = (s + 1) & mask) {
+        Slot& slot = slots[s];
+        if (slot.instr < 0) {
+            slot = Slot{h, i};
+            added.push_back(s);
+            return;
+        }
+        const Instr& other = f.code[slot.instr];
+        if (slot.hash == h && sameExpression(other, in)) {
+            leader[in.dst] = other.dst;
+            in.op = Instr::NOP;
+            redundant++;
+            return;
+        }
+    }
+}
+
+void ValueNumbering::visit(Function& f, int32_t b) {
+    for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+        Instr& in = f.code[i];
+
+        if (in.op == Instr::PHI) {
+            // Operands along back edges may not be numbered yet; they are
+            // only compared as they are, which can miss a match but never
+            // makes a wrong one
+            int32_t same = -1;
+            bool trivial = true;
+            for (int pair = 0; pair < in.count && trivial; pair++) {
+                int32_t v = find(f.operands[in.b + 2 * pair + 1]);
+                if (v != in.dst) {
+                    trivial = same < 0 || v == same;
+                    same = v;
+                }
+            }
+            if (trivial && same >= 0) {
+                leader[in.dst] = same;
+                in.op = Instr::NOP;
+                phis++;
+            }
+            continue;
+        }
+
+        // Everything else reads vregs from dominating blocks, which have
+        // all been numbered
+        f.forEachUse(in, [&](int32_t& v) { v = find(v); });
+        if (in.op == Instr::MOV) {
+            leader[in.dst] = in.a;
+            in.op = Instr::NOP;
+            copies++;
+        } else if (numbered(in.op)) {
+            number(f, i);
+        }
+    }
+}
+
+void ValueNumbering::run(Function& f) {
+    cfg.build(f);
+
+    size_t size = 16;
+    while (size < 2 * f.code.size()) {
+        size *= 2;
+    }
+    // Every walk empties the table again, so it only needs resetting to grow
+    if (slots.size() < size) {
+        slots.assign(size, Slot{0, -1});
+    }
+
+    leader.resize(f.vregCount());
+    for (size_t v = 0; v < leader.size(); v++) {
+        leader[v] = v;
+    }
+    added.clear();
+    addedMark.resize(f.blocks.size());
+
+    // Blocks are pushed to enter them and ~b below their children to leave
+    // them, emptying the slots they filled
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+        int32_t b = stack.back();
+        stack.pop_back();
+        if (b < 0) {
+            for (size_t i = added.size(); i > addedMark[~b]; i--) {
+                slots[added[i - 1]].instr = -1;
+            }
+            added.resize(addedMark[~b]);
+            continue;
+        }
+
+        addedMark[b] = added.size();
+        stack.push_back(~b);
+        for (int32_t c : cfg.dominated(b)) {
+            stack.push_back(c);
+        }
+        visit(f, b);
+    }
+
+    // PHI operands along back edges can name values numbered after the PHI
+    for (Instr& in : f.code) {
+        if (in.op == Instr::PHI) {
+            f.forEachUse(in, [&](int32_t& v) { v = find(v); });
+        }
+    }
+}
+
+void ValueNumbering::printCounters(std::ostream& out) const {
+    out << redundant << " redundant, " << copies << " copies, " << phis << " trivial phis";
+}
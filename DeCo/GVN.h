@@ -0,0 +1,64 @@
+#ifndef _GVN_H_
+#define _GVN_H_
+
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+#include "Pass.h"
+
+// Dominator-based global value numbering (Briggs, Cooper and Simpson) over
+// functions in SSA form. The dominator tree is walked from the entry with a
+// hash table of the expressions computed so far: an instruction whose
+// operation, type and operands are already in the table computes a value a
+// dominating instruction has, so it is deleted and its uses read that one
+// instead. Entries are taken out again when the walk leaves the block that
+// added them, so only expressions from dominating blocks are ever found.
+//
+// Before hashing, the operands of +, *, &&, ||, == and != are put in vreg
+// order, so a * b and b * a are the same expression. Copies are replaced by
+// what they copy, and a PHI whose operands are all one value (or the PHI
+// itself) by that value. Loads are not numbered, since a store in between
+// may change what they read.
+//
+// The table uses open addressing and is sized to be at most half full, so it
+// never grows during a walk, and entries can be removed by emptying their
+// slots in the reverse of the order they were added.
+class ValueNumbering : public Pass {
+private:
+
+    struct Slot {
+        uint32_t hash;
+        int32_t instr;      // Instruction computing the expression, or -1 if free
+    };
+
+    CFG cfg;
+
+    // Scratch space, reused for every function
+    std::vector<Slot> slots;            // Power of two
+    std::vector<int32_t> leader;        // Vreg holding the same value, or the vreg itself
+    std::vector<uint32_t> added;        // Slots filled, in order
+    std::vector<uint32_t> addedMark;    // added size when each block was entered
+    std::vector<int32_t> stack;
+
+    // Totals since resetCounters()
+    size_t redundant;
+    size_t copies;
+    size_t phis;
+
+    int32_t find(int32_t v) const;
+    void number(Function& f, int32_t i);
+    void visit(Function& f, int32_t b);
+
+public:
+
+    ValueNumbering() { resetCounters(); }
+
+    using Pass::run;
+    const char* name() const override { return "gvn"; }
+    void run(Function& f) override;
+
+    void resetCounters() override { redundant = copies = phis = 0; }
+    void printCounters(std::ostream& out) const override;
+};
+
+#endif
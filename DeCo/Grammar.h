@@ -0,0 +1,285 @@
+#ifndef _GRAMMAR_H_
+#define _GRAMMAR_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include "Scanner.h"
+
+enum NonTerminal {
+    // Operators (POW_OP not needed since it is unique)
+    MUL_OP, ADD_OP, REL_OP, ASSIGN_OP, UNARY_OP,
+
+    // Type
+    TYPE,
+
+    // Literals (integer and float handled by Scanner)
+    BOOL_LIT, LITERAL,
+
+    // Designator (ident handled by Scanner)
+    DESIGNATOR,
+
+    // Expression-related nonterminals
+    GROUP_EXPR, POW_EXPR, MULT_EXPR, ADD_EXPR, REL_EXPR, RELATION,
+
+    // Statements
+    ASSIGN, FUNC_CALL, ASSIGN_STAT, FUNC_CALL_STAT, IF_STAT, WHILE_STAT,
+    DO_WHILE_STAT, FOR_STAT, REPEAT_STAT, RETURN_STAT, STATEMENT, STAT_SEQ,
+
+    // Declarations
+    TYPE_DECL, VAR_DECL, PARAM_TYPE, PARAM_DECL, DECL_LIST,
+
+    // Functions
+    PARAM_LIST, FUNC_BODY, FUNC_DECL,
+
+    // Program
+    PROGRAM,
+
+    // Used for getting size of enum
+    SIZE,
+};
+
+// The DeCo grammar (see README.md), reduced to what FIRST sets are computed
+// from. The sets are built at compile time, one uint64_t bit mask per
+// nonterminal with bit k set for Token::Kind k.
+namespace Grammar {
+
+static_assert(Token::Kind::SIZE <= 64, "Token kinds no longer fit in a 64-bit FIRST set");
+
+using TokenSet = uint64_t;
+
+constexpr TokenSet bit(Token::Kind kind) {
+    return TokenSet(1) << kind;
+}
+
+constexpr TokenSet tokens(std::initializer_list<Token::Kind> kinds) {
+    TokenSet set = 0;
+    for (Token::Kind k : kinds) {
+        set |= bit(k);
+    }
+    return set;
+}
+
+// A terminal or nonterminal on the right-hand side of a rule
+struct Symbol {
+    int id;
+    bool terminal;
+    bool optional;      // Inside [ ] or { }, so the symbol after it may start the rule too
+
+    constexpr Symbol(Token::Kind k): id(k), terminal(true), optional(false) {}
+    constexpr Symbol(NonTerminal nt): id(nt), terminal(false), optional(false) {}
+};
+
+constexpr Symbol opt(Symbol s) {
+    s.optional = true;
+    return s;
+}
+
+// One alternative of a production. Only the leading symbols are listed, up to
+// and including the first one that must be present, since nothing after it
+// can contribute to FIRST.
+struct Rule {
+    static const int MAX_PREFIX = 3;
+
+    NonTerminal lhs;
+    int length;
+    Symbol prefix[MAX_PREFIX];
+
+    constexpr Rule(NonTerminal nt, std::initializer_list<Symbol> syms)
+        : lhs(nt), length(0), prefix{Token::Kind(0), Token::Kind(0), Token::Kind(0)} {
+        for (Symbol s : syms) {
+            prefix[length++] = s;
+        }
+    }
+};
+
+using K = Token::Kind;
+
+constexpr Rule rules[] = {
+    // powOp = "^" is matched directly
+    {MUL_OP, {K::MUL}}, {MUL_OP, {K::DIV}}, {MUL_OP, {K::MOD}}, {MUL_OP, {K::AND}},
+    {ADD_OP, {K::ADD}}, {ADD_OP, {K::SUB}}, {ADD_OP, {K::OR}},
+    {REL_OP, {K::EQUAL_TO}}, {REL_OP, {K::NOT_EQUAL}}, {REL_OP, {K::LESS_THAN}},
+    {REL_OP, {K::LESS_EQUAL}}, {REL_OP, {K::GREATER_THAN}}, {REL_OP, {K::GREATER_EQUAL}},
+    {ASSIGN_OP, {K::ASSIGN}}, {ASSIGN_OP, {K::ADD_ASSIGN}}, {ASSIGN_OP, {K::SUB_ASSIGN}},
+    {ASSIGN_OP, {K::MUL_ASSIGN}}, {ASSIGN_OP, {K::DIV_ASSIGN}}, {ASSIGN_OP, {K::MOD_ASSIGN}},
+    {ASSIGN_OP, {K::POW_ASSIGN}},
+    {UNARY_OP, {K::UNI_INC}}, {UNARY_OP, {K::UNI_DEC}},
+
+    // type = "bool" | "int" | "float"
+    {TYPE, {K::BOOL}}, {TYPE, {K::INT}}, {TYPE, {K::FLOAT}},
+
+    // boolLit = "true" | "false"
+    {BOOL_LIT, {K::TRUE}}, {BOOL_LIT, {K::FALSE}},
+    // literal = boolLit | integerLit | floatLit
+    {LITERAL, {BOOL_LIT}}, {LITERAL, {K::INT_VAL}}, {LITERAL, {K::FLOAT_VAL}},
+
+    // designator = ident { "[" relExpr "]" }
+    {DESIGNATOR, {K::IDENT}},
+    // groupExpr = literal | designator | "!" relExpr | relation | funcCall
+    {GROUP_EXPR, {LITERAL}}, {GROUP_EXPR, {DESIGNATOR}}, {GROUP_EXPR, {K::NOT}},
+    {GROUP_EXPR, {RELATION}}, {GROUP_EXPR, {FUNC_CALL}},
+    // powExpr = groupExpr { powOp groupExpr }
+    {POW_EXPR, {GROUP_EXPR}},
+    // mulExpr = powExpr { mulOp powExpr }
+    {MULT_EXPR, {POW_EXPR}},
+    // addExpr = mulExpr { addOp mulExpr }
+    {ADD_EXPR, {MULT_EXPR}},
+    // relExpr = addExpr { relOp addExpr }
+    {REL_EXPR, {ADD_EXPR}},
+    // relation = "(" relExpr ")"
+    {RELATION, {K::OPEN_PAREN}},
+
+    // assign = designator ( ( assignOp relExpr ) | unaryOp )
+    {ASSIGN, {DESIGNATOR}},
+    // funcCall = "call" ident "(" [ relExpr { "," relExpr } ] ")"
+    {FUNC_CALL, {K::CALL}},
+    // assignStat = assign ";"
+    {ASSIGN_STAT, {ASSIGN}},
+    // funcCallStat = funcCall ";"
+    {FUNC_CALL_STAT, {FUNC_CALL}},
+    // ifStat = "if" relation "{" [ statSeq ] "}" [ "else" "{" [ statSeq ] "}" ]
+    {IF_STAT, {K::IF}},
+    // whileStat = "while" relation "{" [ statSeq ] "}"
+    {WHILE_STAT, {K::WHILE}},
+    // doWhileStat = "do" "{" [ statSeq ] "}" "while" relation ";"
+    {DO_WHILE_STAT, {K::DO}},
+    // forStat = "for" "(" [ assign ] ";" [ relExpr ] ";" [ assign ] ")" "{" [ statSeq ] "}"
+    {FOR_STAT, {K::FOR}},
+    // repeatStat = "repeat" "{" [ statSeq ] "}" "until" relation ";"
+    {REPEAT_STAT, {K::REPEAT}},
+    // returnStat = "return" [ relExpr ] ";"
+    {RETURN_STAT, {K::RETURN}},
+
+    // statement = varDecl | assignStat | funcCallStat | ifStat | whileStat
+    //             | doWhileStat | forStat | repeatStat | returnStat
+    {STATEMENT, {VAR_DECL}}, {STATEMENT, {ASSIGN_STAT}}, {STATEMENT, {FUNC_CALL_STAT}},
+    {STATEMENT, {IF_STAT}}, {STATEMENT, {WHILE_STAT}}, {STATEMENT, {DO_WHILE_STAT}},
+    {STATEMENT, {FOR_STAT}}, {STATEMENT, {REPEAT_STAT}}, {STATEMENT, {RETURN_STAT}},
+    // statSeq = statement { statement }
+    {STAT_SEQ, {STATEMENT}},
+
+    // typeDecl = type { "[" integerLit "]" }
+    {TYPE_DECL, {TYPE}},
+    // varDecl = typeDecl ident { "," ident } ";"
+    {VAR_DECL, {TYPE_DECL}},
+    // paramType = type { "[" "]" }
+    {PARAM_TYPE, {TYPE}},
+    // paramDecl = paramType ident
+    {PARAM_DECL, {PARAM_TYPE}},
+    // paramList = "(" [ paramDecl { "," paramDecl } ] ")"
+    {PARAM_LIST, {K::OPEN_PAREN}},
+    // funcBody = "{" [ statSeq ] "}"
+    {FUNC_BODY, {K::OPEN_BRACE}},
+    // funcDecl = "function" ident paramList ":" ( "void" | type ) funcBody
+    {FUNC_DECL, {K::FUNC}},
+
+    // declList = ( varDecl | funcDecl ) { varDecl | funcDecl }
+    {DECL_LIST, {VAR_DECL}}, {DECL_LIST, {FUNC_DECL}},
+
+    // program = [ declList ] "main" "(" ")" ":" "void" "{" [ statSeq ] "}"
+    {PROGRAM, {opt(DECL_LIST), K::MAIN}},
+};
+
+// FIRST sets of every nonterminal, computed by iterating over the rules until
+// nothing changes
+struct FirstSets {
+    TokenSet sets[NonTerminal::SIZE] = {};
+
+    constexpr TokenSet of(Symbol s) const {
+        return s.terminal ? bit(Token::Kind(s.id)) : sets[s.id];
+    }
+
+    constexpr TokenSet of(const Rule& r) const {
+        TokenSet set = 0;
+        for (int i = 0; i < r.length; i++) {
+            set |= of(r.prefix[i]);
+            if (!r.prefix[i].optional) {
+                break;
+            }
+        }
+        return set;
+    }
+
+    constexpr FirstSets() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const Rule& r : rules) {
+                TokenSet set = sets[r.lhs] | of(r);
+                changed = changed || set != sets[r.lhs];
+                sets[r.lhs] = set;
+            }
+        }
+    }
+
+    constexpr TokenSet operator[](NonTerminal nt) const { return sets[nt]; }
+};
+
+inline constexpr FirstSets first;
+
+// RECOVERY SETS ==============================================================
+
+// After a syntax error the parser skips to a token that can follow the
+// construct it was in, then carries on from there.
+
+// FOLLOW(statement) is FIRST(statement) plus the "}" closing its block. An
+// identifier or "call" can also continue a broken expression, so those are
+// left out to avoid resuming in the middle of one.
+constexpr TokenSet statementSync = (first[STATEMENT] | bit(K::CLOSE_BRACE))
+    & ~tokens({K::IDENT, K::CALL});
+
+// FOLLOW of a declaration: the next declaration or main
+constexpr TokenSet declSync = first[DECL_LIST] | bit(K::MAIN);
+
+// SELF-CHECKS ================================================================
+
+// Every nonterminal has a rule, and every rule ends in a required symbol
+constexpr bool complete() {
+    for (int nt = 0; nt < NonTerminal::SIZE; nt++) {
+        if (first[NonTerminal(nt)] == 0) {
+            return false;
+        }
+    }
+    for (const Rule& r : rules) {
+        if (r.length == 0 || r.prefix[r.length - 1].optional) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The alternatives of every nonterminal start with different tokens, so the
+// parser can pick one by looking at the current token alone
+constexpr bool alternativesDisjoint() {
+    int count = sizeof(rules) / sizeof(rules[0]);
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (rules[i].lhs == rules[j].lhs && (first.of(rules[i]) & first.of(rules[j]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(complete(), "Every nonterminal needs a rule with a required symbol");
+static_assert(alternativesDisjoint(), "Grammar alternatives must have disjoint FIRST sets");
+
+// Choices made inside rule bodies rather than between rules
+static_assert(!(first[ASSIGN_OP] & first[UNARY_OP]), "assign must tell assignOp from unaryOp");
+static_assert(!(first[VAR_DECL] & first[FUNC_DECL]), "declList must tell varDecl from funcDecl");
+static_assert(!(first[TYPE] & bit(K::VOID)), "funcDecl must tell void from type");
+static_assert(!(first[DECL_LIST] & bit(K::MAIN)), "program must tell declList from main");
+
+// Spot checks against the grammar as written in README.md
+static_assert(first[GROUP_EXPR] == tokens({K::TRUE, K::FALSE, K::INT_VAL, K::FLOAT_VAL,
+    K::IDENT, K::NOT, K::OPEN_PAREN, K::CALL}), "FIRST(groupExpr) is wrong");
+static_assert(first[REL_EXPR] == first[GROUP_EXPR], "FIRST(relExpr) is wrong");
+static_assert(first[STAT_SEQ] == tokens({K::BOOL, K::INT, K::FLOAT, K::IDENT, K::CALL, K::IF,
+    K::WHILE, K::DO, K::FOR, K::REPEAT, K::RETURN}), "FIRST(statSeq) is wrong");
+static_assert(first[PROGRAM] == tokens({K::BOOL, K::INT, K::FLOAT, K::FUNC, K::MAIN}),
+    "FIRST(program) is wrong");
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "IR.h"
+
+static_assert(sizeof(Instr) == 16, "IR instructions should stay compact");
+
+static const char* opNames[] = {
+    "nop", "const", "mov", "phi",
+    "add", "sub", "mul", "div", "mod", "pow",
+    "and", "or", "not",
+    "eq", "ne", "lt", "le", "gt", "ge",
+    "loadg", "storeg", "gaddr", "alloca", "offset", "load", "store",
+    "call", "jmp", "br", "ret",
+};
+
+static_assert(sizeof(opNames) / sizeof(opNames[0]) == Instr::OP_COUNT, "Missing opcode name");
+
+static const char* typeNames[] = {"void", "bool", "int", "float", "ptr"};
+
+const char* Instr::opName(Op op) {
+    return opNames[op];
+}
+
+const char* Instr::typeName(Type type) {
+    return typeNames[type];
+}
+
+// FUNCTION ====================================================================
+
+void Function::compact() {
+    uint32_t out = 0;
+    for (BasicBlock& block : blocks) {
+        uint32_t start = out;
+        for (uint32_t i = block.start; i < block.end; i++) {
+            if (code[i].op != Instr::NOP) {
+                code[out++] = code[i];
+            }
+        }
+        block = BasicBlock{start, out};
+    }
+    code.resize(out);
+}
+
+// MODULE ======================================================================
+
+size_t Module::instructionCount() const {
+    size_t count = 0;
+    for (const Function& f : functions) {
+        count += f.code.size();
+    }
+    return count;
+}
+
+size_t Module::blockCount() const {
+    size_t count = 0;
+    for (const Function& f : functions) {
+        count += f.blocks.size();
+    }
+    return count;
+}
+
+// PRINTING ====================================================================
+
+static void printConstant(std::ostream& out, const Instr& in) {
+    switch (in.type) {
+        case Instr::BOOL:
+            out << (in.bits() ? "true" : "false");
+            break;
+        case Instr::FLOAT:
+            out << in.floatValue();
+            break;
+        default:
+            out << in.bits();
+            break;
+    }
+}
+
+void Module::print(std::ostream& out, const Function& f) const {
+    out << "function " << f.name << "(";
+    for (uint32_t p = 0; p < f.params; p++) {
+        out << (p ? ", " : "") << "v" << p << " " << Instr::typeName(f.vregs[p]);
+    }
+    out << ") : " << Instr::typeName(f.returnType);
+    if (f.frameSlots) {
+        out << ", frame " << f.frameSlots << " slots";
+    }
+    out << "\n";
+
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        out << "b" << b << ":\n";
+
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            const Instr& in = f.code[i];
+            out << "    ";
+            if (in.definesDst()) {
+                out << "v" << in.dst << " = ";
+            }
+            out << Instr::opName(in.op);
+            if (in.type != Instr::VOID && in.op != Instr::GADDR && in.op != Instr::ALLOCA && in.op != Instr::OFFSET) {
+                out << "." << Instr::typeName(in.type);
+            }
+
+            switch (in.op) {
+                case Instr::NOP:
+                    break;
+                case Instr::CONST:
+                    out << " ";
+                    printConstant(out, in);
+                    break;
+                case Instr::MOV:
+                case Instr::NOT:
+                    out << " v" << in.a;
+                    break;
+                case Instr::LOADG:
+                case Instr::GADDR:
+                    out << " @" << in.a;
+                    break;
+                case Instr::STOREG:
+                    out << " @" << in.a << ", v" << in.b;
+                    break;
+                case Instr::ALLOCA:
+                    out << " %" << in.a << ", " << in.b;
+                    break;
+                case Instr::STORE:
+                    out << " v" << in.a << ", v" << in.b << ", v" << in.dst;
+                    break;
+                case Instr::CALL:
+                    out << " " << functions[in.a].name << "(";
+                    for (int arg = 0; arg < in.count; arg++) {
+                        out << (arg ? ", v" : "v") << f.operands[in.b + arg];
+                    }
+                    out << ")";
+                    break;
+                case Instr::PHI:
+                    for (int pair = 0; pair < in.count; pair++) {
+                        out << (pair ? ", [b" : " [b") << f.operands[in.b + 2 * pair] << ": v"
+                            << f.operands[in.b + 2 * pair + 1] << "]";
+                    }
+                    break;
+                case Instr::JMP:
+                    out << " b" << in.a;
+                    break;
+                case Instr::BR:
+                    out << " v" << in.a << ", b" << in.b << ", b" << in.dst;
+                    break;
+                case Instr::RET:
+                    if (in.a >= 0) {
+                        out << " v" << in.a;
+                    }
+                    break;
+                default:
+                    out << " v" << in.a << ", v" << in.b;
+                    break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+void Module::print(std::ostream& out) const {
+    if (globalSlots) {
+        out << "globals: " << globalSlots << " slots\n\n";
+    }
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (i) {
+            out << "\n";
+        }
+        print(out, functions[i]);
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef _IR_H_
+#define _IR_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A three-address instruction. Instructions are 16 bytes: an opcode, the type
+// it operates on, a small count, and three 32-bit fields whose meaning depends
+// on the opcode. Values live in virtual registers (vregs), numbered per
+// function; there is no limit on how many a function uses.
+//
+//  Op          type            dst             a               b               Effect
+//  ----------- --------------- --------------- --------------- --------------- ---------------------------
+//  NOP                                                                         (deleted instruction)
+//  CONST       of the value    vreg            low 32 bits     high 32 bits    dst = constant
+//  MOV         of the value    vreg            vreg                            dst = a
+//  PHI         of the value    vreg                            first pair      dst = value from the block we came from
+//  ADD..POW    INT/FLOAT       vreg            vreg            vreg            dst = a op b
+//  AND, OR     BOOL            vreg            vreg            vreg            dst = a op b
+//  NOT         BOOL            vreg            vreg                            dst = !a
+//  EQ..GE      of the operands vreg            vreg            vreg            dst = a op b (a BOOL)
+//  LOADG       of the value    vreg            global slot                     dst = globals[a]
+//  STOREG      of the value                    global slot     vreg            globals[a] = b
+//  GADDR       PTR             vreg            global slot                     dst = &globals[a]
+//  ALLOCA      PTR             vreg            frame slot      slot count      dst = &frame[a], zeroed
+//  OFFSET      PTR             vreg            vreg (PTR)      vreg (INT)      dst = &a[b]
+//  LOAD        of the element  vreg            vreg (PTR)      vreg (INT)      dst = a[b]
+//  STORE       of the element  vreg (value)    vreg (PTR)      vreg (INT)      a[b] = dst
+//  CALL        return type     vreg or -1      function        first argument  dst = a(count arguments)
+//  JMP                                         block                           goto a
+//  BR                          block           vreg (BOOL)     block           goto a ? b : dst
+//  RET         return type                     vreg or -1                      return a
+//
+// Slots are 8 bytes and hold one scalar; INT is 64 bits wide. Arrays are
+// row-major runs of slots addressed by PTR values, and indexes count slots.
+// The arguments of a CALL are the vregs at Function::operands[b], count of
+// them; a PHI has count (block, vreg) pairs there, one per predecessor. PHIs
+// only appear in SSA form, at the start of a block. Every basic block ends in
+// exactly one JMP, BR or RET.
+struct Instr {
+    enum Op : uint8_t {
+        NOP, CONST, MOV, PHI,
+
+        // Arithmetic, in Token::Kind order
+        ADD, SUB, MUL, DIV, MOD, POW,
+
+        // Boolean
+        AND, OR, NOT,
+
+        // Comparisons, in Token::Kind order
+        EQ, NE, LT, LE, GT, GE,
+
+        // Memory
+        LOADG, STOREG, GADDR, ALLOCA, OFFSET, LOAD, STORE,
+
+        // Calls and control flow
+        CALL, JMP, BR, RET,
+
+        // Used for getting size of enum
+        OP_COUNT,
+    };
+
+    enum Type : uint8_t { VOID, BOOL, INT, FLOAT, PTR };
+
+    Op op;
+    Type type;
+    uint16_t count;     // CALL arguments or PHI pairs
+    int32_t dst;
+    int32_t a;
+    int32_t b;
+
+    // The 64 bits of a CONST
+    int64_t bits() const { return int64_t(uint64_t(uint32_t(a)) | uint64_t(uint32_t(b)) << 32); }
+    double floatValue() const {
+        int64_t v = bits();
+        double d;
+        std::memcpy(&d, &v, sizeof d);
+        return d;
+    }
+
+    // Whether dst names a vreg this instruction writes
+    bool definesDst() const { return op != STORE && op != BR && dst >= 0; }
+    bool isTerminator() const { return op == JMP || op == BR || op == RET; }
+
+    static const char* opName(Op op);
+    static const char* typeName(Type type);
+};
+
+// Instructions [start, end) of a function's code
+struct BasicBlock {
+    uint32_t start;
+    uint32_t end;
+};
+
+// One function lowered to IR. Its code is a single buffer in which every block
+// is a contiguous range; block 0 is the entry, and blocks are numbered in the
+// order they appear in the buffer. Vregs 0 to params - 1 hold the arguments.
+struct Function {
+    std::string name;
+    Instr::Type returnType;
+    uint32_t params;
+    uint32_t frameSlots;                // Slots used by local arrays
+    std::vector<Instr> code;
+    std::vector<BasicBlock> blocks;
+    std::vector<int32_t> operands;      // CALL arguments and PHI pairs
+    std::vector<Instr::Type> vregs;     // Type of each vreg
+
+    size_t vregCount() const { return vregs.size(); }
+
+    // Delete the NOPs passes left behind, moving the rest of the code down
+    void compact();
+
+    // Calls f(int32_t& vreg) on every vreg that in reads
+    template <typename F>
+    void forEachUse(Instr& in, F f);
+};
+
+template <typename F>
+void Function::forEachUse(Instr& in, F f) {
+    switch (in.op) {
+        case Instr::NOP:
+        case Instr::CONST:
+        case Instr::LOADG:
+        case Instr::GADDR:
+        case Instr::ALLOCA:
+        case Instr::JMP:
+            break;
+        case Instr::MOV:
+        case Instr::NOT:
+        case Instr::BR:
+            f(in.a);
+            break;
+        case Instr::STOREG:
+            f(in.b);
+            break;
+        case Instr::RET:
+            if (in.a >= 0) {
+                f(in.a);
+            }
+            break;
+        case Instr::STORE:
+            f(in.a);
+            f(in.b);
+            f(in.dst);
+            break;
+        case Instr::CALL:
+            for (int i = 0; i < in.count; i++) {
+                f(operands[in.b + i]);
+            }
+            break;
+        case Instr::PHI:
+            for (int i = 0; i < in.count; i++) {
+                f(operands[in.b + 2 * i + 1]);
+            }
+            break;
+        default:
+            f(in.a);
+            f(in.b);
+            break;
+    }
+}
+
+// A whole program lowered to IR. Functions are numbered in declaration order,
+// with main last; global variables are numbered slots, all zero at startup.
+struct Module {
+    std::vector<Function> functions;
+    uint32_t globalSlots;
+    int32_t main;
+
+    size_t instructionCount() const;
+    size_t blockCount() const;
+
+    // Print every function as text, one instruction per line
+    void print(std::ostream& out = std::cout) const;
+    void print(std::ostream& out, const Function& f) const;
+};
+
+#endif
@@ -0,0 +1,605 @@
+#include <charconv>
+#include <cmath>
+#include "IRGen.h"
+
+// Binary operators map onto opcodes by offset
+static_assert(Instr::POW - Instr::ADD == Token::Kind::POW - Token::Kind::ADD,
+    "Arithmetic opcodes must line up with their operators");
+static_assert(Instr::GE - Instr::EQ == Token::Kind::GREATER_EQUAL - Token::Kind::EQUAL_TO,
+    "Comparison opcodes must line up with their operators");
+static_assert(Token::Kind::POW_ASSIGN - Token::Kind::ADD_ASSIGN == Instr::POW - Instr::ADD,
+    "Compound assignment operators must line up with their opcodes");
+
+static Instr::Op binaryOp(Token::Kind op) {
+    if (op >= Token::Kind::EQUAL_TO) {
+        return Instr::Op(op - Token::Kind::EQUAL_TO + Instr::EQ);
+    }
+    return op == Token::Kind::AND ? Instr::AND : op == Token::Kind::OR ? Instr::OR
+        : Instr::Op(op - Token::Kind::ADD + Instr::ADD);
+}
+
+static int64_t floatBits(double d) {
+    int64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    return bits;
+}
+
+IRGen::IRGen(CompilationUnit& u)
+    : unit(u), types(u.types()), symbols(u.symbols()), fn(nullptr), current(-1) {}
+
+Instr::Type IRGen::valueType(uint32_t t) const {
+    switch (t) {
+        case TypeTable::BOOL: return Instr::BOOL;
+        case TypeTable::INT: return Instr::INT;
+        case TypeTable::FLOAT: return Instr::FLOAT;
+        default: return types.isArray(t) ? Instr::PTR : Instr::VOID;
+    }
+}
+
+// EMITTING CODE ==============================================================
+
+int32_t IRGen::newVreg(Instr::Type t) {
+    vregs.push_back(t);
+    return vregs.size() - 1;
+}
+
+int32_t IRGen::emit(Instr::Op op, Instr::Type type, int32_t dst, int32_t a, int32_t b) {
+    // Code after a return or an endless loop still needs a block to live in
+    if (current < 0) {
+        startBlock(newBlock());
+    }
+
+    code.push_back(Instr{op, type, 0, dst, a, b});
+    if (code.back().isTerminator()) {
+        blocks[current].end = code.size();
+        current = -1;
+    }
+    return dst;
+}
+
+int32_t IRGen::constant(Instr::Type type, int64_t bits, int32_t dst) {
+    if (dst < 0) {
+        dst = newVreg(type);
+    }
+    return emit(Instr::CONST, type, dst, int32_t(bits), int32_t(bits >> 32));
+}
+
+int32_t IRGen::newBlock() {
+    blocks.push_back(BasicBlock{0, 0});
+    merged.push_back(-1);
+    return blocks.size() - 1;
+}
+
+// Later blocks are placed after the current one, which falls through into
+// block if it has not ended yet. A block started while the current one is
+// still empty is merged into it instead, so nested statements do not leave
+// chains of blocks that only jump. The entry block (0) is never merged into,
+// and neither are loop headers, which keep a block of their own that is
+// entered from a single preheader.
+void IRGen::startBlock(int32_t block, bool mergeable) {
+    if (mergeable && current > 0 && blocks[current].start == code.size()) {
+        merged[block] = current;
+        return;
+    }
+
+    jump(block);
+    blocks[block].start = code.size();
+    placed.push_back(block);
+    current = block;
+}
+
+void IRGen::jump(int32_t block) {
+    if (current >= 0) {
+        emit(Instr::JMP, Instr::VOID, -1, block);
+    }
+}
+
+// Return from the end of the body, number blocks by position and copy the
+// function out of the scratch buffers
+void IRGen::finishFunction() {
+    if (current >= 0) {
+        int32_t value = fn->returnType == Instr::VOID ? -1 : constant(fn->returnType, 0);
+        emit(Instr::RET, fn->returnType, -1, value);
+    }
+
+    remap.assign(blocks.size(), -1);
+    for (size_t i = 0; i < placed.size(); i++) {
+        remap[placed[i]] = i;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (merged[b] >= 0) {
+            remap[b] = remap[merged[b]];
+        }
+    }
+    for (Instr& in : code) {
+        if (in.op == Instr::JMP) {
+            in.a = remap[in.a];
+        } else if (in.op == Instr::BR) {
+            in.b = remap[in.b];
+            in.dst = remap[in.dst];
+        }
+    }
+
+    fn->code.assign(code.begin(), code.end());
+    fn->blocks.resize(placed.size());
+    for (size_t i = 0; i < placed.size(); i++) {
+        fn->blocks[i] = blocks[placed[i]];
+    }
+    fn->operands.assign(operands.begin(), operands.end());
+    fn->vregs.assign(vregs.begin(), vregs.end());
+}
+
+// DECLARATIONS ===============================================================
+
+void IRGen::global(Node* n) {
+    for (Node* name = n->child->next; name; name = name->next) {
+        uint32_t slots = 1;
+        for (uint32_t t = symbols[name->sym].type; types.isArray(t); t = types.element(t)) {
+            slots *= types.length(t);
+        }
+        storage[name->sym] = Storage{Storage::GLOBAL, int32_t(module.globalSlots)};
+        module.globalSlots += slots;
+    }
+}
+
+void IRGen::function(Node* n, int32_t index) {
+    fn = &module.functions[index];
+    code.clear();
+    blocks.clear();
+    merged.clear();
+    operands.clear();
+    vregs.clear();
+    placed.clear();
+    current = -1;
+
+    // Array parameters are followed by the lengths of their dimensions
+    Node* c = n->child;
+    for (; c && c->kind == Node::PARAM; c = c->next) {
+        uint32_t t = symbols[c->sym].type;
+        storage[c->sym] = Storage{Storage::VREG, newVreg(valueType(t))};
+        for (; types.isArray(t); t = types.element(t)) {
+            newVreg(Instr::INT);
+        }
+    }
+    fn->params = vregs.size();
+    fn->frameSlots = 0;
+
+    startBlock(newBlock());
+    block(c);
+    finishFunction();
+}
+
+void IRGen::varDecl(Node* n) {
+    for (Node* name = n->child->next; name; name = name->next) {
+        uint32_t t = symbols[name->sym].type;
+        Instr::Type vt = valueType(t);
+        int32_t v = newVreg(vt);
+        storage[name->sym] = Storage{Storage::VREG, v};
+
+        if (vt != Instr::PTR) {
+            constant(vt, 0, v);
+            continue;
+        }
+
+        int32_t slots = 1;
+        for (; types.isArray(t); t = types.element(t)) {
+            slots *= types.length(t);
+        }
+        emit(Instr::ALLOCA, Instr::PTR, v, fn->frameSlots, slots);
+        fn->frameSlots += slots;
+    }
+}
+
+// STATEMENTS =================================================================
+
+void IRGen::block(Node* n) {
+    for (Node* stat = n->child; stat; stat = stat->next) {
+        statement(stat);
+    }
+}
+
+void IRGen::statement(Node* n) {
+    switch (n->kind) {
+        case Node::VAR_DECL:
+            varDecl(n);
+            break;
+        case Node::ASSIGN:
+            assign(n);
+            break;
+        case Node::CALL:
+            call(n, -1);
+            break;
+        case Node::IF: {
+            int32_t then = newBlock();
+            int32_t otherwise = n->child->next->next ? newBlock() : -1;
+            int32_t join = newBlock();
+            branch(n->child, then, otherwise >= 0 ? otherwise : join);
+            startBlock(then);
+            block(n->child->next);
+            jump(join);
+            if (otherwise >= 0) {
+                startBlock(otherwise);
+                block(n->child->next->next);
+                jump(join);
+            }
+            startBlock(join);
+            break;
+        }
+        case Node::WHILE: {
+            int32_t header = newBlock();
+            int32_t body = newBlock();
+            int32_t exit = newBlock();
+            startBlock(header, false);
+            branch(n->child, body, exit);
+            startBlock(body);
+            block(n->child->next);
+            jump(header);
+            startBlock(exit);
+            break;
+        }
+        case Node::DO_WHILE:
+        case Node::REPEAT: {
+            // Both ways of going around again meet in one latch, so that
+            // the loop has a single back edge
+            int32_t body = newBlock();
+            int32_t latch = newBlock();
+            int32_t exit = newBlock();
+            startBlock(body, false);
+            block(n->child);
+            if (n->kind == Node::DO_WHILE) {
+                branch(n->child->next, latch, exit);
+            } else {
+                branch(n->child->next, exit, latch);
+            }
+            startBlock(latch);
+            jump(body);
+            startBlock(exit);
+            break;
+        }
+        case Node::FOR: {
+            Node* init = n->child;
+            Node* cond = init->next;
+            Node* update = cond->next;
+            if (init->kind != Node::EMPTY) {
+                assign(init);
+            }
+
+            int32_t header = newBlock();
+            int32_t body = newBlock();
+            int32_t latch = newBlock();
+            int32_t exit = newBlock();
+            startBlock(header, false);
+            if (cond->kind != Node::EMPTY) {
+                branch(cond, body, exit);
+            }
+            startBlock(body);
+            block(update->next);
+            startBlock(latch);
+            if (update->kind != Node::EMPTY) {
+                assign(update);
+            }
+            jump(header);
+            startBlock(exit);
+            break;
+        }
+        case Node::RETURN: {
+            int32_t value = n->child ? expression(n->child) : -1;
+            emit(Instr::RET, fn->returnType, -1, value);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void IRGen::assign(Node* n) {
+    Node* target = n->child;
+    Place p = place(target);
+    Instr::Type t = valueType(p.type);
+    Token::Kind op = n->opKind();
+
+    if (op == Token::Kind::ASSIGN) {
+        if (p.kind == Place::VREG) {
+            expression(target->next, p.a);
+        } else {
+            store(p, expression(target->next));
+        }
+        return;
+    }
+
+    int32_t old = load(p);
+    int32_t rhs;
+    Instr::Op arith;
+    if (op == Token::Kind::UNI_INC || op == Token::Kind::UNI_DEC) {
+        rhs = constant(t, t == Instr::FLOAT ? floatBits(1.0) : 1);
+        arith = op == Token::Kind::UNI_INC ? Instr::ADD : Instr::SUB;
+    } else {
+        rhs = expression(target->next);
+        arith = Instr::Op(op - Token::Kind::ADD_ASSIGN + Instr::ADD);
+    }
+
+    if (p.kind == Place::VREG) {
+        emit(arith, t, p.a, old, rhs);
+    } else {
+        store(p, emit(arith, t, newVreg(t), old, rhs));
+    }
+}
+
+// Jump to ifTrue or ifFalse, evaluating as little of cond as it takes
+void IRGen::branch(Node* cond, int32_t ifTrue, int32_t ifFalse) {
+    switch (cond->kind) {
+        case Node::NOT:
+            branch(cond->child, ifFalse, ifTrue);
+            return;
+        case Node::LITERAL:
+            jump(cond->opKind() == Token::Kind::TRUE ? ifTrue : ifFalse);
+            return;
+        case Node::BINARY:
+            if (cond->opKind() == Token::Kind::AND || cond->opKind() == Token::Kind::OR) {
+                int32_t right = newBlock();
+                if (cond->opKind() == Token::Kind::AND) {
+                    branch(cond->child, right, ifFalse);
+                } else {
+                    branch(cond->child, ifTrue, right);
+                }
+                startBlock(right);
+                branch(cond->child->next, ifTrue, ifFalse);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    emit(Instr::BR, Instr::VOID, ifFalse, expression(cond), ifTrue);
+}
+
+// EXPRESSIONS ================================================================
+
+// Computes n into dst if it is given, otherwise into whichever vreg is
+// convenient, and returns that vreg
+int32_t IRGen::expression(Node* n, int32_t dst) {
+    switch (n->kind) {
+        case Node::LITERAL:
+            return literal(n, dst);
+        case Node::DESIGNATOR:
+            return load(place(n), dst);
+        case Node::CALL:
+            return call(n, dst);
+        case Node::NOT: {
+            int32_t operand = expression(n->child);
+            return emit(Instr::NOT, Instr::BOOL, dst >= 0 ? dst : newVreg(Instr::BOOL), operand);
+        }
+        default:
+            break;
+    }
+
+    Token::Kind op = n->opKind();
+    Node* left = n->child;
+    Node* right = left->next;
+
+    // The right operand of && and || must not run unless it is needed; when it
+    // is cheap and cannot fail, running it anyway saves the branches
+    if ((op == Token::Kind::AND || op == Token::Kind::OR) && !cheap(right)) {
+        int32_t result = newVreg(Instr::BOOL);
+        int32_t ifTrue = newBlock();
+        int32_t ifFalse = newBlock();
+        int32_t join = newBlock();
+        branch(n, ifTrue, ifFalse);
+        startBlock(ifTrue);
+        constant(Instr::BOOL, 1, result);
+        jump(join);
+        startBlock(ifFalse);
+        constant(Instr::BOOL, 0, result);
+        startBlock(join);
+
+        if (dst >= 0) {
+            return emit(Instr::MOV, Instr::BOOL, dst, result);
+        }
+        return result;
+    }
+
+    int32_t a = expression(left);
+    int32_t b = expression(right);
+    Instr::Op irOp = binaryOp(op);
+    if (irOp >= Instr::EQ) {
+        return emit(irOp, valueType(left->type), dst >= 0 ? dst : newVreg(Instr::BOOL), a, b);
+    }
+
+    Instr::Type t = valueType(n->type);
+    return emit(irOp, t, dst >= 0 ? dst : newVreg(t), a, b);
+}
+
+int32_t IRGen::literal(Node* n, int32_t dst) {
+    std::string_view text = unit.text(n);
+
+    switch (n->opKind()) {
+        case Token::Kind::INT_VAL: {
+            // Out of range literals wrap, like the arithmetic does
+            bool negative = text[0] == '-';
+            uint64_t value = 0;
+            for (char c : text.substr(negative)) {
+                value = value * 10 + (c - '0');
+            }
+            return constant(Instr::INT, negative ? -value : value, dst);
+        }
+        case Token::Kind::FLOAT_VAL: {
+            double value = 0;
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value, std::chars_format::fixed);
+            if (result.ec == std::errc::result_out_of_range) {
+                value = text[0] == '-' ? -HUGE_VAL : HUGE_VAL;
+            }
+            return constant(Instr::FLOAT, floatBits(value), dst);
+        }
+        default:
+            return constant(Instr::BOOL, n->opKind() == Token::Kind::TRUE, dst);
+    }
+}
+
+int32_t IRGen::call(Node* n, int32_t dst) {
+    Function& callee = module.functions[storage[n->sym].index];
+
+    // Nested calls push and pop their own arguments above ours
+    size_t mark = args.size();
+    for (Node* arg = n->child; arg; arg = arg->next) {
+        if (!types.isArray(arg->type)) {
+            int32_t value = expression(arg);
+            args.push_back(value);
+            continue;
+        }
+
+        Place p = place(arg);
+        args.push_back(p.a);
+        int level = p.b;
+        for (uint32_t t = p.type; types.isArray(t); t = types.element(t), level++) {
+            args.push_back(dimension(p.sym, t, level));
+        }
+    }
+
+    int32_t first = operands.size();
+    operands.insert(operands.end(), args.begin() + mark, args.end());
+    uint16_t count = args.size() - mark;
+    args.resize(mark);
+
+    if (callee.returnType == Instr::VOID) {
+        dst = -1;
+    } else if (dst < 0) {
+        dst = newVreg(callee.returnType);
+    }
+    emit(Instr::CALL, callee.returnType, dst, storage[n->sym].index, first);
+    code.back().count = count;
+    return dst;
+}
+
+int32_t IRGen::load(const Place& p, int32_t dst) {
+    Instr::Type t = valueType(p.type);
+
+    switch (p.kind) {
+        case Place::VREG:
+            return dst >= 0 && dst != p.a ? emit(Instr::MOV, t, dst, p.a) : p.a;
+        case Place::GLOBAL:
+            return emit(Instr::LOADG, t, dst >= 0 ? dst : newVreg(t), p.a);
+        default:
+            return emit(Instr::LOAD, t, dst >= 0 ? dst : newVreg(t), p.a, p.b);
+    }
+}
+
+void IRGen::store(const Place& p, int32_t value) {
+    Instr::Type t = valueType(p.type);
+
+    switch (p.kind) {
+        case Place::VREG:
+            emit(Instr::MOV, t, p.a, value);
+            break;
+        case Place::GLOBAL:
+            emit(Instr::STOREG, t, -1, p.a, value);
+            break;
+        default:
+            emit(Instr::STORE, t, value, p.a, p.b);
+            break;
+    }
+}
+
+// Evaluates the indexes of a designator. Indexing every dimension gives an
+// ELEMENT; indexing fewer (or none) gives an ARRAY pointing at the first
+// element of the sub-array
+IRGen::Place IRGen::place(Node* n) {
+    Storage s = storage[n->sym];
+    uint32_t t = symbols[n->sym].type;
+
+    if (!types.isArray(t)) {
+        return Place{s.kind == Storage::GLOBAL ? Place::GLOBAL : Place::VREG, s.index, -1, t, n->sym};
+    }
+
+    int32_t base = s.kind == Storage::GLOBAL ? emit(Instr::GADDR, Instr::PTR, newVreg(Instr::PTR), s.index) : s.index;
+    if (!n->child) {
+        return Place{Place::ARRAY, base, 0, t, n->sym};
+    }
+
+    // Row-major: index = ((i0 * len1 + i1) * len2 + i2) ...
+    int32_t index = expression(n->child);
+    t = types.element(t);
+    int level = 1;
+    for (Node* i = n->child->next; i; i = i->next, level++) {
+        int32_t scaled = emit(Instr::MUL, Instr::INT, newVreg(Instr::INT), index, dimension(n->sym, t, level));
+        index = emit(Instr::ADD, Instr::INT, newVreg(Instr::INT), scaled, expression(i));
+        t = types.element(t);
+    }
+
+    if (!types.isArray(t)) {
+        return Place{Place::ELEMENT, base, index, t, n->sym};
+    }
+
+    // Scale by the size of the sub-array
+    int subLevel = level;
+    for (uint32_t sub = t; types.isArray(sub); sub = types.element(sub), subLevel++) {
+        index = emit(Instr::MUL, Instr::INT, newVreg(Instr::INT), index, dimension(n->sym, sub, subLevel));
+    }
+    int32_t pointer = emit(Instr::OFFSET, Instr::PTR, newVreg(Instr::PTR), base, index);
+    return Place{Place::ARRAY, pointer, level, t, n->sym};
+}
+
+// Length of dimension level of array symbol sym, whose type at that level is
+// arrayType. Declared arrays know their lengths; array parameters were passed
+// theirs in the vregs after the pointer.
+int32_t IRGen::dimension(int32_t sym, uint32_t arrayType, int level) {
+    int32_t length = types.length(arrayType);
+    if (length != TypeTable::UNSIZED) {
+        return constant(Instr::INT, length);
+    }
+    return storage[sym].index + 1 + level;
+}
+
+// Whether evaluating n has no effects and cannot fail
+bool IRGen::cheap(const Node* n) const {
+    switch (n->kind) {
+        case Node::LITERAL:
+            return true;
+        case Node::DESIGNATOR:
+            return !n->child;
+        case Node::NOT:
+            return cheap(n->child);
+        case Node::BINARY:
+            return cheap(n->child) && cheap(n->child->next);
+        default:
+            return false;
+    }
+}
+
+// RUN THE GENERATOR ==========================================================
+
+Module IRGen::generate() {
+    module = Module{{}, 0, -1};
+    storage.assign(symbols.size(), Storage{Storage::NONE, -1});
+    if (!unit.root()) {
+        return std::move(module);
+    }
+
+    // Number the functions first, so that calls know their callees' return types
+    size_t count = 0;
+    for (Node* decl = unit.root()->child; decl; decl = decl->next) {
+        count += decl->kind == Node::FUNC_DECL;
+    }
+    module.functions.resize(count);
+
+    int32_t index = 0;
+    for (Node* decl = unit.root()->child; decl; decl = decl->next) {
+        if (decl->kind == Node::FUNC_DECL) {
+            Function& f = module.functions[index];
+            f.name = unit.text(decl);
+            f.returnType = valueType(TypeTable::fromToken(decl->opKind()));
+            storage[decl->sym] = Storage{Storage::FUNCTION, index++};
+        }
+    }
+    module.main = index - 1;
+
+    index = 0;
+    for (Node* decl = unit.root()->child; decl; decl = decl->next) {
+        if (decl->kind == Node::VAR_DECL) {
+            global(decl);
+        } else {
+            function(decl, index++);
+        }
+    }
+    return std::move(module);
+}
@@ -0,0 +1,99 @@
+#ifndef _IR_GEN_H_
+#define _IR_GEN_H_
+
+#include <vector>
+#include "AST.h"
+#include "IR.h"
+
+// Lowers a type-checked CompilationUnit to a Module of three-address code.
+// Scalar locals and parameters live in vregs, which may be assigned more than
+// once at this stage; globals and array elements live in memory. An array
+// parameter is passed as a pointer followed by the length of each of its
+// dimensions, so "int[][] m" takes three vregs.
+//
+// && and || only evaluate their right operand when they have to. Conditions
+// are lowered straight to branches. Variables start out as zero each time
+// their declaration is reached, and a function that ends without a return
+// returns zero.
+class IRGen {
+private:
+
+    // Where a symbol's value lives
+    struct Storage {
+        enum Kind : uint8_t { NONE, VREG, GLOBAL, FUNCTION };
+
+        Kind kind;
+        int32_t index;      // Vreg (for arrays, their pointer), global slot or function
+    };
+
+    // What a designator refers to
+    struct Place {
+        enum Kind : uint8_t { VREG, GLOBAL, ELEMENT, ARRAY };
+
+        Kind kind;
+        int32_t a;          // Vreg, global slot, or array pointer
+        int32_t b;          // ELEMENT index, or how many dimensions an ARRAY's indexes used
+        uint32_t type;      // Of the value, in the unit's TypeTable
+        int32_t sym;        // Array symbol, for the lengths of its dimensions
+    };
+
+    CompilationUnit& unit;
+    const TypeTable& types;
+    const SymbolTable& symbols;
+    Module module;
+    std::vector<Storage> storage;       // Indexed by symbol
+
+    // The function being generated. Its code is built here and copied out
+    // once it is complete, so each Function allocates only what it keeps.
+    Function* fn;
+    std::vector<Instr> code;
+    std::vector<BasicBlock> blocks;
+    std::vector<int32_t> operands;
+    std::vector<Instr::Type> vregs;
+    std::vector<int32_t> placed;        // Blocks in the order they were started
+    std::vector<int32_t> merged;        // Block each empty block was merged into, or -1
+    std::vector<int32_t> remap;         // Block numbers in placed order
+    std::vector<int32_t> args;          // Arguments of the calls being generated
+    int32_t current;                    // Block being filled, or -1 after a terminator
+
+    Instr::Type valueType(uint32_t t) const;
+
+    // Emitting code
+    int32_t newVreg(Instr::Type t);
+    int32_t emit(Instr::Op op, Instr::Type type, int32_t dst, int32_t a = -1, int32_t b = -1);
+    int32_t constant(Instr::Type type, int64_t bits, int32_t dst = -1);
+    int32_t newBlock();
+    void startBlock(int32_t block, bool mergeable = true);
+    void jump(int32_t block);
+    void finishFunction();
+
+    // Declarations
+    void global(Node* n);
+    void function(Node* n, int32_t index);
+    void varDecl(Node* n);
+
+    // Statements
+    void block(Node* n);
+    void statement(Node* n);
+    void assign(Node* n);
+    void branch(Node* cond, int32_t ifTrue, int32_t ifFalse);
+
+    // Expressions
+    int32_t expression(Node* n, int32_t dst = -1);
+    int32_t literal(Node* n, int32_t dst);
+    int32_t call(Node* n, int32_t dst);
+    int32_t load(const Place& p, int32_t dst = -1);
+    void store(const Place& p, int32_t value);
+    Place place(Node* n);
+    int32_t dimension(int32_t sym, uint32_t arrayType, int level);
+    bool cheap(const Node* n) const;
+
+public:
+
+    IRGen(CompilationUnit& u);
+
+    // Lower the whole unit
+    Module generate();
+};
+
+#endif
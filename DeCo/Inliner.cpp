@@ -0,0 +1,287 @@
+#include <algorithm>
+#include "Inliner.h"
+
+// Callees of every function, in CSR form, with calls to the same function
+// listed once per call
+void Inliner::buildCallGraph(const Module& module) {
+    size_t n = module.functions.size();
+    calleeStart.assign(n + 1, 0);
+    callees.clear();
+    for (size_t f = 0; f < n; f++) {
+        for (const Instr& in : module.functions[f].code) {
+            if (in.op == Instr::CALL) {
+                callees.push_back(in.a);
+            }
+        }
+        calleeStart[f + 1] = callees.size();
+    }
+}
+
+// Tarjan's algorithm, without recursion. Components are completed callees
+// first, which is the order functions are inlined in.
+void Inliner::sortComponents(size_t n) {
+    component.assign(n, -1);
+    index.assign(n, -1);
+    low.assign(n, 0);
+    onStack.assign(n, 0);
+    order.clear();
+    stack.clear();
+    int32_t counter = 0;
+    int32_t components = 0;
+
+    for (size_t root = 0; root < n; root++) {
+        if (index[root] >= 0) {
+            continue;
+        }
+        path.assign({int32_t(root), int32_t(calleeStart[root])});
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = 1;
+
+        while (!path.empty()) {
+            int32_t f = path[path.size() - 2];
+            int32_t& e = path.back();
+            if (e < int32_t(calleeStart[f + 1])) {
+                int32_t g = callees[e++];
+                if (index[g] < 0) {
+                    index[g] = low[g] = counter++;
+                    stack.push_back(g);
+                    onStack[g] = 1;
+                    path.insert(path.end(), {g, int32_t(calleeStart[g])});
+                } else if (onStack[g]) {
+                    low[f] = std::min(low[f], index[g]);
+                }
+                continue;
+            }
+
+            path.resize(path.size() - 2);
+            if (!path.empty()) {
+                int32_t caller = path[path.size() - 2];
+                low[caller] = std::min(low[caller], low[f]);
+            }
+            if (low[f] == index[f]) {
+                int32_t g;
+                do {
+                    g = stack.back();
+                    stack.pop_back();
+                    onStack[g] = 0;
+                    component[g] = components;
+                    order.push_back(g);
+                } while (g != f);
+                components++;
+            }
+        }
+    }
+}
+
+// The vregs, other than parameters, that some path from the entry reads
+// before writing. A read no earlier write in its block covers is followed
+// back through the predecessors until every path meets a write or one
+// reaches the entry.
+void Inliner::findUnwritten(Function& f, std::vector<int32_t>& out) {
+    size_t n = f.blocks.size();
+    cfg.build(f);
+
+    // Reads that come before any write in their block, as (vreg, block)
+    if (written.size() < n) {
+        written.resize(n);
+    }
+    reads.clear();
+    for (size_t b = 0; b < n; b++) {
+        written[b].assign(f.vregCount());
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            Instr& in = f.code[i];
+            f.forEachUse(in, [&](int32_t& v) {
+                if (v >= int32_t(f.params) && !written[b].test(v)) {
+                    reads.insert(reads.end(), {v, int32_t(b)});
+                }
+            });
+            if (in.definesDst()) {
+                written[b].set(in.dst);
+            }
+        }
+    }
+
+    // seen[b] is the last vreg whose search visited b
+    out.clear();
+    seen.assign(n, -1);
+    found.assign(f.vregCount());
+    for (size_t r = 0; r < reads.size(); r += 2) {
+        int32_t v = reads[r];
+        if (found.test(v) || seen[reads[r + 1]] == v) {
+            continue;
+        }
+        seen[reads[r + 1]] = v;
+        work.assign(1, reads[r + 1]);
+        bool reachesEntry = false;
+        while (!work.empty() && !reachesEntry) {
+            int32_t b = work.back();
+            work.pop_back();
+            reachesEntry = b == 0;
+            for (int32_t pred : cfg.predecessors(b)) {
+                if (seen[pred] != v && !written[pred].test(v)) {
+                    seen[pred] = v;
+                    work.push_back(pred);
+                }
+            }
+        }
+        if (reachesEntry) {
+            found.set(v);
+            out.push_back(v);
+        }
+    }
+}
+
+// Replace the CALL at code[at], in block b, by a copy of the callee. Block b
+// ends with a jump into the copy where the call was; the copy's blocks and a
+// continuation block holding the rest of b are added after the last block,
+// so blocks stay in buffer order. Returns the continuation.
+int32_t Inliner::inlineCall(Function& f, int32_t b, uint32_t at, const Function& callee,
+                            const std::vector<int32_t>& zeroed) {
+    const Instr call = f.code[at];
+    uint32_t end = f.blocks[b].end;
+
+    int32_t vregBase = f.vregs.size();
+    f.vregs.insert(f.vregs.end(), callee.vregs.begin(), callee.vregs.end());
+    int32_t frameBase = f.frameSlots;
+    f.frameSlots += callee.frameSlots;
+
+    // Arguments are copied into the parameters, and unwritten vregs zeroed,
+    // at the start of the callee's entry block, unless a loop leads back there
+    bool entryTargeted = false;
+    for (const BasicBlock& block : callee.blocks) {
+        const Instr& last = callee.code[block.end - 1];
+        entryTargeted = entryTargeted || (last.op == Instr::JMP && last.a == 0)
+            || (last.op == Instr::BR && (last.b == 0 || last.dst == 0));
+    }
+    int32_t entry = f.blocks.size();
+    int32_t blockBase = entry + entryTargeted;
+    int32_t continuation = blockBase + callee.blocks.size();
+
+    f.code[at] = Instr{Instr::JMP, Instr::VOID, 0, -1, entry, 0};
+    f.blocks[b].end = at + 1;
+
+    uint32_t start = f.code.size();
+    for (uint32_t p = 0; p < callee.params; p++) {
+        int32_t arg = f.operands[call.b + p];
+        f.code.push_back(Instr{Instr::MOV, callee.vregs[p], 0, vregBase + int32_t(p), arg, 0});
+    }
+    for (int32_t v : zeroed) {
+        f.code.push_back(Instr{Instr::CONST, callee.vregs[v], 0, vregBase + v, 0, 0});
+    }
+    if (entryTargeted) {
+        f.code.push_back(Instr{Instr::JMP, Instr::VOID, 0, -1, blockBase, 0});
+        f.blocks.push_back(BasicBlock{start, uint32_t(f.code.size())});
+        start = f.code.size();
+    }
+
+    for (const BasicBlock& block : callee.blocks) {
+        for (uint32_t i = block.start; i < block.end; i++) {
+            Instr in = callee.code[i];
+            switch (in.op) {
+                case Instr::CALL: {
+                    int32_t args = f.operands.size();
+                    for (uint16_t k = 0; k < in.count; k++) {
+                        f.operands.push_back(vregBase + callee.operands[in.b + k]);
+                    }
+                    in.b = args;
+                    break;
+                }
+                case Instr::JMP:
+                    in.a += blockBase;
+                    break;
+                case Instr::BR:
+                    in.a += vregBase;
+                    in.b += blockBase;
+                    in.dst += blockBase;
+                    break;
+                case Instr::RET:
+                    if (call.dst >= 0 && in.a >= 0) {
+                        f.code.push_back(Instr{Instr::MOV, in.type, 0, call.dst, vregBase + in.a, 0});
+                    }
+                    in = Instr{Instr::JMP, Instr::VOID, 0, -1, continuation, 0};
+                    break;
+                case Instr::ALLOCA:
+                    in.a += frameBase;
+                    break;
+                default:
+                    f.forEachUse(in, [&](int32_t& v) { v += vregBase; });
+                    break;
+            }
+            if (in.definesDst()) {
+                in.dst += vregBase;
+            }
+            f.code.push_back(in);
+        }
+        f.blocks.push_back(BasicBlock{start, uint32_t(f.code.size())});
+        start = f.code.size();
+    }
+
+    // The instructions after the call are left where they were, outside any
+    // block, for compact() to drop
+    for (uint32_t i = at + 1; i < end; i++) {
+        Instr in = f.code[i];
+        f.code.push_back(in);
+    }
+    f.blocks.push_back(BasicBlock{start, uint32_t(f.code.size())});
+    return continuation;
+}
+
+void Inliner::inlineCalls(Module& module, int32_t caller) {
+    Function& f = module.functions[caller];
+
+    // Only the caller's own code is searched, including what follows each
+    // inlined call, never the copies
+    pending.clear();
+    for (size_t b = f.blocks.size(); b > 0; b--) {
+        pending.push_back(b - 1);
+    }
+    while (!pending.empty()) {
+        int32_t b = pending.back();
+        pending.pop_back();
+
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            const Instr& in = f.code[i];
+            if (in.op != Instr::CALL) {
+                continue;
+            }
+            int32_t g = in.a;
+            Function& callee = module.functions[g];
+            if (component[g] == component[caller]) {
+                recursive++;
+                continue;
+            }
+            size_t saved = in.count + 2;
+            size_t cost = callee.code.size() > saved ? callee.code.size() - saved : 0;
+            if (cost > budget || f.code.size() + callee.code.size() > callerLimit) {
+                overBudget++;
+                continue;
+            }
+
+            // Callees are complete by now, so this is found once each
+            if (!unwrittenKnown[g]) {
+                findUnwritten(callee, unwritten[g]);
+                unwrittenKnown[g] = 1;
+            }
+            int32_t continuation = inlineCall(f, b, i, callee, unwritten[g]);
+            pending.push_back(continuation);
+            inlined++;
+            break;
+        }
+    }
+    f.compact();
+}
+
+void Inliner::run(Module& module) {
+    buildCallGraph(module);
+    sortComponents(module.functions.size());
+    unwritten.resize(module.functions.size());
+    unwrittenKnown.assign(module.functions.size(), 0);
+    for (int32_t f : order) {
+        inlineCalls(module, f);
+    }
+}
+
+void Inliner::printCounters(std::ostream& out) const {
+    out << inlined << " calls inlined, " << recursive << " recursive, " << overBudget << " over budget";
+}
@@ -0,0 +1,78 @@
+#ifndef _INLINER_H_
+#define _INLINER_H_
+
+#include <vector>
+#include "BitSet.h"
+#include "CFG.h"
+#include "IR.h"
+#include "Pass.h"
+
+// Replaces calls to small functions with a copy of their body. Runs before
+// SSA construction, where a return can simply assign the call's vreg and
+// jump to the code after the call; SSABuilder merges the values afterwards.
+// Variables start out as zero on every call (see IRGen.h), so the copy sets
+// the callee's vregs that may be read before they are written to zero first.
+//
+// Functions are visited bottom-up over the call graph, callees before their
+// callers, so a callee has already had its own calls inlined when it is
+// copied. Calls within a strongly connected component of the graph, such as
+// a function calling itself, are never inlined, which keeps recursion from
+// unrolling without end. Nor are calls found in code that was itself just
+// inlined.
+//
+// A call is inlined when the callee's size, less the call, return and
+// argument passing it saves, is within the budget, and the caller would not
+// grow past callerLimit instructions.
+class Inliner : public Pass {
+private:
+
+    size_t budget;
+    size_t callerLimit;
+
+    // Call graph, and scratch space for ordering it
+    std::vector<uint32_t> calleeStart;
+    std::vector<int32_t> callees;
+    std::vector<int32_t> component;     // Strongly connected component of each function
+    std::vector<int32_t> order;         // Callees before callers
+    std::vector<int32_t> index;
+    std::vector<int32_t> low;
+    std::vector<int32_t> stack;
+    std::vector<uint8_t> onStack;
+    std::vector<int32_t> path;          // (function, next callee) pairs of the search
+    std::vector<int32_t> pending;       // Blocks of the caller left to search
+
+    // Vregs each function may read before writing, once needed
+    std::vector<std::vector<int32_t>> unwritten;
+    std::vector<uint8_t> unwrittenKnown;
+    CFG cfg;
+    std::vector<BitSet> written;
+    std::vector<int32_t> reads;
+    std::vector<int32_t> seen;
+    std::vector<int32_t> work;
+    BitSet found;
+
+    // Totals since resetCounters()
+    size_t inlined;
+    size_t recursive;
+    size_t overBudget;
+
+    void buildCallGraph(const Module& module);
+    void sortComponents(size_t n);
+    void findUnwritten(Function& f, std::vector<int32_t>& out);
+    void inlineCalls(Module& module, int32_t caller);
+    int32_t inlineCall(Function& f, int32_t b, uint32_t at, const Function& callee,
+                       const std::vector<int32_t>& zeroed);
+
+public:
+
+    explicit Inliner(size_t budget = 40, size_t callerLimit = 20000)
+        : budget(budget), callerLimit(callerLimit) { resetCounters(); }
+
+    const char* name() const override { return "inline"; }
+    void run(Module& module) override;
+
+    void resetCounters() override { inlined = recursive = overBudget = 0; }
+    void printCounters(std::ostream& out) const override;
+};
+
+#endif
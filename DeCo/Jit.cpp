@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include "Jit.h"
+#if DECO_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// The entry stub X86Gen makes for each function
+typedef void (*Entry)(const int64_t* args, int64_t* result);
+
+Jit::Jit(Module& m, size_t bytes)
+    : module(m), codegen(m), memory(nullptr), capacity(0), used(0), pageSize(4096), visited(0) {
+    linkage.functions.assign(m.functions.size(), 0);
+    linkage.entries.assign(m.functions.size(), 0);
+    linkage.ipow = 0;
+    linkage.globalsCell = 0;
+#if DECO_JIT
+    pageSize = size_t(sysconf(_SC_PAGESIZE));
+    size_t pages = (bytes + pageSize - 1) / pageSize;
+    void* p = mmap(nullptr, (pages + 1) * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        _error = "Could not map " + std::to_string(bytes) + " bytes for code";
+        return;
+    }
+    memory = static_cast<uint8_t*>(p);
+    capacity = pages * pageSize;
+    linkage.globalsCell = reinterpret_cast<uint64_t>(memory);
+    if (!protect(0, capacity, false)) {
+        munmap(memory, capacity + pageSize);
+        memory = nullptr;
+    }
+#else
+    (void)bytes;
+    _error = "No JIT on this platform";
+#endif
+}
+
+Jit::~Jit() {
+#if DECO_JIT
+    if (memory) {
+        munmap(memory, capacity + pageSize);
+    }
+#endif
+}
+
+// Make the code pages holding bytes [from, to) writable, or executable
+bool Jit::protect(size_t from, size_t to, bool writable) {
+#if DECO_JIT
+    size_t start = from / pageSize * pageSize;
+    size_t end = (to + pageSize - 1) / pageSize * pageSize;
+    if (start < end && mprotect(code() + start, end - start, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) {
+        _error = "Could not change protection of code pages";
+        return false;
+    }
+    return true;
+#else
+    (void)from;
+    (void)to;
+    (void)writable;
+    return false;
+#endif
+}
+
+// Compile the functions together after the code so far. Each is charged the
+// share of the time its size is of them all
+bool Jit::place(const std::vector<int32_t>& functions) {
+    Clock::time_point start = Clock::now();
+    uint64_t ipow = linkage.ipow;
+    X86Assembler assembler(reinterpret_cast<uint64_t>(code() + used));
+    bool linked = codegen.compile(functions, assembler, linkage);
+    const std::vector<uint8_t>& bytes = assembler.bytes();
+    if (!linked || bytes.size() > capacity - used) {
+        for (int32_t f : functions) {
+            linkage.functions[f] = 0;
+            linkage.entries[f] = 0;
+        }
+        linkage.ipow = ipow;
+        _error = linked ? "No room for the code of " + module.functions[functions[0]].name
+                        : "Jump out of reach in " + module.functions[functions[0]].name;
+        return false;
+    }
+
+    if (!protect(used, used + bytes.size(), true)) {
+        return false;
+    }
+    std::memcpy(code() + used, bytes.data(), bytes.size());
+    if (!protect(used, used + bytes.size(), false)) {
+        return false;
+    }
+    __builtin___clear_cache(reinterpret_cast<char*>(code() + used), reinterpret_cast<char*>(code() + used + bytes.size()));
+    used += bytes.size();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // The functions come one after another, then their entry stubs
+    uint64_t end = linkage.entries[functions[0]];
+    uint64_t total = end - linkage.functions[functions[0]];
+    for (size_t k = 0; k < functions.size(); k++) {
+        uint64_t next = k + 1 < functions.size() ? linkage.functions[functions[k + 1]] : end;
+        size_t size = next - linkage.functions[functions[k]];
+        _stats.push_back(Stats{module.functions[functions[k]].name, size, seconds * size / total});
+    }
+    return true;
+}
+
+// Visit f and the functions it calls, placing each component once all it
+// calls are placed. A function already visited but not placed is on the stack
+bool Jit::visit(int32_t f) {
+    order[f] = lowLink[f] = visited++;
+    stack.push_back(f);
+    for (const Instr& in : module.functions[f].code) {
+        if (in.op != Instr::CALL || compiled(in.a)) {
+            continue;
+        }
+        if (order[in.a] < 0) {
+            if (!visit(in.a)) {
+                return false;
+            }
+            lowLink[f] = std::min(lowLink[f], lowLink[in.a]);
+        } else {
+            lowLink[f] = std::min(lowLink[f], order[in.a]);
+        }
+    }
+    if (lowLink[f] != order[f]) {
+        return true;
+    }
+    std::vector<int32_t> component;
+    do {
+        component.push_back(stack.back());
+        stack.pop_back();
+    } while (component.back() != f);
+    std::reverse(component.begin(), component.end());
+    return place(component);
+}
+
+bool Jit::compile(int32_t function) {
+    if (compiled(function)) {
+        return true;
+    }
+    if (!memory) {
+        return false;
+    }
+    order.assign(module.functions.size(), -1);
+    lowLink.assign(module.functions.size(), 0);
+    stack.clear();
+    visited = 0;
+    return visit(function);
+}
+
+bool Jit::run() {
+    if (!compile(module.main)) {
+        return false;
+    }
+    globals.assign(std::max<uint32_t>(module.globalSlots, 1), VM::Value{0});
+    VM::Value* cell = globals.data();
+    std::memcpy(memory, &cell, sizeof(cell));
+    int64_t result;
+    reinterpret_cast<Entry>(linkage.entries[module.main])(nullptr, &result);
+    return true;
+}
+
+VM::Value Jit::call(int32_t function, const VM::Value* args, VM::Value* vmMemory) {
+    const Function& fn = module.functions[function];
+    arguments.resize(fn.params);
+    for (uint32_t p = 0; p < fn.params; p++) {
+        arguments[p] = fn.vregs[p] == Instr::PTR ? reinterpret_cast<int64_t>(vmMemory + args[p].i) : args[p].i;
+    }
+    std::memcpy(memory, &vmMemory, sizeof(vmMemory));
+    VM::Value result{0};
+    reinterpret_cast<Entry>(linkage.entries[function])(arguments.data(), &result.i);
+    return result;
+}
+
+void Jit::printReport(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "JIT REPORT:\n";
+    double seconds = 0;
+    for (const Stats& s : _stats) {
+        out << "  " << std::left << std::setw(24) << s.name << std::right << std::setw(8) << s.bytes << " bytes"
+            << std::fixed << std::setprecision(1) << std::setw(10) << s.seconds * 1e6 << " us\n";
+        seconds += s.seconds;
+    }
+    out << "  " << used << " of " << capacity << " bytes of code, with entry stubs, compiled in "
+        << std::fixed << std::setprecision(1) << seconds * 1e6 << " us\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,103 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "IR.h"
+#include "VM.h"
+#include "X86Gen.h"
+
+// Machine code goes in memory from mmap and is called with the System V
+// convention
+#if defined(__x86_64__) && defined(__unix__)
+#define DECO_JIT 1
+#else
+#define DECO_JIT 0
+#endif
+
+// Compiles functions of a Module in SSA form to x86-64 machine code in
+// memory, through X86Gen, and runs them. Compiling a function also compiles
+// whatever it calls that is not compiled yet, callees first, so each
+// function is timed on its own; only functions calling each other in a
+// cycle are compiled together. Code never moves while the Jit lives.
+//
+// The code is in one mapping, and no page of it is ever writable and
+// executable at once: pages are made writable to add code, then executable
+// again before it runs. Globals are reached through a cell on a page of
+// their own before the code, which run() points at the Jit's globals and
+// call() at the VM's memory.
+//
+// The code is what X86Gen makes: LOAD and STORE are not bounds checked, and
+// recursion that is too deep overflows the native stack rather than failing.
+class Jit {
+public:
+
+    struct Stats {
+        std::string name;
+        size_t bytes;           // Of machine code, not counting the entry stub
+        double seconds;         // From the IR to code ready to run
+    };
+
+private:
+
+    Module& module;
+    X86Gen codegen;
+    X86Gen::Linkage linkage;
+    uint8_t* memory;            // The cell's page, then the code
+    size_t capacity;            // Bytes of code there is room for
+    size_t used;
+    size_t pageSize;
+    std::vector<VM::Value> globals;
+    std::vector<int64_t> arguments;     // For the entry stub in call()
+    std::vector<Stats> _stats;
+    std::string _error;
+
+    // Tarjan's strongly connected components over calls between functions
+    // not compiled yet
+    std::vector<int32_t> order;
+    std::vector<int32_t> lowLink;
+    std::vector<int32_t> stack;
+    int32_t visited;
+
+    uint8_t* code() const { return memory + pageSize; }
+    bool protect(size_t from, size_t to, bool writable);
+    bool place(const std::vector<int32_t>& functions);
+    bool visit(int32_t f);
+
+public:
+
+    // Room for capacity bytes of machine code
+    explicit Jit(Module& m, size_t capacity = 16 << 20);
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // Compile function, and what it calls. Returns false, with error() set,
+    // if there is no room left or no JIT on this platform
+    bool compile(int32_t function);
+
+    bool compiled(int32_t function) const {
+        return size_t(function) < linkage.functions.size() && linkage.functions[function] != 0;
+    }
+
+    // Compile main if need be and run it, with all globals zero
+    bool run();
+
+    VM::Value global(uint32_t slot) const { return globals[slot]; }
+
+    // Call a compiled function for the VM, whose memory holds the globals and
+    // the arrays that pointer arguments index
+    VM::Value call(int32_t function, const VM::Value* args, VM::Value* vmMemory);
+
+    const std::string& error() const { return _error; }
+
+    // In the order the functions were compiled
+    const std::vector<Stats>& stats() const { return _stats; }
+
+    void printReport(std::ostream& out = std::cout) const;
+};
+
+#endif
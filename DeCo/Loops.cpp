@@ -0,0 +1,338 @@
+#include <algorithm>
+#include "Arithmetic.h"
+#include "Loops.h"
+
+// LOOP NEST ==================================================================
+
+void LoopNest::build(const CFG& cfg) {
+    _loops.clear();
+    _innermost.assign(cfg.size(), -1);
+
+    // Outer loops are found first, so the blocks of an inner loop end up
+    // marked with the inner one
+    for (int32_t h : cfg.loopHeaders()) {
+        int32_t l = _loops.size();
+        int32_t parent = _innermost[h];
+        uint32_t depth = parent < 0 ? 1 : _loops[parent].depth + 1;
+        _loops.push_back(Loop{h, cfg.preheader(h), parent, depth, 1});
+        _innermost[h] = l;
+
+        // Walk backwards from the back edges up to the header
+        work.clear();
+        for (int32_t p : cfg.predecessors(h)) {
+            if (cfg.dominates(h, p)) {
+                work.push_back(p);
+            }
+        }
+        while (!work.empty()) {
+            int32_t b = work.back();
+            work.pop_back();
+            if (_innermost[b] == l) {
+                continue;
+            }
+            _innermost[b] = l;
+            _loops[l].blocks++;
+            for (int32_t p : cfg.predecessors(b)) {
+                if (cfg.reachable(p)) {
+                    work.push_back(p);
+                }
+            }
+        }
+    }
+}
+
+// LOOP OPTIMIZATION ==========================================================
+
+static bool movable(Instr::Op op) {
+    return op == Instr::CONST || (op >= Instr::ADD && op <= Instr::GE) || op == Instr::GADDR
+        || op == Instr::OFFSET;
+}
+
+// Block a vreg is computed in, after the moves decided so far
+int32_t LoopOptimization::blockOfVreg(int32_t v) const {
+    return defAt[v] >= 0 ? target[defAt[v]] : 0;
+}
+
+void LoopOptimization::append(std::vector<int32_t>& first, std::vector<int32_t>& last, int32_t b, int32_t i) {
+    if (first[b] < 0) {
+        first[b] = i;
+    } else {
+        next[last[b]] = i;
+    }
+    last[b] = i;
+}
+
+// Add a new instruction at the end of block b, returning its dst
+int32_t LoopOptimization::add(Function& f, int32_t b, Instr in) {
+    int32_t i = f.code.size();
+    f.code.push_back(in);
+    target.push_back(b);
+    next.push_back(-1);
+    defAt[in.dst] = i;
+    if (in.op == Instr::PHI) {
+        append(firstPhi, lastPhi, b, i);
+    } else {
+        append(firstIn, lastIn, b, i);
+    }
+    return in.dst;
+}
+
+// x * y at the end of block b, folded when either side is a known constant
+int32_t LoopOptimization::multiply(Function& f, int32_t b, int32_t x, int32_t y) {
+    auto constant = [&](int32_t v, int64_t& value) {
+        if (defAt[v] < 0 || f.code[defAt[v]].op != Instr::CONST) {
+            return false;
+        }
+        value = f.code[defAt[v]].bits();
+        return true;
+    };
+
+    int64_t cx, cy;
+    bool knownX = constant(x, cx);
+    bool knownY = constant(y, cy);
+    if (knownX && cx == 1) {
+        return y;
+    } else if (knownY && cy == 1) {
+        return x;
+    }
+
+    int32_t dst = f.vregs.size();
+    f.vregs.push_back(Instr::INT);
+    defAt.push_back(-1);
+    replacement.push_back(dst);
+    induction.push_back(Induction{-1, -1, -1, -1});
+    if ((knownX && knownY) || (knownX && cx == 0) || (knownY && cy == 0)) {
+        int64_t value = knownX && knownY ? Arithmetic::mul(cx, cy) : 0;
+        return add(f, b, Instr{Instr::CONST, Instr::INT, 0, dst, int32_t(value), int32_t(value >> 32)});
+    }
+    return add(f, b, Instr{Instr::MUL, Instr::INT, 0, dst, x, y});
+}
+
+// Decide where every movable instruction goes, leaving the code in place: as
+// far out as it stays invariant. Blocks are visited in reverse postorder, so
+// the operands of an instruction have already been placed.
+void LoopOptimization::hoist(Function& f) {
+    const std::vector<LoopNest::Loop>& loops = nest.loops();
+    for (int32_t b : cfg.rpo()) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            Instr& in = f.code[i];
+            if (!movable(in.op)) {
+                continue;
+            }
+
+            int32_t to = b;
+            for (int32_t l = nest.innermost(b); l >= 0 && loops[l].preheader >= 0; l = nest.innermost(to)) {
+                bool invariant = true;
+                f.forEachUse(in, [&](int32_t& v) {
+                    invariant = invariant && !nest.contains(l, blockOfVreg(v));
+                });
+                if (!invariant) {
+                    break;
+                }
+                to = loops[l].preheader;
+            }
+
+            if (to != b) {
+                target[i] = to;
+                append(firstIn, lastIn, to, i);
+                stats[statsStart + nest.innermost(b)].hoisted++;
+            }
+        }
+    }
+}
+
+// Find the int PHIs of loop headers that are incremented by an invariant
+// step along the only back edge
+void LoopOptimization::findInductions(Function& f) {
+    induction.assign(f.vregCount(), Induction{-1, -1, -1, -1});
+
+    const std::vector<LoopNest::Loop>& loops = nest.loops();
+    for (size_t l = 0; l < loops.size(); l++) {
+        int32_t h = loops[l].header;
+        int32_t pre = loops[l].preheader;
+        BlockList preds = cfg.predecessors(h);
+        if (pre < 0 || preds.size() != 2) {
+            continue;
+        }
+        int32_t latch = preds[0] == pre ? preds[1] : preds[0];
+
+        for (uint32_t i = f.blocks[h].start; f.code[i].op == Instr::PHI; i++) {
+            const Instr& phi = f.code[i];
+            if (phi.type != Instr::INT || phi.count != 2) {
+                continue;
+            }
+            int first = f.operands[phi.b] == pre ? 0 : 1;
+            int32_t init = f.operands[phi.b + 2 * first + 1];
+            int32_t stepped = f.operands[phi.b + 2 * (1 - first) + 1];
+            if (defAt[stepped] < 0) {
+                continue;
+            }
+
+            const Instr& in = f.code[defAt[stepped]];
+            int32_t step = in.a == phi.dst ? in.b : in.b == phi.dst ? in.a : -1;
+            if (in.op == Instr::ADD && in.type == Instr::INT && step >= 0
+                    && !nest.contains(l, blockOfVreg(step))) {
+                induction[phi.dst] = Induction{int32_t(l), init, step, latch};
+            }
+        }
+    }
+}
+
+// Replace i * k, with i an induction variable of the innermost loop the
+// multiplication ends up in and k invariant there, by a PHI of its own
+void LoopOptimization::reduce(Function& f) {
+    replacement.resize(f.vregCount());
+    for (size_t v = 0; v < replacement.size(); v++) {
+        replacement[v] = v;
+    }
+
+    const std::vector<LoopNest::Loop>& loops = nest.loops();
+    size_t n = f.code.size();
+    for (size_t i = 0; i < n; i++) {
+        Instr in = f.code[i];
+        int32_t l = nest.innermost(target[i]);
+        if (in.op != Instr::MUL || in.type != Instr::INT || l < 0) {
+            continue;
+        }
+        int32_t x = in.a;
+        int32_t k = in.b;
+        if (induction[x].loop != l) {
+            std::swap(x, k);
+        }
+        if (induction[x].loop != l || nest.contains(l, blockOfVreg(k))) {
+            continue;
+        }
+
+        Induction iv = induction[x];
+        int32_t start = multiply(f, loops[l].preheader, iv.init, k);
+        int32_t stride = multiply(f, loops[l].preheader, iv.step, k);
+
+        int32_t phi = f.vregs.size();
+        int32_t stepped = phi + 1;
+        f.vregs.insert(f.vregs.end(), {Instr::INT, Instr::INT});
+        defAt.insert(defAt.end(), {-1, -1});
+        replacement.insert(replacement.end(), {phi, stepped});
+        induction.insert(induction.end(), 2, Induction{-1, -1, -1, -1});
+
+        int32_t pairs = f.operands.size();
+        f.operands.insert(f.operands.end(), {loops[l].preheader, start, iv.latch, stepped});
+        add(f, loops[l].header, Instr{Instr::PHI, Instr::INT, 2, phi, -1, pairs});
+        add(f, iv.latch, Instr{Instr::ADD, Instr::INT, 0, stepped, phi, stride});
+
+        replacement[in.dst] = phi;
+        f.code[i].op = Instr::NOP;
+        stats[statsStart + l].reduced++;
+    }
+}
+
+// Lay the code out again with every instruction in its new block: PHIs
+// first, then what stayed, then what moved or was added, then the terminator
+void LoopOptimization::rebuild(Function& f) {
+    code.clear();
+    code.reserve(f.code.size());
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        BasicBlock block = f.blocks[b];
+        uint32_t start = code.size();
+        uint32_t i = block.start;
+        for (; f.code[i].op == Instr::PHI; i++) {
+            code.push_back(f.code[i]);
+        }
+        for (int32_t p = firstPhi[b]; p >= 0; p = next[p]) {
+            code.push_back(f.code[p]);
+        }
+        for (; i + 1 < block.end; i++) {
+            if (target[i] == int32_t(b) && f.code[i].op != Instr::NOP) {
+                code.push_back(f.code[i]);
+            }
+        }
+        for (int32_t m = firstIn[b]; m >= 0; m = next[m]) {
+            if (f.code[m].op != Instr::NOP) {
+                code.push_back(f.code[m]);
+            }
+        }
+        code.push_back(f.code[block.end - 1]);
+        f.blocks[b] = BasicBlock{start, uint32_t(code.size())};
+    }
+    f.code.swap(code);
+
+    for (Instr& in : f.code) {
+        f.forEachUse(in, [&](int32_t& v) { v = replacement[v]; });
+    }
+}
+
+void LoopOptimization::run(Function& f) {
+    cfg.build(f);
+    nest.build(cfg);
+    const std::vector<LoopNest::Loop>& loops = nest.loops();
+    if (loops.empty()) {
+        return;
+    }
+
+    statsStart = stats.size();
+    for (const LoopNest::Loop& loop : loops) {
+        stats.push_back(LoopStats{functionIndex, loop.header, loop.depth, loop.blocks, 0, 0});
+        skipped += loop.preheader < 0;
+    }
+
+    size_t n = f.code.size();
+    defAt.assign(f.vregCount(), -1);
+    target.resize(n);
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            target[i] = b;
+            if (f.code[i].definesDst()) {
+                defAt[f.code[i].dst] = i;
+            }
+        }
+    }
+    next.assign(n, -1);
+    firstIn.assign(f.blocks.size(), -1);
+    lastIn.assign(f.blocks.size(), -1);
+    firstPhi.assign(f.blocks.size(), -1);
+    lastPhi.assign(f.blocks.size(), -1);
+
+    hoist(f);
+    findInductions(f);
+    reduce(f);
+    rebuild(f);
+}
+
+void LoopOptimization::run(Module& module) {
+    for (functionIndex = 0; functionIndex < module.functions.size(); functionIndex++) {
+        run(module.functions[functionIndex]);
+    }
+}
+
+void LoopOptimization::resetCounters() {
+    stats.clear();
+    skipped = 0;
+}
+
+void LoopOptimization::printCounters(std::ostream& out) const {
+    size_t hoisted = 0;
+    size_t reduced = 0;
+    for (const LoopStats& s : stats) {
+        hoisted += s.hoisted;
+        reduced += s.reduced;
+    }
+    out << stats.size() << " loops, " << hoisted << " hoisted, " << reduced << " reduced";
+    if (skipped) {
+        out << ", " << skipped << " without a preheader";
+    }
+}
+
+void LoopOptimization::printLoops(const Module& module, std::ostream& out, size_t limit) const {
+    std::vector<size_t> order(stats.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        return stats[x].hoisted + stats[x].reduced > stats[y].hoisted + stats[y].reduced;
+    });
+
+    for (size_t i = 0; i < order.size() && i < limit; i++) {
+        const LoopStats& s = stats[order[i]];
+        out << module.functions[s.function].name << " b" << s.header << ": depth " << s.depth << ", "
+            << s.blocks << " blocks, " << s.hoisted << " hoisted, " << s.reduced << " reduced\n";
+    }
+}
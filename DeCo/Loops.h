@@ -0,0 +1,136 @@
+#ifndef _LOOPS_H_
+#define _LOOPS_H_
+
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+#include "Pass.h"
+
+// The natural loops of a function and how they nest. A loop is a header
+// (CFG::loopHeaders()) plus every block that reaches one of its back edges
+// without passing through the header. Two loops are either disjoint or one
+// is inside the other, so each block has an innermost loop and each loop a
+// parent.
+class LoopNest {
+public:
+
+    struct Loop {
+        int32_t header;
+        int32_t preheader;      // -1 if the header has none
+        int32_t parent;         // Enclosing loop, or -1
+        uint32_t depth;         // 1 for loops not inside another
+        uint32_t blocks;        // Body size, counting the header
+    };
+
+private:
+
+    std::vector<Loop> _loops;
+    std::vector<int32_t> _innermost;
+    std::vector<int32_t> work;
+
+public:
+
+    // Loops are numbered in reverse postorder of their headers, so every
+    // loop comes after the loops around it
+    void build(const CFG& cfg);
+
+    const std::vector<Loop>& loops() const { return _loops; }
+
+    // Innermost loop containing b, or -1
+    int32_t innermost(int32_t b) const { return _innermost[b]; }
+
+    bool contains(int32_t loop, int32_t b) const {
+        int32_t l = _innermost[b];
+        while (l >= 0 && _loops[l].depth > _loops[loop].depth) {
+            l = _loops[l].parent;
+        }
+        return l == loop;
+    }
+};
+
+// Loop-invariant code motion and strength reduction over functions in SSA
+// form.
+//
+// An instruction is invariant in a loop when nothing it reads is computed in
+// the loop. Invariant arithmetic, comparisons and address computations move
+// to the loop's preheader, and on out through the preheaders of the loops
+// around it for as long as they stay invariant. Since no operator traps
+// (see Arithmetic.h), computing them when a loop runs zero times is safe.
+// Loads stay put, since a store or call in the loop may change memory.
+//
+// A basic induction variable is an int PHI in a loop header that starts at
+// some value and has an invariant step added to it around the latch, like
+// the i of for (i = 0; i < n; i++). A multiplication i * k by an invariant k,
+// the row offset of every a[i][j], becomes a PHI of its own that starts at
+// init * k and has step * k added to it at the latch. Ints wrap, so this
+// gives the same values even when they overflow. Floats are left alone.
+//
+// Loops whose header has no preheader are skipped; IRGen always makes one.
+class LoopOptimization : public Pass {
+public:
+
+    struct LoopStats {
+        uint32_t function;      // Position in the module
+        int32_t header;         // Header block
+        uint32_t depth;
+        uint32_t blocks;
+        uint32_t hoisted;       // Instructions moved out of this loop's body
+        uint32_t reduced;       // Multiplications replaced
+    };
+
+private:
+
+    // An induction variable's start and step, or loop -1 if the vreg is not one
+    struct Induction {
+        int32_t loop;
+        int32_t init;
+        int32_t step;
+        int32_t latch;
+    };
+
+    CFG cfg;
+    LoopNest nest;
+    uint32_t functionIndex;
+
+    // Scratch space, reused for every function
+    std::vector<int32_t> defAt;         // Instruction defining each vreg, or -1
+    std::vector<int32_t> target;        // Block each instruction will end up in
+    std::vector<int32_t> firstIn;       // Instructions moved or added to each block
+    std::vector<int32_t> lastIn;
+    std::vector<int32_t> firstPhi;      // PHIs added to each block
+    std::vector<int32_t> lastPhi;
+    std::vector<int32_t> next;          // Next instruction in those lists
+    std::vector<Induction> induction;
+    std::vector<int32_t> replacement;   // Vreg standing in for each vreg
+    std::vector<Instr> code;
+    std::vector<LoopStats> stats;       // For the loops since resetCounters()
+    size_t statsStart;                  // First entry for the current function
+    size_t skipped;
+
+    int32_t blockOfVreg(int32_t v) const;
+    void append(std::vector<int32_t>& first, std::vector<int32_t>& last, int32_t b, int32_t i);
+    int32_t add(Function& f, int32_t b, Instr in);
+    int32_t multiply(Function& f, int32_t b, int32_t x, int32_t y);
+    void hoist(Function& f);
+    void findInductions(Function& f);
+    void reduce(Function& f);
+    void rebuild(Function& f);
+
+public:
+
+    LoopOptimization() { resetCounters(); }
+
+    const char* name() const override { return "loops"; }
+    void run(Module& module) override;
+    void run(Function& f) override;
+
+    void resetCounters() override;
+    void printCounters(std::ostream& out) const override;
+
+    // The loops of the last run, one line each, with the most improved first;
+    // at most limit lines
+    void printLoops(const Module& module, std::ostream& out = std::cout, size_t limit = SIZE_MAX) const;
+    const std::vector<LoopStats>& loopStats() const { return stats; }
+};
+
+#endif
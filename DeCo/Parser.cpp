@@ -1,83 +1,5 @@
 #include "Parser.h"
 
-// FIRST Sets, stored as bit maps
-// Can store info about 8 tokens in 1 byte
-static const int setSize = (Token::Kind::SIZE / 8) + (Token::Kind::SIZE % 8 ? 1 : 0);
-static char firstSet[NonTerminal::SIZE][setSize] = {
-    // MUL_OP
-    {-31, 0, 0, 0, 0, 0, 0},
-    // ADD_OP
-    {26, 0, 0, 0, 0, 0, 0},
-    // REL_OP
-    {0, 126, 0, 0, 0, 0, 0}, 
-    // ASSIGN_OP
-    {0, -128, 63, 0, 0, 0, 0},
-    // UNARY_OP
-    {0, 0, -64, 0, 0, 0, 0},
-    // TYPE
-    {0, 0, 0, 14, 0, 0, 0},
-    // BOOL_LIT
-    {0, 0, 0, 48, 0, 0, 0},
-    // LITERAL
-    {0, 0, 0, 48, 0, 0, 12},
-    // DESIGNATOR
-    {0, 0, 0, 0, 0, 0, 16},
-    // GROUP_EXPR
-    {4, 0, 0, 112, 0, 64, 28}, 
-    // POW_EXPR
-    {4, 0, 0, 112, 0, 64, 28},
-    // MULT_EXPR
-    {4, 0, 0, 112, 0, 64, 28},
-    // ADD_EXPR
-    {4, 0, 0, 112, 0, 64, 28},
-    // REL_EXPR
-    {4, 0, 0, 112, 0, 64, 28},
-    // RELATION
-    {0, 0, 0, 64, 0, 0, 0},
-    // ASSIGN
-    {0, 0, 0, 0, 0, 0, 16},
-    // FUNC_CALL
-    {0, 0, 0, 0, 0, 64, 0},
-    // ASSIGN_STAT
-    {0, 0, 0, 0, 0, 0, 16},
-    // FUNC_CALL_STAT
-    {0, 0, 0, 0, 0, 64, 0},
-    // IF_STAT
-    {0, 0, 0, 0, -128, 0, 0},
-    // WHILE_STAT
-    {0, 0, 0, 0, 0, 2, 0},
-    // DO_WHILE_STAT
-    {0, 0, 0, 0, 0, 4, 0},
-    // FOR_STAT
-    {0, 0, 0, 0, 0, 8, 0},
-    // REPEAT_STAT
-    {0, 0, 0, 0, 0, 16, 0},
-    // RETURN_STAT
-    {0, 0, 0, 0, 0, -128, 0},
-    // STATEMENT
-    {0, 0, 0, 14, -128, -34, 16},
-    // STAT_SEQ
-    {0, 0, 0, 14, -128, -34, 16},
-    // TYPE_DECL
-    {0, 0, 0, 14, 0, 0, 0},
-    // VAR_DECL
-    {0, 0, 0, 14, 0, 0, 0},
-    // PARAM_TYPE
-    {0, 0, 0, 14, 0, 0, 0},
-    // PARAM_DECL
-    {0, 0, 0, 14, 0, 0, 0},
-    // DECL_LIST
-    {0, 0, 0, 14, 0, 0, 2},
-    // PARAM_LIST
-    {0, 0, 0, 64, 0, 0, 0},
-    // FUNC_BODY
-    {0, 0, 0, 0, 1, 0, 0},
-    // FUNC_DECL
-    {0, 0, 0, 0, 0, 0, 2},
-    // PROGRAM
-    {0, 0, 0, 14, 0, 0, 3},
-};
-
 // Used for getting string for NonTerminal and Token enum types
 const char* enumName[] = {
     "MUL_OP", "ADD_OP", "REL_OP", "ASSIGN_OP", "UNARY_OP", "TYPE",
@@ -98,18 +20,23 @@ const char* enumName[] = {
 
 std::string Parser::reportSyntaxError(Token::Kind kind) {
     std::string msg = "SyntaxError(" + std::to_string(lineNum()) + "," + std::to_string(charPos()) + ")[Expected "
-        + enumName[kind + NonTerminal::SIZE] + " but got " + enumName[currToken.kind() + NonTerminal::SIZE] + ".]"; 
-    errBuf.push_back(msg);
+        + enumName[kind + NonTerminal::SIZE] + " but got " + enumName[currentKind() + NonTerminal::SIZE] + ".]"; 
+    addError(msg);
     return msg;
 }
 
 std::string Parser::reportSyntaxError(NonTerminal nt) {
     std::string msg = "SyntaxError(" + std::to_string(lineNum()) + "," + std::to_string(charPos()) + ")[Expected a token from " 
-        + enumName[nt] + " but got " + enumName[currToken.kind() + NonTerminal::SIZE] + ".]";
-    errBuf.push_back(msg);
+        + enumName[nt] + " but got " + enumName[currentKind() + NonTerminal::SIZE] + ".]";
+    addError(msg);
     return msg;
 }
 
+void Parser::addError(const std::string& msg) {
+    errBuf.push_back(msg);
+    gaveUp = errBuf.size() >= maxErrors;
+}
+
 void Parser::printErrorReport() {
     std::cout << "ERROR REPORT:" << std::endl;
     std::cout << "--------------------------------------------------------------------" << std::endl;
@@ -122,23 +49,69 @@ bool Parser::hasError() {
     return !errBuf.empty();
 }
 
-int Parser::lineNum() { return currToken.lineNumber(); }
+size_t Parser::errorCount() {
+    return errBuf.size();
+}
+
+void Parser::advance() {
+    if (pos + 1 < _unit.tokens().size()) {
+        pos++;
+    }
+}
 
-int Parser::charPos() { return currToken.charPosition(); }
+void Parser::recover(size_t start, Grammar::TokenSet sync) {
+    if (gaveUp) {
+        throw;
+    }
+
+    // The error was at the first token of the construct, which would
+    // otherwise be retried forever
+    if (pos == start) {
+        advance();
+    }
+
+    int depth = 0;
+    while (!have(Token::Kind::SCAN_EOF)) {
+        Token::Kind k = currentKind();
+        if (depth == 0 && (sync & Grammar::bit(k))) {
+            return;
+        }
+        advance();
+
+        if (k == Token::Kind::OPEN_BRACE) {
+            depth++;
+        } else if (k == Token::Kind::CLOSE_BRACE && depth > 0) {
+            if (--depth == 0) {
+                return;
+            }
+        } else if (k == Token::Kind::SEMICOLON && depth == 0) {
+            return;
+        }
+    }
+}
+
+Token::Kind Parser::currentKind() { return _unit.tokens().kind(pos); }
+
+// Positions come from the token stream's line table, which is only built
+// the first time an error needs one
+int Parser::lineNum() { return _unit.tokens().lineNumber(pos); }
+
+// A split literal starts after its "-"
+int Parser::charPos() { return _unit.tokens().charPosition(pos) + splitSign; }
 
 // PARSING HELPERS ============================================================
 
 bool Parser::have(Token::Kind kind) {
-    return currToken.kind() == kind;
+    return currentKind() == kind;
 }
 
 bool Parser::have(NonTerminal nt) {
-    return firstSet[nt][currToken.kind() / 8] & (0x1 << (currToken.kind() % 8));
+    return Grammar::first[nt] & Grammar::bit(currentKind());
 }
 
 bool Parser::accept(Token::Kind kind) {
     if (have(kind)) {
-        currToken = scanner.next();
+        advance();
         return true;
     }
     return false;
@@ -146,7 +119,7 @@ bool Parser::accept(Token::Kind kind) {
 
 bool Parser::accept(NonTerminal nt) {
     if (have(nt)) {
-        currToken = scanner.next();
+        advance();
         return true;
     }
     return false;
@@ -165,445 +138,554 @@ bool Parser::expect(NonTerminal nt) {
         return true;
     }
     std::string msg = reportSyntaxError(nt);
-    throw new QuitParseException(msg);
+    throw QuitParseException(msg);
 }
 
-Token Parser::expectRetrieve(Token::Kind kind) {
-    Token tok = currToken;
+Token::Kind Parser::expectRetrieve(Token::Kind kind) {
+    Token::Kind k = currentKind();
     if (accept(kind)) {
-        return tok;
+        return k;
     }
     std::string msg = reportSyntaxError(kind);
-    throw new QuitParseException(msg);
+    throw QuitParseException(msg);
 }
 
-Token Parser::expectRetrieve(NonTerminal nt) {
-    Token tok = currToken;
+Token::Kind Parser::expectRetrieve(NonTerminal nt) {
+    Token::Kind k = currentKind();
     if (accept(nt)) {
-        return tok;
+        return k;
     }
     std::string msg = reportSyntaxError(nt);
-    throw new QuitParseException(msg);
+    throw QuitParseException(msg);
+}
+
+// TREE BUILDING ============================================================
+
+Node* Parser::node(Node::Kind kind, Token::Kind op, uint16_t aux) {
+    return _unit.node(kind, pos, op, aux);
+}
+
+Node* Parser::binary(Node* op, Node* left, Node* right) {
+    op->child = left;
+    left->next = right;
+    return op;
+}
+
+// SYMBOLS ============================================================
+
+void Parser::declare(Node* n, Symbol::Kind kind) {
+    SymbolTable& symbols = _unit.symbols();
+    std::string_view name = _unit.text(n);
+    n->sym = symbols.declare(symbols.intern(name), kind, n);
+
+    if (n->sym < 0) {
+        addError("DeclareSymbolError(" + std::to_string(_unit.lineNumber(n)) + "," 
+            + std::to_string(_unit.charPosition(n)) + ")[" + std::string(name) + " already exists.]");
+    }
+}
+
+void Parser::resolve(Node* n) {
+    SymbolTable& symbols = _unit.symbols();
+    std::string_view name = _unit.text(n);
+    n->sym = symbols.lookup(symbols.intern(name));
+
+    if (n->sym < 0) {
+        addError("ResolveSymbolError(" + std::to_string(_unit.lineNumber(n)) + "," 
+            + std::to_string(_unit.charPosition(n)) + ")[Could not find " + std::string(name) + ".]");
+    }
 }
 
 // GRAMMAR RULES ============================================================
 
 // program = [ declList ] "main" "(" ")" ":" "void" "{" [ statSeq ] "}"
 void Parser::program() {
-    // Check for declList
-    if (have(NonTerminal::DECL_LIST)) {
-        declList();
-    }
+    Node* prog = node(Node::PROGRAM);
+    _unit.setRoot(prog);
+    NodeList decls(prog);
 
-    // Get symbol for main
-    Token m = expectRetrieve(Token::Kind::MAIN);
-
-    // TODO: Create symbol for main
+    // Anything before main is read as a declaration, so that stray tokens are
+    // reported there instead of ending the list
+    if (!have(Token::Kind::MAIN)) {
+        declList(decls);
+    }
 
-    expect(Token::Kind::OPEN_PAREN);
-    expect(Token::Kind::CLOSE_PAREN);
-    expect(Token::Kind::COLON);
-    expect(Token::Kind::VOID);
-    expect(Token::Kind::OPEN_BRACE);
+    // main is kept as a function without parameters
+    Node* m = node(Node::FUNC_DECL, Token::Kind::VOID);
+    decls.add(m);
 
-    // Check for statSeq
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
+    size_t start = pos;
+    try {
+        expect(Token::Kind::MAIN);
+        declare(m, Symbol::FUNCTION);
+        expect(Token::Kind::OPEN_PAREN);
+        expect(Token::Kind::CLOSE_PAREN);
+        expect(Token::Kind::COLON);
+        expect(Token::Kind::VOID);
+    } catch (const QuitParseException&) {
+        recover(start, Grammar::bit(Token::Kind::OPEN_BRACE));
     }
 
-    expect(Token::Kind::CLOSE_BRACE);
+    SymbolTable::Scope scope(_unit.symbols());
+    m->child = funcBody();
 }
 
 // declList = ( varDecl | funcDecl ) { varDecl | funcDecl }
-void Parser::declList() {
+void Parser::declList(NodeList& decls) {
     do {
-        if (have(NonTerminal::VAR_DECL)) {
-            varDecl();
-        } else {
-            funcDecl();
+        size_t start = pos;
+        try {
+            if (have(NonTerminal::VAR_DECL)) {
+                decls.add(varDecl());
+            } else {
+                decls.add(funcDecl());
+            }
+        } catch (const QuitParseException&) {
+            recover(start, Grammar::declSync);
         }
-    } while (have(NonTerminal::VAR_DECL) || have(NonTerminal::FUNC_DECL));
+    } while (!have(Token::Kind::MAIN) && !have(Token::Kind::SCAN_EOF));
 }
 
 // statSeq = statement { statement }
-void Parser::statSeq() {
+void Parser::statSeq(NodeList& stats) {
     do {
-        statement();
+        size_t start = pos;
+        try {
+            stats.add(statement());
+        } catch (const QuitParseException&) {
+            recover(start, Grammar::statementSync);
+        }
     } while (have(NonTerminal::STATEMENT));
 }
 
 // varDecl = typeDecl ident { "," ident } ";"
-void Parser::varDecl() {
-    typeDecl();
-    Token ident = expectRetrieve(Token::Kind::IDENT);
+Node* Parser::varDecl() {
+    Node* t = typeDecl();
+    Node* decl = node(Node::VAR_DECL);
+    NodeList names(decl);
+    names.add(t);
 
-    // TODO: Create symbols for each declaration
+    Node* name = node(Node::NAME);
+    names.add(name);
+    expect(Token::Kind::IDENT);
+    declare(name, Symbol::VARIABLE);
 
     // Get as many idents as possible
     while (accept(Token::Kind::COMMA)) {
-        ident = expectRetrieve(Token::Kind::IDENT);
+        name = node(Node::NAME);
+        names.add(name);
+        expect(Token::Kind::IDENT);
+        declare(name, Symbol::VARIABLE);
     }
 
     expect(Token::Kind::SEMICOLON);
+    return decl;
 }
 
 // funcDecl = "function" ident paramList ":" ( "void" | type ) funcBody
-void Parser::funcDecl() {
+Node* Parser::funcDecl() {
     expect(Token::Kind::FUNC);
-    Token ident = expectRetrieve(Token::Kind::IDENT);
-    paramList();
-    expect(Token::Kind::COLON);
+    Node* func = node(Node::FUNC_DECL, Token::Kind::VOID);
+    NodeList children(func);
 
-    if (!accept(Token::Kind::VOID)) {
-        type();
+    // Declared before its scope opens, so that the function is global and
+    // visible to its own body. Parameters and the body's top-level
+    // declarations share the function's scope.
+    if (have(Token::Kind::IDENT)) {
+        declare(func, Symbol::FUNCTION);
     }
+    SymbolTable::Scope scope(_unit.symbols());
 
-    // TODO: Create symbol for function
+    // Errors in the header still leave the body to be checked
+    size_t start = pos;
+    try {
+        expect(Token::Kind::IDENT);
+        func->aux = paramList(children);
+        expect(Token::Kind::COLON);
+
+        if (!accept(Token::Kind::VOID)) {
+            func->op = type();
+        }
+    } catch (const QuitParseException&) {
+        recover(start, Grammar::bit(Token::Kind::OPEN_BRACE));
+    }
 
-    funcBody();
+    children.add(funcBody());
+    return func;
 }
 
 // paramList = "(" [ paramDecl { "," paramDecl } ] ")"
-void Parser::paramList() {
+uint16_t Parser::paramList(NodeList& params) {
+    uint16_t count = 0;
     expect(Token::Kind::OPEN_PAREN);
 
     if (have(NonTerminal::PARAM_DECL)) {
-        paramDecl();
+        params.add(paramDecl());
+        count++;
 
         while (accept(Token::Kind::COMMA)) {
-            paramDecl();
+            params.add(paramDecl());
+            count++;
         }
     }
 
     expect(Token::Kind::CLOSE_PAREN);
+    return count;
 }
 
 // type = "bool" | "int" | "float"
-void Parser::type() {
-    Token t = expectRetrieve(NonTerminal::TYPE);
+Token::Kind Parser::type() {
+    return expectRetrieve(NonTerminal::TYPE);
 }
 
 // funcBody = "{" [ statSeq ] "}"
-void Parser::funcBody() {
+Node* Parser::funcBody() {
+    Node* b = node(Node::BLOCK);
     expect(Token::Kind::OPEN_BRACE);
 
     if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
+        NodeList stats(b);
+        statSeq(stats);
     }
 
     expect(Token::Kind::CLOSE_BRACE);
+    return b;
+}
+
+// The "{" [ statSeq ] "}" of a statement, which opens a scope of its own
+Node* Parser::block() {
+    SymbolTable::Scope scope(_unit.symbols());
+    return funcBody();
 }
 
 // paramDecl = paramType ident
-void Parser::paramDecl() {
-    paramType();
-    Token ident = expectRetrieve(Token::Kind::IDENT);
+Node* Parser::paramDecl() {
+    Node* t = paramType();
+    Node* param = node(Node::PARAM);
+    expect(Token::Kind::IDENT);
+    declare(param, Symbol::PARAMETER);
 
-    // TODO: Create symbol for parameter
+    param->child = t;
+    return param;
 }
 
 // paramType = type { "[" "]" }
-void Parser::paramType() {
-    type();
+Node* Parser::paramType() {
+    Node* t = node(Node::TYPE);
+    t->op = type();
 
     while (accept(Token::Kind::OPEN_BRACKET)) {
         expect(Token::Kind::CLOSE_BRACKET);
+        t->aux++;
     }
+    return t;
 }
 
 // typeDecl = type { "[" integerLit "]" }
-void Parser::typeDecl() {
-    type();
+Node* Parser::typeDecl() {
+    Node* t = node(Node::TYPE);
+    t->op = type();
+    NodeList dims(t);
 
     while (accept(Token::Kind::OPEN_BRACKET)) {
-        Token intLit = expectRetrieve(Token::Kind::INT_VAL);
+        dims.add(node(Node::LITERAL, Token::Kind::INT_VAL));
+        expect(Token::Kind::INT_VAL);
         expect(Token::Kind::CLOSE_BRACKET);
     }
+    return t;
 }
 
 // statement = varDecl | assignStat | funcCallStat | ifStat | whileStat 
 //             | doWhileStat | forStat | repeatStat | returnStat
-void Parser::statement() {
+Node* Parser::statement() {
     if (have(NonTerminal::VAR_DECL)) {
-        varDecl();
+        return varDecl();
     } else if (have(NonTerminal::ASSIGN_STAT)) {
-        assignStat();
+        return assignStat();
     } else if (have(NonTerminal::FUNC_CALL_STAT)) {
-        funcCallStat();
+        return funcCallStat();
     } else if (have(NonTerminal::IF_STAT)) {
-        ifStat();
+        return ifStat();
     } else if (have(NonTerminal::WHILE_STAT)) {
-        whileStat();
+        return whileStat();
     } else if (have(NonTerminal::DO_WHILE_STAT)) {
-        doWhileStat();
+        return doWhileStat();
     } else if (have(NonTerminal::FOR_STAT)) {
-        forStat();
+        return forStat();
     } else if (have(NonTerminal::REPEAT_STAT)) {
-        repeatStat();
+        return repeatStat();
     } else if (have(NonTerminal::RETURN_STAT)) {
-        returnStat();
-    } else {
-        expect(NonTerminal::STATEMENT);
+        return returnStat();
     }
+
+    expect(NonTerminal::STATEMENT);
+    return nullptr;
 }
 
 // assignStat = assign ";"
-void Parser::assignStat() {
-    assign();
+Node* Parser::assignStat() {
+    Node* a = assign();
     expect(Token::Kind::SEMICOLON);
+    return a;
 }
 
 // funcCallStat = funcCall ";"
-void Parser::funcCallStat() {
-    funcCall();
+Node* Parser::funcCallStat() {
+    Node* call = funcCall();
     expect(Token::Kind::SEMICOLON);
+    return call;
 }
 
 // ifStat = "if" relation "{" [ statSeq ] "}" [ "else" "{" [statSeq] "}" ]
-void Parser::ifStat() {
+Node* Parser::ifStat() {
+    Node* stat = node(Node::IF);
+    NodeList children(stat);
     expect(Token::Kind::IF);
-    relation();
-    expect(Token::Kind::OPEN_BRACE);
-    
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
-    }
-
-    expect(Token::Kind::CLOSE_BRACE);
+    children.add(relation());
+    children.add(block());
 
     // Check if there is an else
     if (accept(Token::Kind::ELSE)) {
-        expect(Token::Kind::OPEN_BRACE);
-
-        if (have(NonTerminal::STAT_SEQ)) {
-            statSeq();
-        }
-
-        expect(Token::Kind::CLOSE_BRACE);
+        children.add(block());
     }
+    return stat;
 }
 
 // whileStat = "while" relation "{" [ statSeq ] "}"
-void Parser::whileStat() {
+Node* Parser::whileStat() {
+    Node* stat = node(Node::WHILE);
+    NodeList children(stat);
     expect(Token::Kind::WHILE);
-    relation();
-    expect(Token::Kind::OPEN_BRACE);
-
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
-    }
-
-    expect(Token::Kind::CLOSE_BRACE);
+    children.add(relation());
+    children.add(block());
+    return stat;
 }
 
 // doWhileStat = "do" "{" [ statSeq ] "}" "while" relation ";"
-void Parser::doWhileStat() {
+Node* Parser::doWhileStat() {
+    Node* stat = node(Node::DO_WHILE);
+    NodeList children(stat);
     expect(Token::Kind::DO);
-    expect(Token::Kind::OPEN_BRACE);
-
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
-    }
-
-    expect(Token::Kind::CLOSE_BRACE);
+    children.add(block());
     expect(Token::Kind::WHILE);
-    relation();
+    children.add(relation());
     expect(Token::Kind::SEMICOLON);
+    return stat;
 }
 
 // forStat = "for" "(" [ assign ] ";" [ relExpr ] ";" [ assign ] ")" "{" [ statSeq ] "}"
-void Parser::forStat() {
+Node* Parser::forStat() {
+    Node* stat = node(Node::FOR);
+    NodeList children(stat);
     expect(Token::Kind::FOR);
     expect(Token::Kind::OPEN_PAREN);
 
     // Check for initialization
-    if (have(NonTerminal::ASSIGN)) {
-        assign();
-    }
-
+    children.add(have(NonTerminal::ASSIGN) ? assign() : node(Node::EMPTY));
     expect(Token::Kind::SEMICOLON);
 
     // Check for end condition
-    if (have(NonTerminal::REL_EXPR)) {
-        relExpr();
-    }
-
+    children.add(have(NonTerminal::REL_EXPR) ? relExpr() : node(Node::EMPTY));
     expect(Token::Kind::SEMICOLON);
 
     // Check for update
-    if (have(NonTerminal::ASSIGN)) {
-        assign();
-    }
-
+    children.add(have(NonTerminal::ASSIGN) ? assign() : node(Node::EMPTY));
     expect(Token::Kind::CLOSE_PAREN);
-    expect(Token::Kind::OPEN_BRACE);
-
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
-    }
 
-    expect(Token::Kind::CLOSE_BRACE);
+    children.add(block());
+    return stat;
 }
 
 // repeatStat = "repeat" "{" [ statSeq ] "}" "until" relation ";"
-void Parser::repeatStat() {
+Node* Parser::repeatStat() {
+    Node* stat = node(Node::REPEAT);
+    NodeList children(stat);
     expect(Token::Kind::REPEAT);
-    expect(Token::Kind::OPEN_BRACE);
-
-    if (have(NonTerminal::STAT_SEQ)) {
-        statSeq();
-    }
-
-    expect(Token::Kind::CLOSE_BRACE);
+    children.add(block());
     expect(Token::Kind::UNTIL);
-    relation();
+    children.add(relation());
     expect(Token::Kind::SEMICOLON);
+    return stat;
 }
 
 // returnStat = "return" [ relExpr ] ";"
-void Parser::returnStat() {
+Node* Parser::returnStat() {
+    Node* stat = node(Node::RETURN);
     expect(Token::Kind::RETURN);
 
     if (have(NonTerminal::REL_EXPR)) {
-        relExpr();
+        stat->child = relExpr();
     }
 
     expect(Token::Kind::SEMICOLON);
+    return stat;
 }
 
 // relExpr = addExpr { relOp addExpr }
-void Parser::relExpr() {
-    addExpr();
+Node* Parser::relExpr() {
+    Node* left = addExpr();
 
     while (have(NonTerminal::REL_OP)) {
-        Token op = expectRetrieve(NonTerminal::REL_OP);
-        addExpr();
+        Node* op = node(Node::BINARY, currentKind());
+        expect(NonTerminal::REL_OP);
+        left = binary(op, left, addExpr());
     }
+    return left;
 }
 
 // addExpr = multExpr { addOp multExpr }
-void Parser::addExpr() {
-    mulExpr();
+Node* Parser::addExpr() {
+    Node* left = mulExpr();
 
     // May need to check for subtraction read as INT_VAL (4-3 as INT_VAL INT_VAL)
-    while (have(NonTerminal::ADD_OP) || have(Token::Kind::INT_VAL) || have(Token::Kind::FLOAT_VAL)) {
+    while (have(NonTerminal::ADD_OP) || ((have(Token::Kind::INT_VAL) || have(Token::Kind::FLOAT_VAL)) 
+            && !splitSign && _unit.tokens().lexeme(pos).front() == '-')) {
+        Node* op;
         if (have(NonTerminal::ADD_OP)) {
-            Token op = expectRetrieve(NonTerminal::ADD_OP);
-            mulExpr();
+            op = node(Node::BINARY, currentKind());
+            expect(NonTerminal::ADD_OP);
         } else {
-            Token val = currToken;
-
-            // Check if it is a negative number
-            if (val.lexeme().front() == '-') {
-                // Interpret as subtraction
-                Token op("-", val.lineNumber(), val.charPosition(), Token::Kind::SUB);
-
-                // Use rest of number as next token
-                Token::Kind k = val.kind() == Token::Kind::INT_VAL ? Token::Kind::INT_VAL : Token::Kind::FLOAT_VAL;
-                currToken = Token(val.lexeme().substr(1), val.lineNumber(), val.charPosition() + 1, k);
-            }
-
-            mulExpr();
+            // Interpret as subtraction, and the rest of the number as the
+            // next token
+            op = node(Node::BINARY, Token::Kind::SUB);
+            splitSign = true;
         }
+        left = binary(op, left, mulExpr());
     }
+    return left;
 }
 
 // multExpr = powExpr { multOp powExpr }
-void Parser::mulExpr() {
-    powExpr();
+Node* Parser::mulExpr() {
+    Node* left = powExpr();
 
     while (have(NonTerminal::MUL_OP)) {
-        Token op = expectRetrieve(NonTerminal::MUL_OP);
-        powExpr();
+        Node* op = node(Node::BINARY, currentKind());
+        expect(NonTerminal::MUL_OP);
+        left = binary(op, left, powExpr());
     }
+    return left;
 }
 
 // powExpr = groupExpr { powOp groupExpr }
-void Parser::powExpr() {
-    groupExpr();
+Node* Parser::powExpr() {
+    Node* left = groupExpr();
 
-    while (accept(Token::Kind::POW)) {
-        groupExpr();
+    while (have(Token::Kind::POW)) {
+        Node* op = node(Node::BINARY, Token::Kind::POW);
+        advance();
+        left = binary(op, left, groupExpr());
     }
+    return left;
 }
 
 // groupExpr = literal | designator | "!" relExpr | relation | funcCall
-void Parser::groupExpr() {
+Node* Parser::groupExpr() {
     if (have(NonTerminal::LITERAL)) {
-        Token literal = expectRetrieve(NonTerminal::LITERAL);
+        Node* literal = node(Node::LITERAL, currentKind(), splitSign ? Node::SPLIT_SIGN : 0);
+        splitSign = false;
+        expect(NonTerminal::LITERAL);
+        return literal;
     } else if (have(NonTerminal::DESIGNATOR)) {
-        designator();
-    } else if (accept(Token::Kind::NOT)) {
-        relExpr();
+        return designator();
+    } else if (have(Token::Kind::NOT)) {
+        Node* op = node(Node::NOT);
+        advance();
+        op->child = relExpr();
+        return op;
     } else if (have(NonTerminal::RELATION)) {
-        relation();
+        return relation();
     } else if (have(NonTerminal::FUNC_CALL)) {
-        funcCall();
-    } else {
-        expect(NonTerminal::GROUP_EXPR);
+        return funcCall();
     }
+
+    expect(NonTerminal::GROUP_EXPR);
+    return nullptr;
 }
 
 // relation = "(" relExpr ")"
-void Parser::relation() {
+Node* Parser::relation() {
     expect(Token::Kind::OPEN_PAREN);
-    relExpr();
+    Node* expr = relExpr();
     expect(Token::Kind::CLOSE_PAREN);
+    return expr;
 }
 
 // assign = designator ( ( assignOp relExpr ) | unaryOp )
-void Parser::assign() {
-    designator();
+Node* Parser::assign() {
+    Node* target = designator();
 
     if (have(NonTerminal::ASSIGN_OP)) {
-        Token op = expectRetrieve(NonTerminal::ASSIGN_OP);
-        relExpr();
+        Node* op = node(Node::ASSIGN, currentKind());
+        expect(NonTerminal::ASSIGN_OP);
+        return binary(op, target, relExpr());
     } else if (have(NonTerminal::UNARY_OP)) {
-        Token op = expectRetrieve(NonTerminal::UNARY_OP);
-    } else {
-        expect(NonTerminal::ASSIGN);
+        Node* op = node(Node::ASSIGN, currentKind());
+        expect(NonTerminal::UNARY_OP);
+        op->child = target;
+        return op;
     }
+
+    expect(NonTerminal::ASSIGN);
+    return nullptr;
 }
 
 // funcCall = "call" ident "(" [ relExpr { "," relExpr } ] ")"
-void Parser::funcCall() {
+Node* Parser::funcCall() {
     expect(Token::Kind::CALL);
-    Token ident = expectRetrieve(Token::Kind::IDENT);
+    Node* call = node(Node::CALL);
+    NodeList args(call);
+    expect(Token::Kind::IDENT);
+    resolve(call);
     expect(Token::Kind::OPEN_PAREN);
 
     // Check for parameters
     if (have(NonTerminal::REL_EXPR)) {
-        relExpr();
+        args.add(relExpr());
+        call->aux++;
 
         while (accept(Token::Kind::COMMA)) {
-            relExpr();
+            args.add(relExpr());
+            call->aux++;
         }
     }
 
     expect(Token::Kind::CLOSE_PAREN);
+    return call;
 }
 
 // designator = ident { "[" relExpr "]" }
-void Parser::designator() {
-    Token ident = expectRetrieve(Token::Kind::IDENT);
+Node* Parser::designator() {
+    Node* d = node(Node::DESIGNATOR);
+    NodeList indices(d);
+    expect(Token::Kind::IDENT);
+    resolve(d);
 
     while (accept(Token::Kind::OPEN_BRACKET)) {
-        relExpr();
+        indices.add(relExpr());
+        d->aux++;
         expect(Token::Kind::CLOSE_BRACKET);
     }
+    return d;
 }
 
 // CONSTRUCTOR ============================================================
 
-Parser::Parser(Scanner s): scanner(s), currToken(scanner.next()) {}
+Parser::Parser(Scanner s, size_t maxErrors): Parser(s.tokenizeAll(), maxErrors) {}
+
+Parser::Parser(TokenStream ts, size_t maxErrors)
+    : _unit(std::move(ts)), pos(0), splitSign(false), maxErrors(maxErrors), gaveUp(false) {}
 
 // RUN THE PARSER ============================================================
 
 void Parser::parse() {
+    // An error that no rule recovers from, such as one in main's body, ends
+    // the parse. It is already in errBuf, like every other.
     try {
         program();
-    } catch (QuitParseException e) {
-        std::cout << e.what() << std::endl;
+    } catch (const QuitParseException&) {
+        if (gaveUp) {
+            errBuf.push_back("Stopped after " + std::to_string(errBuf.size()) + " errors.");
+        }
     }
 }
 
@@ -613,7 +695,7 @@ void Parser::printFirstSets() {
     for (int nt = 0; nt < NonTerminal::SIZE; nt++) {
         std::cout << "FIRST set for " << enumName[nt] << ": { ";
         for (int tok = 0; tok < Token::Kind::SIZE; tok++) {
-            if (firstSet[nt][tok / 8] & (0x1 << (tok % 8))) {
+            if (Grammar::first[NonTerminal(nt)] & Grammar::bit(Token::Kind(tok))) {
                 std::cout << enumName[tok + NonTerminal::SIZE] << " ";
             }
         }
@@ -2,40 +2,10 @@
 #define _PARSER_H_
 
 #include <vector>
+#include "AST.h"
+#include "Grammar.h"
 #include "Scanner.h"
-
-enum NonTerminal {
-    // Operators (POW_OP not needed since it is unique)
-    MUL_OP, ADD_OP, REL_OP, ASSIGN_OP, UNARY_OP,
-
-    // Type
-    TYPE,
-
-    // Literals (integer and float handled by Scanner)
-    BOOL_LIT, LITERAL,
-
-    // Designator (ident handled by Scanner)
-    DESIGNATOR,
-
-    // Expression-related nonterminals
-    GROUP_EXPR, POW_EXPR, MULT_EXPR, ADD_EXPR, REL_EXPR, RELATION, 
-
-    // Statements 
-    ASSIGN, FUNC_CALL, ASSIGN_STAT, FUNC_CALL_STAT, IF_STAT, WHILE_STAT, 
-    DO_WHILE_STAT, FOR_STAT, REPEAT_STAT, RETURN_STAT, STATEMENT, STAT_SEQ,
-
-    // Declarations
-    TYPE_DECL, VAR_DECL, PARAM_TYPE, PARAM_DECL, DECL_LIST,
-
-    // Functions
-    PARAM_LIST, FUNC_BODY, FUNC_DECL,
-
-    // Program
-    PROGRAM,
-
-    // Used for getting size of enum
-    SIZE,
-};
+#include "TokenStream.h"
 
 // Custom parsing exception
 class QuitParseException : public std::exception {
@@ -47,7 +17,7 @@ public:
 
     QuitParseException(std::string m): msg(m) {}
 
-    const char* what() {
+    const char* what() const noexcept override {
         return msg.data();
     }
 };
@@ -55,34 +25,60 @@ public:
 class Parser {
 private:
 
-    Scanner scanner;
-    Token currToken;
+    CompilationUnit _unit;
+    size_t pos;                     // Index of the current token in the unit's tokens
+    bool splitSign;                 // The current token is a literal whose "-" became a SUB
     std::vector<std::string> errBuf;
+    size_t maxErrors;               // Give up once errBuf holds this many errors
+    bool gaveUp;
 
 public:
 
+    static const size_t DEFAULT_MAX_ERRORS = 100;
+
     // Create a parser using the provided Scanner
-    Parser(Scanner s);
+    Parser(Scanner s, size_t maxErrors = DEFAULT_MAX_ERRORS);
+
+    // Create a parser over an already scanned token stream
+    Parser(TokenStream ts, size_t maxErrors = DEFAULT_MAX_ERRORS);
 
     // Parse using the scanner
     void parse();
 
+    // The tokens and the tree built by parse()
+    CompilationUnit& unit() { return _unit; }
+
     // Print out any errors
     void printErrorReport();
 
     // Check if there were any parsing errors
     bool hasError();
 
+    // Number of errors reported
+    size_t errorCount();
+
     // Useful for seeing the first sets of each nonterminal
     static void printFirstSets();
 
 private:
 
+    // Record an error, noting when the error limit is reached
+    void addError(const std::string& msg);
+
     // Get syntax error message
     std::string reportSyntaxError(Token::Kind kind);
     std::string reportSyntaxError(NonTerminal nt);
 
-    // Get current line number or char position
+    // Move to the next token, staying on SCAN_EOF once it is reached
+    void advance();
+
+    // Skip past a syntax error. Stops before a token in sync, or after a ";"
+    // or a balanced "{ ... }"; skips at least one token if none were consumed
+    // since start. Rethrows once the error limit has been reached.
+    void recover(size_t start, Grammar::TokenSet sync);
+
+    // Get the current token's kind, or its line number or char position
+    Token::Kind currentKind();
     int lineNum();
     int charPos();
 
@@ -98,41 +94,52 @@ private:
     bool expect(Token::Kind kind);
     // Attempt to consume token, will throw if not in first set
     bool expect(NonTerminal nt);
-    // Will retrieve if next token, otherwise will throw
-    Token expectRetrieve(Token::Kind kind);
-    // Will retrieve if next token in first set, otherwise will throw
-    Token expectRetrieve(NonTerminal nt);
+    // Will retrieve kind if next token, otherwise will throw
+    Token::Kind expectRetrieve(Token::Kind kind);
+    // Will retrieve kind if next token in first set, otherwise will throw
+    Token::Kind expectRetrieve(NonTerminal nt);
+
+    // Create a node for the current token
+    Node* node(Node::Kind kind, Token::Kind op = Token::Kind(0), uint16_t aux = 0);
+    // Attach the operands of a binary operator node
+    Node* binary(Node* op, Node* left, Node* right);
+
+    // Declare the identifier of n in the current scope, setting n->sym
+    void declare(Node* n, Symbol::Kind kind);
+    // Look up the identifier of n, setting n->sym
+    void resolve(Node* n);
 
 
     void program();
-    void declList();
-    void statSeq();
-    void varDecl();
-    void funcDecl();
-    void paramList();
-    void type();
-    void funcBody();
-    void paramDecl();
-    void paramType();
-    void typeDecl();
-    void statement();
-    void assignStat();
-    void funcCallStat();
-    void ifStat();
-    void whileStat();
-    void doWhileStat();
-    void forStat();
-    void repeatStat();
-    void returnStat();
-    void relExpr();
-    void addExpr();
-    void mulExpr();
-    void powExpr();
-    void groupExpr();
-    void relation();
-    void assign();
-    void funcCall();
-    void designator();
+    void declList(NodeList& decls);
+    void statSeq(NodeList& stats);
+    Node* varDecl();
+    Node* funcDecl();
+    uint16_t paramList(NodeList& params);
+    Token::Kind type();
+    Node* funcBody();
+    Node* block();
+    Node* paramDecl();
+    Node* paramType();
+    Node* typeDecl();
+    Node* statement();
+    Node* assignStat();
+    Node* funcCallStat();
+    Node* ifStat();
+    Node* whileStat();
+    Node* doWhileStat();
+    Node* forStat();
+    Node* repeatStat();
+    Node* returnStat();
+    Node* relExpr();
+    Node* addExpr();
+    Node* mulExpr();
+    Node* powExpr();
+    Node* groupExpr();
+    Node* relation();
+    Node* assign();
+    Node* funcCall();
+    Node* designator();
 };
 
 #endif
\ No newline at end of file
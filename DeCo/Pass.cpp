@@ -0,0 +1,61 @@
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include "Pass.h"
+
+void Pass::run(Module& module) {
+    for (Function& f : module.functions) {
+        run(f);
+    }
+}
+
+void PassManager::run(Module& module) {
+    using Clock = std::chrono::steady_clock;
+
+    for (Pass* pass : passes) {
+        Record record{pass->name(), 0, module.instructionCount(), 0, ""};
+        pass->resetCounters();
+
+        Clock::time_point start = Clock::now();
+        pass->run(module);
+        for (Function& f : module.functions) {
+            f.compact();
+        }
+        record.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        record.after = module.instructionCount();
+        std::ostringstream counters;
+        pass->printCounters(counters);
+        record.counters = counters.str();
+        records.push_back(record);
+    }
+}
+
+void PassManager::printReport(std::ostream& out) const {
+    out << std::left << std::setw(12) << "pass" << std::right << std::setw(12) << "time (ms)"
+        << std::setw(14) << "before" << std::setw(14) << "after" << std::setw(12) << "removed" << "\n";
+
+    std::ios::fmtflags flags = out.flags();
+    for (const Record& r : records) {
+        out << std::left << std::setw(12) << r.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << r.seconds * 1e3 << std::setw(14) << r.before << std::setw(14) << r.after
+            << std::setw(12) << int64_t(r.before) - int64_t(r.after);
+        if (!r.counters.empty()) {
+            out << "   " << r.counters;
+        }
+        out << "\n";
+    }
+
+    if (records.size() > 1) {
+        double seconds = 0;
+        for (const Record& r : records) {
+            seconds += r.seconds;
+        }
+        size_t before = records.front().before;
+        size_t after = records.back().after;
+        out << std::left << std::setw(12) << "total" << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << seconds * 1e3 << std::setw(14) << before << std::setw(14) << after
+            << std::setw(12) << int64_t(before) - int64_t(after) << "\n";
+    }
+    out.flags(flags);
+}
@@ -0,0 +1,58 @@
+#ifndef _PASS_H_
+#define _PASS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "IR.h"
+
+// A transformation of the IR. Most passes work on one function at a time and
+// only override run(Function&); a pass that looks across functions overrides
+// run(Module&) instead. Passes may delete instructions by turning them into
+// NOPs and leave them for Function::compact().
+//
+// A pass keeps running totals of what it did, such as how many branches it
+// folded, which the PassManager clears before each run and prints after it.
+class Pass {
+public:
+
+    virtual ~Pass() {}
+
+    virtual const char* name() const = 0;
+
+    virtual void run(Module& module);
+    virtual void run(Function&) {}
+
+    virtual void resetCounters() {}
+    virtual void printCounters(std::ostream&) const {}
+};
+
+// Runs passes over a module in the order they were added, timing each one and
+// counting the instructions before and after it. Passes are not owned and
+// may be added more than once.
+class PassManager {
+private:
+
+    struct Record {
+        const char* name;
+        double seconds;
+        size_t before;
+        size_t after;
+        std::string counters;
+    };
+
+    std::vector<Pass*> passes;
+    std::vector<Record> records;
+
+public:
+
+    void add(Pass& pass) { passes.push_back(&pass); }
+
+    void run(Module& module);
+
+    // One line per pass run: time, instructions before and after, and the
+    // pass's own counters
+    void printReport(std::ostream& out = std::cout) const;
+};
+
+#endif
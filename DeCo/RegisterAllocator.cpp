@@ -0,0 +1,225 @@
+#include <algorithm>
+#include "RegisterAllocator.h"
+
+static uint32_t allRegisters(uint32_t count) {
+    return count >= 32 ? ~uint32_t(0) : (uint32_t(1) << count) - 1;
+}
+
+// LIVE INTERVALS =============================================================
+
+// v is live on entry to b, and so out of each of its predecessors; keep going
+// back until reaching the block that defines it
+void RegisterAllocator::liveInto(const Function& f, int32_t v, int32_t b) {
+    work.assign(1, b);
+    while (!work.empty()) {
+        int32_t x = work.back();
+        work.pop_back();
+        if (mark[x] == v) {
+            continue;
+        }
+        mark[x] = v;
+        cover(v, f.blocks[x].start);
+        for (int32_t p : cfg.predecessors(x)) {
+            cover(v, f.blocks[p].end - 1);
+            if (defBlock[v] != p && mark[p] != v) {
+                work.push_back(p);
+            }
+        }
+    }
+}
+
+void RegisterAllocator::liveOutOf(const Function& f, int32_t v, int32_t b) {
+    cover(v, f.blocks[b].end - 1);
+    if (defBlock[v] != b) {
+        liveInto(f, v, b);
+    }
+}
+
+void RegisterAllocator::buildIntervals(Function& f) {
+    size_t n = f.vregCount();
+    lo.assign(n, UINT32_MAX);
+    hi.assign(n, 0);
+    defBlock.assign(n, -1);
+    for (uint32_t p = 0; p < f.params; p++) {
+        defBlock[p] = 0;
+        cover(p, 0);
+    }
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            if (f.code[i].definesDst()) {
+                defBlock[f.code[i].dst] = b;
+                cover(f.code[i].dst, i);
+            }
+
+            // The backends write all of a block's PHIs at once, at the end
+            // of each predecessor, so each is live from there through the
+            // start of its block, even if it is never used
+            if (f.code[i].op == Instr::PHI) {
+                cover(f.code[i].dst, f.blocks[b].start);
+                for (int32_t p : cfg.predecessors(b)) {
+                    cover(f.code[i].dst, f.blocks[p].end - 1);
+                }
+            }
+        }
+    }
+
+    // Gather the blocks each vreg is used in, as b for uses inside b and ~b
+    // for PHI operands coming out of b, so the walks for one vreg run
+    // together and share their marks
+    pairs.clear();
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            Instr& in = f.code[i];
+            if (in.op == Instr::PHI) {
+                for (int pair = 0; pair < in.count; pair++) {
+                    pairs.insert(pairs.end(), {f.operands[in.b + 2 * pair + 1], ~f.operands[in.b + 2 * pair]});
+                }
+                continue;
+            }
+            f.forEachUse(in, [&](int32_t& v) {
+                cover(v, i);
+                if (defBlock[v] != int32_t(b)) {
+                    pairs.insert(pairs.end(), {v, int32_t(b)});
+                }
+            });
+        }
+    }
+    group(pairs, n, useStart, useBlock);
+
+    mark.assign(f.blocks.size(), -1);
+    for (size_t v = 0; v < n; v++) {
+        for (uint32_t u = useStart[v]; u < useStart[v + 1]; u++) {
+            int32_t b = useBlock[u];
+            if (b >= 0) {
+                liveInto(f, v, b);
+            } else {
+                liveOutOf(f, v, ~b);
+            }
+        }
+    }
+}
+
+// LINEAR SCAN ================================================================
+
+void RegisterAllocator::scan(const Function& f) {
+    size_t n = f.vregCount();
+    size_t positions = f.code.size() + 1;
+
+    // Counting sort by start of interval
+    startCount.assign(positions + 1, 0);
+    for (size_t v = 0; v < n; v++) {
+        if (hasInterval(v)) {
+            startCount[lo[v] + 1]++;
+        }
+    }
+    for (size_t p = 0; p < positions; p++) {
+        startCount[p + 1] += startCount[p];
+    }
+    order.resize(startCount[positions]);
+    for (size_t v = 0; v < n; v++) {
+        if (hasInterval(v)) {
+            order[startCount[lo[v]]++] = v;
+        }
+    }
+
+    callsBefore.assign(positions, 0);
+    for (size_t i = 0; i + 1 < positions; i++) {
+        callsBefore[i + 1] = callsBefore[i] + (f.code[i].op == Instr::CALL);
+    }
+
+    _reg.assign(n, -1);
+    spilled.clear();
+    uint32_t free[2];
+    for (int c = 0; c < 2; c++) {
+        active[c].clear();
+        free[c] = allRegisters(registers[c].count);
+        used[c] = 0;
+    }
+
+    for (int32_t v : order) {
+        Class c = classOf(f.vregs[v]);
+        const Registers& r = registers[c];
+        std::vector<int32_t>& live = active[c];
+
+        for (size_t k = 0; k < live.size();) {
+            int32_t u = live[k];
+            if (hi[u] < lo[v]) {
+                free[c] |= uint32_t(1) << _reg[u];
+                live[k] = live.back();
+                live.pop_back();
+            } else {
+                k++;
+            }
+        }
+
+        // A CALL strictly inside the interval; arguments are read and the
+        // result written at the call's own position
+        bool acrossCall = callsBefore[hi[v]] > callsBefore[std::min<size_t>(lo[v] + 1, hi[v])];
+        uint32_t allowed = acrossCall ? r.preserved & allRegisters(r.count) : allRegisters(r.count);
+        uint32_t candidates = free[c] & allowed;
+        if (candidates) {
+            uint32_t clobbered = candidates & ~r.preserved;
+            int32_t reg = __builtin_ctz(clobbered ? clobbered : candidates);
+            _reg[v] = reg;
+            free[c] &= ~(uint32_t(1) << reg);
+            used[c] |= uint32_t(1) << reg;
+            live.push_back(v);
+            continue;
+        }
+
+        // Spill whichever ends last, of v and the active vregs holding a
+        // register v could use
+        size_t victim = live.size();
+        for (size_t k = 0; k < live.size(); k++) {
+            if ((allowed >> _reg[live[k]] & 1) && (victim == live.size() || hi[live[k]] > hi[live[victim]])) {
+                victim = k;
+            }
+        }
+        if (victim < live.size() && hi[live[victim]] > hi[v]) {
+            int32_t u = live[victim];
+            _reg[v] = _reg[u];
+            _reg[u] = -1;
+            live[victim] = v;
+            spilled.push_back(u);
+        } else {
+            spilled.push_back(v);
+        }
+    }
+}
+
+// Spilled vregs share stack slots when their intervals do not overlap
+void RegisterAllocator::assignSlots() {
+    std::sort(spilled.begin(), spilled.end(), [&](int32_t x, int32_t y) { return lo[x] < lo[y]; });
+    _slot.assign(lo.size(), -1);
+    _spillSlots = 0;
+    freeSlots.clear();
+    ending.clear();
+    auto later = [](const std::pair<uint32_t, int32_t>& x, const std::pair<uint32_t, int32_t>& y) {
+        return x.first > y.first;
+    };
+
+    for (int32_t v : spilled) {
+        while (!ending.empty() && ending.front().first < lo[v]) {
+            std::pop_heap(ending.begin(), ending.end(), later);
+            freeSlots.push_back(ending.back().second);
+            ending.pop_back();
+        }
+        int32_t slot;
+        if (freeSlots.empty()) {
+            slot = _spillSlots++;
+        } else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        _slot[v] = slot;
+        ending.push_back({hi[v], slot});
+        std::push_heap(ending.begin(), ending.end(), later);
+    }
+}
+
+void RegisterAllocator::allocate(Function& f) {
+    cfg.build(f);
+    buildIntervals(f);
+    scan(f);
+    assignSlots();
+}
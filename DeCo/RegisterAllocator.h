@@ -0,0 +1,98 @@
+#ifndef _REGISTER_ALLOCATOR_H_
+#define _REGISTER_ALLOCATOR_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+
+// Linear-scan register allocation (Poletto and Sarkar, "Linear Scan Register
+// Allocation") for functions in SSA form, as the optimizer leaves them.
+//
+// Instructions are numbered by their position in the code buffer. A vreg's
+// live interval is the smallest range of positions covering its definition,
+// its uses, and every block it is live into or out of; liveness is found by
+// walking back from each use to the definition. A PHI's operands count as
+// used at the end of the predecessor they come from, and its destination as
+// defined there, since that is where the backends copy into it. Intervals are visited
+// in order of their start, and a vreg gets a register free for its whole
+// interval or is spilled to a stack slot for all of it. When none is free,
+// whichever of it and the active intervals ends last is spilled.
+//
+// There are two register classes, one for FLOAT vregs and one for the rest,
+// each numbered from 0 for the backend to map onto machine registers.
+// Registers whose bit is set in preserved keep their value across calls. A
+// vreg live across a CALL only gets one of those, and is spilled when none
+// is free, so nothing needs saving around calls. Other vregs take the
+// registers calls clobber first.
+class RegisterAllocator {
+public:
+
+    enum Class { GENERAL, FLOAT };
+
+    struct Registers {
+        uint32_t count;         // At most 32
+        uint32_t preserved;     // Bit r set if calls leave register r alone
+    };
+
+    static Class classOf(Instr::Type type) { return type == Instr::FLOAT ? FLOAT : GENERAL; }
+
+private:
+
+    Registers registers[2];
+    CFG cfg;
+
+    // Results
+    std::vector<uint32_t> lo;           // Live interval of each vreg, empty if lo > hi
+    std::vector<uint32_t> hi;
+    std::vector<int8_t> _reg;           // Register, or -1
+    std::vector<int32_t> _slot;         // Spill slot, or -1
+    uint32_t _spillSlots;
+    uint32_t used[2];                   // Registers given out in each class
+
+    // Scratch space
+    std::vector<int32_t> defBlock;      // Block defining each vreg; parameters are block 0's
+    std::vector<int32_t> pairs;
+    std::vector<uint32_t> useStart;     // Blocks each vreg is used in
+    std::vector<int32_t> useBlock;
+    std::vector<int32_t> mark;          // Last vreg found live into each block
+    std::vector<int32_t> work;
+    std::vector<uint32_t> callsBefore;  // CALLs at lower positions
+    std::vector<uint32_t> startCount;
+    std::vector<int32_t> order;         // Vregs by start of interval
+    std::vector<int32_t> active[2];     // Vregs holding a register at the current position
+    std::vector<int32_t> spilled;
+    std::vector<int32_t> freeSlots;
+    std::vector<std::pair<uint32_t, int32_t>> ending;   // Heap of (end, slot) in use
+
+    void cover(int32_t v, uint32_t position) {
+        lo[v] = position < lo[v] ? position : lo[v];
+        hi[v] = position > hi[v] ? position : hi[v];
+    }
+    void liveInto(const Function& f, int32_t v, int32_t b);
+    void liveOutOf(const Function& f, int32_t v, int32_t b);
+    void buildIntervals(Function& f);
+    void scan(const Function& f);
+    void assignSlots();
+
+public:
+
+    RegisterAllocator(Registers general, Registers floats) : registers{general, floats} {}
+
+    void allocate(Function& f);
+
+    bool hasInterval(int32_t v) const { return lo[v] <= hi[v]; }
+    uint32_t intervalStart(int32_t v) const { return lo[v]; }
+    uint32_t intervalEnd(int32_t v) const { return hi[v]; }
+
+    // Where a vreg lives: one of these is -1, or both for vregs never used
+    int32_t reg(int32_t v) const { return _reg[v]; }
+    int32_t slot(int32_t v) const { return _slot[v]; }
+
+    uint32_t spillSlots() const { return _spillSlots; }
+    size_t spillCount() const { return spilled.size(); }
+    uint32_t usedRegisters(Class c) const { return used[c]; }
+};
+
+#endif
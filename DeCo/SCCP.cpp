@@ -0,0 +1,246 @@
+#include <algorithm>
+#include "Arithmetic.h"
+#include "SCCP.h"
+
+// Which instructions read each vreg, and the block of every instruction
+void ConstantPropagation::findUses() {
+    pairs.clear();
+    blockOf.resize(f->code.size());
+    for (size_t b = 0; b < f->blocks.size(); b++) {
+        for (uint32_t i = f->blocks[b].start; i < f->blocks[b].end; i++) {
+            blockOf[i] = b;
+            f->forEachUse(f->code[i], [&](int32_t& v) {
+                pairs.insert(pairs.end(), {v, int32_t(i)});
+            });
+        }
+    }
+    group(pairs, f->vregCount(), useStart, uses);
+}
+
+bool ConstantPropagation::edgeLive(int32_t from, int32_t to) const {
+    BlockList succ = cfg.successors(from);
+    for (size_t k = 0; k < succ.size(); k++) {
+        if (succ[k] == to) {
+            return liveEdges[from] >> k & 1;
+        }
+    }
+    return false;
+}
+
+// Mark the edge executable, queueing its target the first time
+void ConstantPropagation::follow(int32_t from, int32_t to) {
+    BlockList succ = cfg.successors(from);
+    for (size_t k = 0; k < succ.size(); k++) {
+        if (succ[k] == to && !(liveEdges[from] >> k & 1)) {
+            liveEdges[from] |= 1 << k;
+            blockWork.push_back(to);
+        }
+    }
+}
+
+// Move vreg down the lattice to (s, value), queueing it if that changed it.
+// Values never move back up, so each vreg is queued at most twice.
+void ConstantPropagation::lower(int32_t vreg, uint8_t s, int64_t value) {
+    uint8_t old = state[vreg];
+    if (s == UNKNOWN || old == VARYING) {
+        return;
+    }
+    if (old == CONSTANT) {
+        if (s == CONSTANT && values[vreg] == value) {
+            return;
+        }
+        s = VARYING;
+    }
+    state[vreg] = s;
+    values[vreg] = value;
+    vregWork.push_back(vreg);
+}
+
+void ConstantPropagation::visit(int32_t i) {
+    const Instr& in = f->code[i];
+    int32_t b = blockOf[i];
+
+    if (in.op >= Instr::ADD && in.op <= Instr::GE) {
+        bool unary = in.op == Instr::NOT;
+        uint8_t sa = state[in.a];
+        uint8_t sb = unary ? uint8_t(CONSTANT) : state[in.b];
+        int64_t va = values[in.a];
+        int64_t vb = unary ? 0 : values[in.b];
+
+        // false && x and true || x do not depend on x
+        if (in.op == Instr::AND || in.op == Instr::OR) {
+            int64_t decides = in.op == Instr::OR;
+            if ((sa == CONSTANT && va == decides) || (sb == CONSTANT && vb == decides)) {
+                lower(in.dst, CONSTANT, decides);
+                return;
+            }
+        }
+
+        int64_t result;
+        if (sa == UNKNOWN || sb == UNKNOWN) {
+            return;
+        } else if (sa == VARYING || sb == VARYING) {
+            lower(in.dst, VARYING, 0);
+        } else if (Arithmetic::evaluate(in.op, in.type, va, vb, result)) {
+            lower(in.dst, CONSTANT, result);
+        }
+        return;
+    }
+
+    switch (in.op) {
+        case Instr::CONST:
+            lower(in.dst, CONSTANT, in.bits());
+            break;
+        case Instr::MOV:
+            lower(in.dst, state[in.a], values[in.a]);
+            break;
+        case Instr::PHI: {
+            // Meet of the values on executable edges; the others do not count
+            uint8_t s = UNKNOWN;
+            int64_t value = 0;
+            for (int pair = 0; pair < in.count && s != VARYING; pair++) {
+                int32_t from = f->operands[in.b + 2 * pair];
+                int32_t v = f->operands[in.b + 2 * pair + 1];
+                if (!edgeLive(from, b) || state[v] == UNKNOWN) {
+                    continue;
+                }
+                if (state[v] == VARYING || (s == CONSTANT && values[v] != value)) {
+                    s = VARYING;
+                } else {
+                    s = CONSTANT;
+                    value = values[v];
+                }
+            }
+            lower(in.dst, s, value);
+            break;
+        }
+        case Instr::JMP:
+            follow(b, in.a);
+            break;
+        case Instr::BR:
+            if (state[in.a] == CONSTANT) {
+                follow(b, values[in.a] ? in.b : in.dst);
+            } else if (state[in.a] == VARYING) {
+                follow(b, in.b);
+                follow(b, in.dst);
+            }
+            break;
+        default:
+            // Loads, addresses and calls
+            if (in.definesDst()) {
+                lower(in.dst, VARYING, 0);
+            }
+            break;
+    }
+}
+
+void ConstantPropagation::propagate() {
+    size_t n = f->blocks.size();
+    state.assign(f->vregCount(), UNKNOWN);
+    values.assign(f->vregCount(), 0);
+    std::fill(state.begin(), state.begin() + f->params, uint8_t(VARYING));
+    live.assign(n);
+    liveEdges.assign(n, 0);
+    vregWork.clear();
+
+    // The entry is executable without an edge into it
+    blockWork.assign(1, 0);
+    while (!blockWork.empty() || !vregWork.empty()) {
+        while (!blockWork.empty()) {
+            int32_t b = blockWork.back();
+            blockWork.pop_back();
+            const BasicBlock& block = f->blocks[b];
+
+            // The whole block the first time, after that only its PHIs have
+            // a new edge to take into account
+            if (live.insert(b)) {
+                for (uint32_t i = block.start; i < block.end; i++) {
+                    visit(i);
+                }
+            } else {
+                for (uint32_t i = block.start; f->code[i].op == Instr::PHI; i++) {
+                    visit(i);
+                }
+            }
+        }
+
+        if (!vregWork.empty()) {
+            int32_t v = vregWork.back();
+            vregWork.pop_back();
+            for (uint32_t u = useStart[v]; u < useStart[v + 1]; u++) {
+                if (live.test(blockOf[uses[u]])) {
+                    visit(uses[u]);
+                }
+            }
+        }
+    }
+}
+
+void ConstantPropagation::rewrite() {
+    auto constant = [&](int32_t v) {
+        int64_t bits = values[v];
+        return Instr{Instr::CONST, f->vregs[v], 0, v, int32_t(bits), int32_t(bits >> 32)};
+    };
+
+    for (size_t b = 0; b < f->blocks.size(); b++) {
+        if (!live.test(b)) {
+            continue;
+        }
+        const BasicBlock& block = f->blocks[b];
+        uint32_t phiEnd = block.start;
+        while (f->code[phiEnd].op == Instr::PHI) {
+            phiEnd++;
+        }
+
+        // A PHI that became a CONST or MOV is swapped behind the remaining
+        // ones, which are visited first, so PHIs stay at the start
+        for (uint32_t p = phiEnd; p-- > block.start;) {
+            Instr& phi = f->code[p];
+            int kept = 0;
+            for (int pair = 0; pair < phi.count; pair++) {
+                int32_t from = f->operands[phi.b + 2 * pair];
+                if (edgeLive(from, b)) {
+                    f->operands[phi.b + 2 * kept] = from;
+                    f->operands[phi.b + 2 * kept + 1] = f->operands[phi.b + 2 * pair + 1];
+                    kept++;
+                }
+            }
+            phi.count = kept;
+
+            if (state[phi.dst] == CONSTANT) {
+                phi = constant(phi.dst);
+                folded++;
+            } else if (kept == 1) {
+                phi = Instr{Instr::MOV, phi.type, 0, phi.dst, f->operands[phi.b + 1], 0};
+            } else {
+                continue;
+            }
+            std::swap(f->code[p], f->code[--phiEnd]);
+        }
+
+        for (uint32_t i = phiEnd; i < block.end; i++) {
+            Instr& in = f->code[i];
+            if (in.op == Instr::BR && state[in.a] == CONSTANT) {
+                in = Instr{Instr::JMP, Instr::VOID, 0, -1, values[in.a] ? in.b : in.dst, 0};
+                branches++;
+            } else if (in.definesDst() && in.op != Instr::CONST && state[in.dst] == CONSTANT) {
+                in = constant(in.dst);
+                folded++;
+            }
+        }
+    }
+
+    blocksRemoved += removeBlocks(*f, live);
+}
+
+void ConstantPropagation::run(Function& function) {
+    f = &function;
+    cfg.build(function);
+    findUses();
+    propagate();
+    rewrite();
+}
+
+void ConstantPropagation::printCounters(std::ostream& out) const {
+    out << folded << " values folded, " << branches << " branches folded, " << blocksRemoved << " blocks removed";
+}
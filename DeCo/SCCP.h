@@ -0,0 +1,68 @@
+#ifndef _SCCP_H_
+#define _SCCP_H_
+
+#include <vector>
+#include "BitSet.h"
+#include "CFG.h"
+#include "IR.h"
+#include "Pass.h"
+
+// Sparse conditional constant propagation (Wegman and Zadeck) over functions
+// in SSA form. Every vreg starts out unknown and can only move down to a
+// constant and then to varying. Blocks are only looked at once an edge into
+// them is found to be executable, so a branch on a constant condition keeps
+// its other side, and the values that flow out of it, from ever counting.
+// Two worklists drive it: newly executable edges, and vregs whose value
+// changed, whose uses are then looked at again.
+//
+// Afterwards every vreg with a constant value is computed by a CONST, a
+// branch on a constant becomes a jump and blocks that never executed are
+// deleted. The constants folded instructions used to read are left for dead
+// code elimination. Folding follows the rules in Arithmetic.h, so it never
+// changes what a program prints.
+class ConstantPropagation : public Pass {
+private:
+
+    enum State : uint8_t { UNKNOWN, CONSTANT, VARYING };
+
+    CFG cfg;
+    Function* f;
+
+    // Scratch space, reused for every function
+    std::vector<uint8_t> state;         // Lattice value of each vreg
+    std::vector<int64_t> values;        // and its bits when CONSTANT
+    std::vector<uint32_t> useStart;     // Instructions reading each vreg
+    std::vector<int32_t> uses;
+    std::vector<int32_t> pairs;
+    std::vector<int32_t> blockOf;       // Block of each instruction
+    BitSet live;                        // Blocks that have executed
+    std::vector<uint8_t> liveEdges;     // Bit k of block b: its edge to successors(b)[k] has executed
+    std::vector<int32_t> blockWork;     // Targets of newly executable edges
+    std::vector<int32_t> vregWork;
+
+    // Totals since resetCounters()
+    size_t folded;
+    size_t branches;
+    size_t blocksRemoved;
+
+    void findUses();
+    bool edgeLive(int32_t from, int32_t to) const;
+    void follow(int32_t from, int32_t to);
+    void lower(int32_t vreg, uint8_t s, int64_t value);
+    void visit(int32_t i);
+    void propagate();
+    void rewrite();
+
+public:
+
+    ConstantPropagation() { resetCounters(); }
+
+    using Pass::run;
+    const char* name() const override { return "sccp"; }
+    void run(Function& f) override;
+
+    void resetCounters() override { folded = branches = blocksRemoved = 0; }
+    void printCounters(std::ostream& out) const override;
+};
+
+#endif
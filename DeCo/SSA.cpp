@@ -0,0 +1,220 @@
+#include <algorithm>
+#include "SSA.h"
+
+// Count the writes of every vreg, note which ones are read in a block they
+// were not written in first, and list the blocks writing those that need PHIs
+void SSABuilder::findDefinitions(Function& f) {
+    size_t vregs = f.vregCount();
+    defCount.assign(vregs, 0);
+    writtenIn.assign(vregs, -1);
+    crossesBlocks.assign(vregs, 0);
+
+    // Parameters are written on entry
+    for (uint32_t p = 0; p < f.params; p++) {
+        defCount[p] = 1;
+        writtenIn[p] = 0;
+    }
+
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            Instr& in = f.code[i];
+            f.forEachUse(in, [&](int32_t& v) {
+                crossesBlocks[v] |= writtenIn[v] != int32_t(b);
+            });
+            if (in.definesDst()) {
+                defCount[in.dst]++;
+                writtenIn[in.dst] = b;
+            }
+        }
+    }
+
+    pairs.clear();
+    for (uint32_t p = 0; p < f.params; p++) {
+        if (defCount[p] > 1 && crossesBlocks[p]) {
+            pairs.insert(pairs.end(), {int32_t(p), 0});
+        }
+    }
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            const Instr& in = f.code[i];
+            if (in.definesDst() && defCount[in.dst] > 1 && crossesBlocks[in.dst]) {
+                pairs.insert(pairs.end(), {in.dst, int32_t(b)});
+            }
+        }
+    }
+    group(pairs, vregs, defStart, defBlocks);
+}
+
+// Give every vreg a PHI in the iterated dominance frontier of its writes, then
+// rebuild the code with the PHIs at the start of their blocks
+size_t SSABuilder::placePhis(Function& f) {
+    size_t n = f.blocks.size();
+    hasPhi.assign(n, -1);
+    queued.assign(n, -1);
+    pairs.clear();
+
+    for (size_t v = 0; v + 1 < defStart.size(); v++) {
+        if (defStart[v] == defStart[v + 1]) {
+            continue;
+        }
+
+        work.clear();
+        for (uint32_t i = defStart[v]; i < defStart[v + 1]; i++) {
+            int32_t b = defBlocks[i];
+            if (queued[b] != int32_t(v)) {
+                queued[b] = v;
+                work.push_back(b);
+            }
+        }
+
+        while (!work.empty()) {
+            int32_t b = work.back();
+            work.pop_back();
+            for (int32_t d : cfg.frontier(b)) {
+                if (hasPhi[d] == int32_t(v)) {
+                    continue;
+                }
+                hasPhi[d] = v;
+                pairs.insert(pairs.end(), {d, int32_t(v)});
+                if (queued[d] != int32_t(v)) {
+                    queued[d] = v;
+                    work.push_back(d);
+                }
+            }
+        }
+    }
+    group(pairs, n, phiStart, phiVregs);
+
+    // Each PHI starts out naming the vreg it merges, with room for a pair per
+    // predecessor that renaming fills in
+    size_t pairSlots = 0;
+    for (size_t b = 0; b < n; b++) {
+        pairSlots += 2 * cfg.predecessors(b).size() * (phiStart[b + 1] - phiStart[b]);
+    }
+    f.operands.reserve(f.operands.size() + pairSlots);
+
+    code.clear();
+    code.reserve(f.code.size() + phiVregs.size());
+    for (size_t b = 0; b < n; b++) {
+        uint32_t start = code.size();
+        size_t preds = cfg.predecessors(b).size();
+        for (uint32_t i = phiStart[b]; i < phiStart[b + 1]; i++) {
+            int32_t v = phiVregs[i];
+            code.push_back(Instr{Instr::PHI, f.vregs[v], 0, v, v, int32_t(f.operands.size())});
+            f.operands.resize(f.operands.size() + 2 * preds);
+        }
+        code.insert(code.end(), f.code.begin() + f.blocks[b].start, f.code.begin() + f.blocks[b].end);
+        f.blocks[b] = BasicBlock{start, uint32_t(code.size())};
+    }
+    f.code.swap(code);
+    return phiVregs.size();
+}
+
+int32_t SSABuilder::currentName(Function& f, int32_t vreg) {
+    if (names[vreg] >= 0) {
+        return names[vreg];
+    }
+
+    Instr::Type t = f.vregs[vreg];
+    if (zero[t] < 0) {
+        zero[t] = f.vregs.size();
+        f.vregs.push_back(t);
+    }
+    return zero[t];
+}
+
+// Walk the dominator tree giving each write to a vreg with several writes a
+// new vreg of its own. Reads take the name in effect at that point, and each
+// PHI in a successor takes the name in effect at the end of the edge's source.
+void SSABuilder::rename(Function& f) {
+    size_t original = f.vregCount();
+    size_t renamed = phiVregs.size();
+    names.resize(original);
+    for (size_t v = 0; v < original; v++) {
+        names[v] = v < f.params || defCount[v] <= 1 ? int32_t(v) : -1;
+        renamed += defCount[v] > 1 ? defCount[v] : 0;
+    }
+    f.vregs.reserve(original + renamed + Instr::PTR + 1);
+    std::fill(std::begin(zero), std::end(zero), -1);
+    undo.clear();
+    undoMark.resize(f.blocks.size());
+
+    // Blocks are pushed to enter them; ~b is pushed below their children to
+    // leave them, restoring the names they replaced
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+        int32_t b = stack.back();
+        stack.pop_back();
+        if (b < 0) {
+            for (size_t i = undo.size(); i > undoMark[~b]; i -= 2) {
+                names[undo[i - 2]] = undo[i - 1];
+            }
+            undo.resize(undoMark[~b]);
+            continue;
+        }
+
+        undoMark[b] = undo.size();
+        stack.push_back(~b);
+        for (int32_t c : cfg.dominated(b)) {
+            stack.push_back(c);
+        }
+
+        for (uint32_t i = f.blocks[b].start; i < f.blocks[b].end; i++) {
+            Instr& in = f.code[i];
+            if (in.op != Instr::PHI) {
+                f.forEachUse(in, [&](int32_t& v) { v = currentName(f, v); });
+            }
+            if (in.definesDst() && in.dst < int32_t(original) && defCount[in.dst] > 1) {
+                Instr::Type t = f.vregs[in.dst];
+                undo.insert(undo.end(), {in.dst, names[in.dst]});
+                names[in.dst] = f.vregs.size();
+                f.vregs.push_back(t);
+                in.dst = names[in.dst];
+            }
+        }
+
+        for (int32_t s : cfg.successors(b)) {
+            for (uint32_t i = f.blocks[s].start; f.code[i].op == Instr::PHI; i++) {
+                Instr& phi = f.code[i];
+                f.operands[phi.b + 2 * phi.count] = b;
+                f.operands[phi.b + 2 * phi.count + 1] = currentName(f, phi.a);
+                phi.count++;
+            }
+        }
+    }
+
+    for (Instr& in : f.code) {
+        if (in.op == Instr::PHI) {
+            in.a = -1;
+        }
+    }
+
+    // Zeros for unwritten vregs go at the very start, where they dominate
+    // every read
+    size_t zeros = 0;
+    for (int t = 0; t <= Instr::PTR; t++) {
+        if (zero[t] >= 0) {
+            f.code.insert(f.code.begin(), Instr{Instr::CONST, Instr::Type(t), 0, zero[t], 0, 0});
+            zeros++;
+        }
+    }
+    if (zeros) {
+        f.blocks[0].end += zeros;
+        for (size_t b = 1; b < f.blocks.size(); b++) {
+            f.blocks[b].start += zeros;
+            f.blocks[b].end += zeros;
+        }
+    }
+}
+
+size_t SSABuilder::build(Function& f) {
+    cfg.build(f);
+    if (removeUnreachable(f, cfg)) {
+        cfg.build(f);
+    }
+
+    findDefinitions(f);
+    size_t phis = placePhis(f);
+    rename(f);
+    return phis;
+}
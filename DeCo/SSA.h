@@ -0,0 +1,68 @@
+#ifndef _SSA_H_
+#define _SSA_H_
+
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+#include "Pass.h"
+
+// Rewrites functions into static single assignment form. Unreachable blocks
+// are deleted first. PHIs go at the dominance frontiers of the blocks that
+// write a vreg (Cytron et al.), but only for vregs that are written more than
+// once and read in some block before being written there; vregs written once
+// already dominate their uses and keep their numbers. Renaming walks the
+// dominator tree with an undo log of the names it replaced, the same way the
+// SymbolTable leaves scopes, so no per-vreg stacks are allocated.
+//
+// A PHI can receive a value along a path on which its vreg was never
+// written, such as the entry to a loop whose body declares the variable. It
+// gets zero, matching what the variable would have been initialized to.
+class SSABuilder : public Pass {
+private:
+
+    CFG cfg;
+
+    // Scratch space, reused for every function
+    std::vector<uint32_t> defCount;     // Writes of each vreg, counting parameters as one
+    std::vector<int32_t> writtenIn;     // Last block seen writing each vreg
+    std::vector<uint8_t> crossesBlocks; // Read in a block before it was written there
+    std::vector<int32_t> pairs;
+    std::vector<uint32_t> defStart;     // Blocks that write each vreg needing PHIs
+    std::vector<int32_t> defBlocks;
+    std::vector<uint32_t> phiStart;     // Vregs needing a PHI in each block
+    std::vector<int32_t> phiVregs;
+    std::vector<int32_t> hasPhi;        // Last vreg given a PHI in each block
+    std::vector<int32_t> queued;        // Last vreg each block was queued for
+    std::vector<int32_t> work;
+    std::vector<Instr> code;
+    std::vector<int32_t> names;         // Current name of each original vreg, or -1
+    std::vector<int32_t> undo;          // (vreg, replaced name) pairs
+    std::vector<uint32_t> undoMark;     // undo size when each block was entered
+    std::vector<int32_t> stack;
+    int32_t zero[Instr::PTR + 1];       // Zero of each type, for unwritten vregs
+    size_t phisPlaced;                  // Since resetCounters()
+
+    void findDefinitions(Function& f);
+    size_t placePhis(Function& f);
+    void rename(Function& f);
+    int32_t currentName(Function& f, int32_t vreg);
+
+public:
+
+    SSABuilder() { resetCounters(); }
+
+    // Convert f to SSA form, returning how many PHIs were placed
+    size_t build(Function& f);
+
+    // Graph of the last function converted
+    const CFG& graph() const { return cfg; }
+
+    using Pass::run;
+    const char* name() const override { return "ssa"; }
+    void run(Function& f) override { phisPlaced += build(f); }
+
+    void resetCounters() override { phisPlaced = 0; }
+    void printCounters(std::ostream& out) const override { out << phisPlaced << " phis placed"; }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef _SCAN_KERNELS_H_
+#define _SCAN_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "CharClass.h"
+
+// Vectorized helpers for the Scanner's inner loops. Each kernel looks at 16
+// (SSE2) or 32 (AVX2, when built with -mavx2) bytes per step and finishes
+// the last few bytes with a scalar loop. Builds without SSE2 use the scalar
+// loops throughout.
+//
+// Every kernel takes a half-open range [p, end) and returns a position in it,
+// or end when the run does not stop before the end of the buffer.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_KERNELS_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_KERNELS_SIMD 1
+#endif
+
+namespace ScanKernels {
+
+inline bool isSpace(unsigned char c) { return CharClass::is(c, CharClass::SPACE); }
+inline bool isDigit(unsigned char c) { return CharClass::is(c, CharClass::DIGIT); }
+inline bool isIdentChar(unsigned char c) { return CharClass::is(c, CharClass::IDENT); }
+
+#ifdef SCAN_KERNELS_SIMD
+
+#if defined(__AVX2__)
+
+struct Vec {
+    __m256i v;
+    static const size_t width = 32;
+
+    static Vec load(const char* p) { return {_mm256_loadu_si256((const __m256i*)p)}; }
+    static Vec splat(char c) { return {_mm256_set1_epi8(c)}; }
+    Vec operator==(Vec o) const { return {_mm256_cmpeq_epi8(v, o.v)}; }
+    Vec operator|(Vec o) const { return {_mm256_or_si256(v, o.v)}; }
+    Vec operator&(Vec o) const { return {_mm256_and_si256(v, o.v)}; }
+    Vec add(Vec o) const { return {_mm256_add_epi8(v, o.v)}; }
+    Vec greater(Vec o) const { return {_mm256_cmpgt_epi8(v, o.v)}; }
+    uint32_t mask() const { return (uint32_t)_mm256_movemask_epi8(v); }
+};
+
+#else
+
+struct Vec {
+    __m128i v;
+    static const size_t width = 16;
+
+    static Vec load(const char* p) { return {_mm_loadu_si128((const __m128i*)p)}; }
+    static Vec splat(char c) { return {_mm_set1_epi8(c)}; }
+    Vec operator==(Vec o) const { return {_mm_cmpeq_epi8(v, o.v)}; }
+    Vec operator|(Vec o) const { return {_mm_or_si128(v, o.v)}; }
+    Vec operator&(Vec o) const { return {_mm_and_si128(v, o.v)}; }
+    Vec add(Vec o) const { return {_mm_add_epi8(v, o.v)}; }
+    Vec greater(Vec o) const { return {_mm_cmpgt_epi8(v, o.v)}; }
+    uint32_t mask() const { return (uint32_t)_mm_movemask_epi8(v); }
+};
+
+#endif
+
+// Lanes holding a byte in [lo, hi]. Bytes are shifted so that lo maps to -128,
+// which turns the unsigned range check into a single signed compare.
+inline Vec inRange(Vec c, char lo, char hi) {
+    Vec shifted = c.add(Vec::splat((char)(128 - (unsigned char)lo)));
+    return Vec::splat((char)((unsigned char)hi - (unsigned char)lo - 127)).greater(shifted);
+}
+
+inline Vec spaceLanes(Vec c) {
+    return (c == Vec::splat(' ')) | inRange(c, '\t', '\r');
+}
+
+inline Vec identLanes(Vec c) {
+    return inRange(c, '0', '9') | inRange(c, 'a', 'z') | inRange(c, 'A', 'Z')
+        | (c == Vec::splat('_'));
+}
+
+const uint32_t allLanes = Vec::width == 32 ? 0xffffffffu : 0xffffu;
+
+#endif
+
+// First character that is not whitespace
+inline const char* skipWhitespace(const char* p, const char* end) {
+#ifdef SCAN_KERNELS_SIMD
+    for (; p + Vec::width <= end; p += Vec::width) {
+        uint32_t stop = ~spaceLanes(Vec::load(p)).mask() & allLanes;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+    }
+#endif
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// The newline ending a line comment
+inline const char* findLineEnd(const char* p, const char* end) {
+#ifdef SCAN_KERNELS_SIMD
+    for (; p + Vec::width <= end; p += Vec::width) {
+        uint32_t stop = (Vec::load(p) == Vec::splat('\n')).mask();
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+    }
+#endif
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+// The '*' of the "*/" closing a block comment
+inline const char* findBlockCommentEnd(const char* p, const char* end) {
+#ifdef SCAN_KERNELS_SIMD
+    // Compare each byte and its successor, so one extra byte must be readable
+    for (; p + Vec::width + 1 <= end; p += Vec::width) {
+        Vec star = Vec::load(p) == Vec::splat('*');
+        Vec slash = Vec::load(p + 1) == Vec::splat('/');
+        uint32_t stop = (star & slash).mask();
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+    }
+#endif
+    for (; p + 1 < end; p++) {
+        if (p[0] == '*' && p[1] == '/') {
+            return p;
+        }
+    }
+    return end;
+}
+
+// First character that cannot continue an identifier
+inline const char* skipIdentChars(const char* p, const char* end) {
+#ifdef SCAN_KERNELS_SIMD
+    for (; p + Vec::width <= end; p += Vec::width) {
+        uint32_t stop = ~identLanes(Vec::load(p)).mask() & allLanes;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+    }
+#endif
+    while (p < end && isIdentChar(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// First character that is not a decimal digit
+inline const char* skipDigits(const char* p, const char* end) {
+#ifdef SCAN_KERNELS_SIMD
+    for (; p + Vec::width <= end; p += Vec::width) {
+        uint32_t stop = ~inRange(Vec::load(p), '0', '9').mask() & allLanes;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+    }
+#endif
+    while (p < end && isDigit(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Number of newlines in [p, end), storing the position of the last one in
+// lastNewline (untouched when there are none)
+inline size_t countNewlines(const char* p, const char* end, const char*& lastNewline) {
+    size_t count = 0;
+#ifdef SCAN_KERNELS_SIMD
+    for (; p + Vec::width <= end; p += Vec::width) {
+        uint32_t lines = (Vec::load(p) == Vec::splat('\n')).mask();
+        if (lines) {
+            count += __builtin_popcount(lines);
+            lastNewline = p + 31 - __builtin_clz(lines);
+        }
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            count++;
+            lastNewline = p;
+        }
+    }
+    return count;
+}
+
+}
+
+#endif
@@ -1,141 +1,299 @@
-#include <ctype.h>
+#include <atomic>
+#include <fcntl.h>
+#include <cstring>
 #include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CharClass.h"
+#include "ScanKernels.h"
 #include "Scanner.h"
+#include "TokenStream.h"
 
 using Kind = Token::Kind;
 
+// Lexemes of the fixed-text kinds, in Kind order
+static const std::string_view tokenSpelling[Kind::SIZE] = {
+    "&&", "||", "!", "+", "-", "*", "/", "%", "^", "==", "!=", "<", "<=", ">", 
+    ">=", "=", "+=", "-=", "*=", "/=", "%=", "^=", "++", "--", "void", "bool", 
+    "int", "float", "true", "false", "(", ")", "{", "}", "[", "]", ",", ":", ";", 
+    "if", "else", "while", "do", "for", "repeat", "until", "call", "return", 
+    "main", "function", "", "", "", "", ""
+};
+
+static_assert(sizeof(Token) <= 24, "Tokens are copied by value and should stay small");
+
+std::string_view Token::spelling(Kind kind) {
+    return tokenSpelling[kind];
+}
+
+// KEYWORDS ===================================================================
+
+// Reserved words are found with a perfect hash on length, first and last
+// character. The table is built at compile time, and the static_assert below
+// rejects any keyword list that would make two entries collide. Each slot
+// holds its keyword packed into a little-endian 64-bit word, so confirming a
+// hit is a single compare rather than a strcmp.
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    Kind kind;
+};
+
+constexpr Keyword keywords[] = {
+    {"void", Kind::VOID}, {"bool", Kind::BOOL}, {"int", Kind::INT}, 
+    {"float", Kind::FLOAT}, {"true", Kind::TRUE}, {"false", Kind::FALSE}, 
+    {"if", Kind::IF}, {"else", Kind::ELSE}, {"while", Kind::WHILE}, 
+    {"do", Kind::DO}, {"for", Kind::FOR}, {"repeat", Kind::REPEAT}, 
+    {"until", Kind::UNTIL}, {"call", Kind::CALL}, {"return", Kind::RETURN}, 
+    {"main", Kind::MAIN}, {"function", Kind::FUNC},
+};
+
+constexpr size_t keywordTableSize = 32;
+constexpr size_t minKeywordLength = 2;
+constexpr size_t maxKeywordLength = 8;
+
+constexpr size_t keywordHash(size_t length, unsigned char first, unsigned char last) {
+    return (length + 3 * first + 2 * last) & (keywordTableSize - 1);
+}
+
+constexpr uint64_t packKeyword(std::string_view text) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        word |= uint64_t((unsigned char)text[i]) << (8 * i);
+    }
+    return word;
+}
+
+struct KeywordSlot {
+    uint64_t packed;
+    uint32_t length;        // 0 for empty slots, which then never match
+    Kind kind;
+};
+
+struct KeywordTable {
+    KeywordSlot slots[keywordTableSize] = {};
+    bool perfect = true;
+    bool lengthsInRange = true;
+
+    constexpr KeywordTable() {
+        for (const Keyword& kw : keywords) {
+            size_t len = kw.text.size();
+            lengthsInRange = lengthsInRange && len >= minKeywordLength && len <= maxKeywordLength;
+
+            KeywordSlot& slot = slots[keywordHash(len, kw.text.front(), kw.text.back())];
+            perfect = perfect && slot.length == 0;
+            slot = {packKeyword(kw.text), uint32_t(len), kw.kind};
+        }
+    }
+};
+
+constexpr KeywordTable keywordTable;
+
+static_assert(keywordTable.perfect, "Keyword hash has collisions, adjust keywordHash()");
+static_assert(keywordTable.lengthsInRange, "Update min/maxKeywordLength for the keyword list");
+
+}
+
+Kind Token::keyword(std::string_view text) {
+    size_t len = text.size();
+    if (len == 0) {
+        return Kind::IDENT;
+    }
+
+    // Pack up to 8 bytes of the lexeme, and never read past its end.
+    // Lengths outside the keyword range simply fail the length compare,
+    // which keeps the lookup branch-free.
+    const char* p = text.data();
+    uint64_t word = 0;
+    memcpy(&word, p, len < 8 ? len : 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+
+    const KeywordSlot& slot = keywordTable.slots[keywordHash(len, p[0], p[len - 1])];
+    bool hit = (slot.packed == word) & (slot.length == len);
+    return hit ? slot.kind : Kind::IDENT;
+}
+
+// TOKENS =====================================================================
+
 Token::Token(int lineNum, int charPos) {
     _lineNum = lineNum;
     _charPos = charPos;
 
     // No lexeme provided, signal error
     _kind = Kind::ERROR;
-    _lexeme = "No lexeme given";
+    _text = "No lexeme given";
+    _length = 15;
 }
 
-Token::Token(std::string lexeme, int lineNum, int charPos, Kind kind) {
+Token::Token(std::string_view lexeme, int lineNum, int charPos, Kind kind) {
     _lineNum = lineNum;
     _charPos = charPos;
-    _lexeme = lexeme;
     _kind = kind;
+
+    if (hasFixedText(kind)) {
+        _text = nullptr;
+        _length = 0;
+    } else {
+        _text = lexeme.data();
+        _length = lexeme.size();
+    }
+}
+
+SourceBuffer::SourceBuffer(const std::string& path) {
+    _data = "";
+    _size = 0;
+    _mapped = false;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("Unable to stat " + path);
+    }
+
+    // Mapping an empty file fails, so leave the buffer empty instead
+    if (st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Unable to map " + path);
+        }
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+        _data = static_cast<const char*>(addr);
+        _size = st.st_size;
+        _mapped = true;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+SourceBuffer::SourceBuffer(FILE* in) {
+    if (in == nullptr) {
+        throw std::runtime_error("No input stream to scan");
+    }
+
+    // Read in large blocks rather than a character at a time
+    char block[1 << 16];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), in)) > 0) {
+        _owned.append(block, n);
+    }
+
+    _data = _owned.data();
+    _size = _owned.size();
+    _mapped = false;
+}
+
+SourceBuffer::SourceBuffer(std::string_view text) {
+    _data = text.data();
+    _size = text.size();
+    _mapped = false;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (_mapped) {
+        munmap(const_cast<char*>(_data), _size);
+    }
 }
 
-Scanner::Scanner(FILE* in) {
-    input = in;
+Scanner::Scanner(FILE* in): Scanner(std::make_shared<SourceBuffer>(in)) {}
+
+Scanner::Scanner(const std::string& path): Scanner(std::make_shared<SourceBuffer>(path)) {}
+
+Scanner::Scanner(const char* path): Scanner(std::string(path)) {}
+
+Scanner::Scanner(std::string_view text): Scanner(std::make_shared<SourceBuffer>(text)) {}
+
+Scanner::Scanner(std::shared_ptr<SourceBuffer> src): Scanner(src, 0, src->size()) {}
+
+Scanner::Scanner(std::shared_ptr<SourceBuffer> src, size_t from, size_t to) {
+    source = src;
+    cursor = source->data() + from;
+    end = source->data() + to;
+    tokStart = cursor;
     closed = false;
     lineNum = 1;
-    charPos = 0;
-    lex = "";
-    nextChar = fgetc(input);
+    lineStart = cursor;
+    counted = cursor;
+    nextChar = cursor < end ? (unsigned char)*cursor : EOF;
 }
 
 void Scanner::Error(const char* msg) {
-    printf("Scanner: Line - %d, Char - %d\n%s\n", lineNum, charPos, msg);
+    countLinesTo(cursor);
+    printf("Scanner: Line - %d, Char - %d\n%s\n", lineNum, int(cursor - lineStart), msg);
 }
 
 int Scanner::readChar() {
     int curr = nextChar;
 
-    if (curr == '\n') {
-        lineNum++;
-        charPos = 0;
-    } else {
-        charPos++;
+    // Walk the buffer, leaving nextChar at EOF once the end is reached
+    if (cursor < end) {
+        cursor++;
     }
-
-    nextChar = fgetc(input);
+    nextChar = cursor < end ? (unsigned char)*cursor : EOF;
     return curr;
 }
 
-void Scanner::resetBuf() {
-    lex.clear();
+void Scanner::advanceTo(const char* p) {
+    cursor = p;
+    nextChar = cursor < end ? (unsigned char)*cursor : EOF;
 }
 
-void Scanner::bufferChar(int c) {
-    // Check if identifier is too long
-    if (lex.size() == MAX_IDENT_LENGTH) {
-        // Throw lexical error
+void Scanner::countLinesTo(const char* p) {
+    const char* lastNewline = nullptr;
+    size_t lines = ScanKernels::countNewlines(counted, p, lastNewline);
+    if (lines) {
+        lineNum += lines;
+        lineStart = lastNewline + 1;
     }
-
-    lex.push_back(c);
+    counted = p;
 }
 
-Token Scanner::makeToken(std::string lexeme, Kind kind) {
-    return Token(lexeme, lineNum, charPos - (lexeme.size() - 1), kind);
+void Scanner::resetBuf() {
+    tokStart = cursor - 1;
 }
 
-Token Scanner::getNumber() {
+Kind Scanner::getNumber() {
     bool isFloat = false;
 
-    while (isdigit(nextChar)) {
-        bufferChar(readChar());
-    }
+    advanceTo(ScanKernels::skipDigits(cursor, end));
 
     // Could be float
     if (nextChar == '.') {
         isFloat = true;
-        bufferChar('.');
-        while (isdigit(nextChar)) {
-            bufferChar(readChar());
-        }
+        readChar();
+        advanceTo(ScanKernels::skipDigits(cursor, end));
     }
 
     // Check if next symbol is invalid, or no number following decimal
-    if (!nextCharValid() || lex.back() == '.') {
+    if (!nextCharValid() || cursor[-1] == '.') {
         return getError();
     }
 
     // Otherwise we are good to return the token as is
-    return makeToken(lex, isFloat ? Kind::FLOAT_VAL : Kind::INT_VAL);
+    return isFloat ? Kind::FLOAT_VAL : Kind::INT_VAL;
 }
 
-Token Scanner::getIdentOrKeyword() {
+Kind Scanner::getIdentOrKeyword() {
     // Start building lexeme until identifier rule is violated
-    while (isalnum(nextChar) || nextChar == '_') {
-        lex.push_back(readChar());
-    }
+    advanceTo(ScanKernels::skipIdentChars(cursor, end));
 
     // Check if next symbol is not start of valid token (or whitespace)
     if (nextCharValid()) {
-        // Check if it is a keyword
-        if (lex == "void") {
-            return makeToken("void", Kind::VOID);
-        } else if (lex == "bool") {
-            return makeToken("bool", Kind::BOOL);
-        } else if (lex == "int") {
-            return makeToken("int", Kind::INT);
-        } else if (lex == "float") {
-            return makeToken("float", Kind::FLOAT);
-        } else if (lex == "true") {
-            return makeToken("true", Kind::TRUE);
-        } else if (lex == "false") {
-            return makeToken("false", Kind::FALSE);
-        } else if (lex == "if") {
-            return makeToken("if", Kind::IF);
-        } else if (lex == "else") {
-            return makeToken("else", Kind::ELSE);
-        } else if (lex == "while") {
-            return makeToken("while", Kind::WHILE);
-        } else if (lex == "do") {
-            return makeToken("do", Kind::DO);
-        } else if (lex == "for") {
-            return makeToken("for", Kind::FOR);
-        } else if (lex == "repeat") {
-            return makeToken("repeat", Kind::REPEAT);
-        } else if (lex == "until") {
-            return makeToken("until", Kind::UNTIL);
-        } else if (lex == "call") {
-            return makeToken("call", Kind::CALL);
-        } else if (lex == "return") {
-            return makeToken("return", Kind::RETURN);
-        } else if (lex == "main") {
-            return makeToken("main", Kind::MAIN);
-        } else if (lex == "function") {
-            return makeToken("function", Kind::FUNC);
-        }
-
-        // Otherwise, it is a valid ident
-        return makeToken(lex, Kind::IDENT);
+        // Keyword, or otherwise a valid ident
+        return Token::keyword(std::string_view(tokStart, cursor - tokStart));
     }
 
     // Otherwise, stray token poisons all consecutive characters
@@ -143,39 +301,14 @@ Token Scanner::getIdentOrKeyword() {
 }
 
 bool Scanner::nextCharValid() {
-    switch (nextChar) {
-        case '&':
-        case '|':
-        case '!':
-        case '+':
-        case '-':
-        case '*':
-        case '/':
-        case '%':
-        case '^':
-        case '=':
-        case '<':
-        case '>':
-        case '(':
-        case ')':
-        case '{':
-        case '}':
-        case '[':
-        case ']':
-        case ',':
-        case ':':
-        case ';':
-            return true;
-        default:
-            return isspace(nextChar) || isalnum(nextChar) || nextChar == EOF;
-    }
+    return nextChar == EOF || CharClass::is(nextChar, CharClass::TOKEN_BOUNDARY);
 }
 
-Token Scanner::getError() {
-    while (!isspace(nextChar) && nextChar != EOF) {
-        bufferChar(readChar());
+Kind Scanner::getError() {
+    while (nextChar != EOF && !CharClass::is(nextChar, CharClass::SPACE)) {
+        readChar();
     }
-    return makeToken(lex, Kind::ERROR);
+    return Kind::ERROR;
 }
 
 bool Scanner::hasNext() {
@@ -187,175 +320,179 @@ Token Scanner::next() {
         throw std::runtime_error("No next element to scan");
     }
 
+    Kind kind = scan();
+    countLinesTo(tokStart);
+    int charPos = tokStart - lineStart + 1;
+    if (!message.empty()) {
+        return Token(message, lineNum, charPos, kind);
+    }
+    return Token(std::string_view(tokStart, cursor - tokStart), lineNum, charPos, kind);
+}
+
+Kind Scanner::scan() {
     int inChar;
-    Kind k;
-    resetBuf();
+    message = std::string_view();
 
     // Check if end of file has been reached
     if (nextChar == EOF) {
         closed = true;
-        return makeToken("", Kind::SCAN_EOF);
+        tokStart = cursor;
+        return Kind::SCAN_EOF;
     }
 
     // Try to resolve the token
-    while (nextChar != EOF) {
-        inChar = readChar();
-        
+    while (true) {
         // Skip whitespace
-        if (isspace(inChar)) {
-            continue;
+        advanceTo(ScanKernels::skipWhitespace(cursor, end));
+        if (nextChar == EOF) {
+            break;
         }
+
+        inChar = readChar();
+        resetBuf();
+
         // Could be keyword or identifier
-        else if (isalpha(inChar)) {
-            lex.push_back(inChar);
+        if (CharClass::is(inChar, CharClass::LETTER)) {
             return getIdentOrKeyword();
         }
         // Could be literal (int or float)
-        else if (isdigit(inChar)) {
-            lex.push_back(inChar);
+        else if (CharClass::is(inChar, CharClass::DIGIT)) {
             return getNumber();
         } 
         // Known symbols
         else {
             switch (inChar) {
                 case '(':
-                    return makeToken("(", Kind::OPEN_PAREN);
+                    return Kind::OPEN_PAREN;
                 case ')':
-                    return makeToken(")", Kind::CLOSE_PAREN);
+                    return Kind::CLOSE_PAREN;
                 case '{':
-                    return makeToken("{", Kind::OPEN_BRACE);
+                    return Kind::OPEN_BRACE;
                 case '}':
-                    return makeToken("}", Kind::CLOSE_BRACE);
+                    return Kind::CLOSE_BRACE;
                 case '[':
-                    return makeToken("[", Kind::OPEN_BRACKET);
+                    return Kind::OPEN_BRACKET;
                 case ']':
-                    return makeToken("]", Kind::CLOSE_BRACKET);
+                    return Kind::CLOSE_BRACKET;
                 case ',':
-                    return makeToken(",", Kind::COMMA);
+                    return Kind::COMMA;
                 case ':':
-                    return makeToken(":", Kind::COLON);
+                    return Kind::COLON;
                 case ';':
-                    return makeToken(";", Kind::SEMICOLON); 
+                    return Kind::SEMICOLON; 
 
                 // Could be comparison, arithmetic or assignment
                 case '=':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("==", Kind::EQUAL_TO);
+                        return Kind::EQUAL_TO;
                     }
-                    return makeToken("=", Kind::ASSIGN);
+                    return Kind::ASSIGN;
                 case '!':
-                    if (nextChar == '!') {
+                    if (nextChar == '=') {
                         readChar();
-                        return makeToken("!=", Kind::NOT_EQUAL);
+                        return Kind::NOT_EQUAL;
                     }
-                    return makeToken("!", Kind::NOT);
+                    return Kind::NOT;
                 case '<':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("<=", Kind::LESS_EQUAL);
+                        return Kind::LESS_EQUAL;
                     }
-                    return makeToken("<", Kind::LESS_THAN);
+                    return Kind::LESS_THAN;
                 case '>':
-                    if (nextChar == '>') {
+                    if (nextChar == '=') {
                         readChar();
-                        return makeToken(">=", Kind::GREATER_EQUAL);
+                        return Kind::GREATER_EQUAL;
                     }
-                    return makeToken(">", Kind::GREATER_THAN);
+                    return Kind::GREATER_THAN;
                 case '+':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("+=", Kind::ADD_ASSIGN);
+                        return Kind::ADD_ASSIGN;
                     } else if (nextChar == '+') {
                         readChar();
-                        return makeToken("++", Kind::UNI_INC);
+                        return Kind::UNI_INC;
                     }
-                    return makeToken("+", Kind::ADD);
+                    return Kind::ADD;
                 case '-':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("-=", Kind::SUB_ASSIGN);
+                        return Kind::SUB_ASSIGN;
                     } else if (nextChar == '-') {
                         readChar();
-                        return makeToken("--", Kind::UNI_DEC);
+                        return Kind::UNI_DEC;
                     } 
                     // Could be a negative number 
-                    if (isdigit(nextChar)) {
-                        bufferChar(inChar);
-                        bufferChar(readChar());
+                    if (CharClass::is(nextChar, CharClass::DIGIT)) {
+                        readChar();
                         return getNumber();
                     }
-                    return makeToken("-", Kind::SUB);
+                    return Kind::SUB;
                 case '*':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("*=", Kind::MUL_ASSIGN);
+                        return Kind::MUL_ASSIGN;
                     }
-                    return makeToken("*", Kind::MUL);
+                    return Kind::MUL;
                 case '/':
                     if (nextChar == '=') {
                         readChar();
-                        return makeToken("/=", Kind::DIV_ASSIGN);
+                        return Kind::DIV_ASSIGN;
                     }
                     // Could be a comment
                     if (inChar == '/') {
                         // Single-line comment
                         if (nextChar == '/') {
-                            // Skip until end of line or file
-                            inChar = readChar();
-                            while (inChar != EOF && inChar != '\n') {
-                                inChar = readChar();
-                            }
+                            // Skip until end of line or file, leaving the
+                            // newline to the whitespace skip
+                            advanceTo(ScanKernels::findLineEnd(cursor, end));
                             continue;
                         }
                         // Block comment
                         if (nextChar == '*') {
-                            int origLine = lineNum;
-                            int origChar = charPos;
                             readChar();
-                            inChar = readChar();
-
-                            // Skip until closing "*/" or end of file
-                            while (nextChar != EOF) {
-                                if (inChar == '*' && nextChar == '/') {
-                                    readChar();
-                                    break;
-                                }
-                                inChar = readChar();
-                            }
 
-                            if (nextChar == EOF) {
-                                return Token("Missing closing */", origLine, origChar, Kind::ERROR);
+                            // Skip until closing "*/" or end of file. An
+                            // unterminated comment is an error at its "/*"
+                            const char* close = ScanKernels::findBlockCommentEnd(cursor, end);
+                            advanceTo(close);
+
+                            if (close == end) {
+                                message = "Missing closing */";
+                                return Kind::ERROR;
                             }
 
+                            readChar();
+                            readChar();
                             continue;
                         }
 
                         // Must be DIV
-                        return makeToken("/", Kind::DIV);
+                        return Kind::DIV;
                     }
                 case '%':
-                    if (nextChar == '%') {
+                    if (nextChar == '=') {
                         readChar();
-                        return makeToken("%=", Kind::MOD_ASSIGN);
+                        return Kind::MOD_ASSIGN;
                     }
-                    return makeToken("%", Kind::MOD);
+                    return Kind::MOD;
                 case '^':
-                    if (nextChar == '^') {
+                    if (nextChar == '=') {
                         readChar();
-                        return makeToken("^=", Kind::DIV_ASSIGN);
+                        return Kind::POW_ASSIGN;
                     }
-                    return makeToken("^", Kind::POW);
+                    return Kind::POW;
                 case '&':
                     if (nextChar == '&') {
                         readChar();
-                        return makeToken("&&", Kind::AND);
+                        return Kind::AND;
                     }
                     return getError();
                 case '|':
                     if (nextChar == '|') {
                         readChar();
-                        return makeToken("||", Kind::OR);
+                        return Kind::OR;
                     }
                     return getError();
                 default:
@@ -364,7 +501,35 @@ Token Scanner::next() {
         }
     }
 
-    return makeToken("", Kind::SCAN_EOF);
+    closed = true;
+    tokStart = cursor;
+    return Kind::SCAN_EOF;
+}
+
+TokenStream Scanner::tokenizeAll() {
+    if (source->size() >= UINT32_MAX) {
+        throw std::runtime_error("Source is too large to tokenize into a stream");
+    }
+
+    TokenStream tokens(source);
+
+    // Roughly one token per 3 source bytes in typical DeCo code; growing the
+    // arrays past this copies them all
+    tokens.reserve((end - cursor) / 3 + 1);
+
+    // Only kinds and offsets are stored, so the scan needs no line or
+    // char positions; the stream finds those from offsets when asked
+    while (hasNext()) {
+        Kind kind = scan();
+        uint32_t offset = tokStart - source->data();
+        if (message.empty()) {
+            tokens.push(kind, offset, uint32_t(cursor - tokStart));
+        } else {
+            tokens.push(kind, offset, message);
+        }
+    }
+
+    return tokens;
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& tok) {
@@ -405,7 +570,7 @@ std::ostream& operator<<(std::ostream& os, const Token& tok) {
             os << "NOT_EQUAL";
             break;
         case Kind::LESS_THAN:
-            os << "LESS_EQUAL";
+            os << "LESS_THAN";
             break;
         case Kind::LESS_EQUAL:
             os << "LESS_EQUAL";
@@ -539,4 +704,122 @@ std::ostream& operator<<(std::ostream& os, const Token& tok) {
     }
 
     return os;
-}
\ No newline at end of file
+}
+// PARALLEL LEXING ============================================================
+
+// Inputs smaller than this are not worth splitting
+static const size_t minParallelBytes = 4 << 20;
+
+// Pick chunk boundaries roughly chunkSize apart. A boundary is always just
+// after a newline that is outside any comment, where the scanner is known to
+// be between tokens. DeCo has no string literals, so comments are the only
+// state that can carry across a newline.
+static std::vector<const char*> findChunkBoundaries(const char* begin, const char* end, size_t chunkSize) {
+    std::vector<const char*> bounds;
+    const char* target = begin + chunkSize;
+    const char* pos = begin;
+
+    while (target < end) {
+        // Comments never start before the next slash
+        const char* slash = static_cast<const char*>(memchr(pos, '/', end - pos));
+        if (slash == nullptr) {
+            slash = end;
+        }
+
+        // Cut at the first newline past each target that precedes the slash
+        while (target < slash) {
+            const char* nl = ScanKernels::findLineEnd(target, slash);
+            if (nl == slash) {
+                break;
+            }
+            bounds.push_back(nl + 1);
+            target = nl + 1 + chunkSize;
+        }
+
+        if (slash + 1 >= end) {
+            break;
+        }
+
+        // Same order of checks as next(), where "/=" wins over a comment
+        if (slash[1] == '/') {
+            pos = ScanKernels::findLineEnd(slash + 2, end);
+        } else if (slash[1] == '*') {
+            const char* close = ScanKernels::findBlockCommentEnd(slash + 2, end);
+            if (close == end) {
+                break;
+            }
+            pos = close + 2;
+        } else {
+            pos = slash + 1;
+        }
+
+        // Targets inside a comment move to its end
+        if (target < pos) {
+            target = pos;
+        }
+    }
+
+    return bounds;
+}
+
+TokenStream Scanner::tokenizeParallel(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t remaining = end - cursor;
+    if (threads == 1 || remaining < minParallelBytes) {
+        return tokenizeAll();
+    }
+    if (source->size() >= UINT32_MAX) {
+        throw std::runtime_error("Source is too large to tokenize into a stream");
+    }
+
+    // A few chunks per thread keeps the workers evenly loaded
+    size_t chunkSize = std::max(minParallelBytes / 4, remaining / (threads * 4));
+    std::vector<const char*> bounds = findChunkBoundaries(cursor, end, chunkSize);
+    bounds.insert(bounds.begin(), cursor);
+    bounds.push_back(end);
+
+    const char* base = source->data();
+    size_t chunks = bounds.size() - 1;
+    std::vector<TokenStream> streams(chunks, TokenStream(source));
+    std::atomic<size_t> nextChunk(0);
+
+    auto worker = [&]() {
+        for (size_t c = nextChunk++; c < chunks; c = nextChunk++) {
+            Scanner chunk(source, bounds[c] - base, bounds[c + 1] - base);
+            streams[c] = chunk.tokenizeAll();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, chunks); t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    // Offsets are already global and line numbers come from the shared line
+    // table, so stitching is concatenation. A chunk that ends inside a block
+    // comment means the boundary guess was wrong (e.g. a "//" inside an error
+    // token), so everything from that chunk on is rescanned in one piece.
+    TokenStream tokens(source);
+    tokens.reserve(remaining / 4 + 1);
+    for (size_t c = 0; c < chunks; c++) {
+        bool last = c + 1 == chunks;
+        if (!last && streams[c].endsInComment()) {
+            Scanner rest(source, bounds[c] - base, end - base);
+            tokens.append(rest.tokenizeAll());
+            break;
+        }
+        tokens.append(streams[c]);
+    }
+
+    cursor = end;
+    nextChar = EOF;
+    closed = true;
+    return tokens;
+}
@@ -1,9 +1,12 @@
 #ifndef _SCANNER_H_
 #define _SCANNER_H_
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <stdio.h>
 #include <string>
+#include <string_view>
 
 // Predefined token types
 class Token {
@@ -58,18 +61,33 @@ private:
     int _lineNum;
     int _charPos;
     Kind _kind;
-    std::string _lexeme;
+    uint32_t _length;
+    // Text for IDENT, number and ERROR tokens. Points into the scanned source
+    // (or static storage), so it is only valid while that source is alive.
+    // Kinds with a fixed spelling carry no text at all.
+    const char* _text;
 
 public:
     
     int lineNumber() const { return _lineNum; }
     int charPosition() const { return _charPos; }
     Kind kind() const { return _kind; }
-    const std::string& lexeme() const { return _lexeme; }
+    std::string_view lexeme() const { 
+        return _text ? std::string_view(_text, _length) : spelling(_kind); 
+    }
     bool is(Kind kind) const { return this->_kind == kind; }
 
     Token(int lineNum, int charPos);
-    Token(std::string lexeme, int lineNum, int charPos, Kind kind);
+    Token(std::string_view lexeme, int lineNum, int charPos, Kind kind);
+
+    // Whether every token of this kind has the same lexeme
+    static bool hasFixedText(Kind kind) { return kind < INT_VAL || kind == SCAN_EOF; }
+
+    // Lexeme shared by all tokens of a fixed-text kind, empty otherwise
+    static std::string_view spelling(Kind kind);
+
+    // Kind of the reserved word spelled by text, IDENT if it is not one
+    static Kind keyword(std::string_view text);
 };
 
 // Printer for tokens, good for debugging
@@ -85,46 +103,100 @@ Token scanner();
 // Throws an error
 void lexical_error(int c);
 
+// Read-only view of the whole source text. Files are memory-mapped, streams
+// are read in bulk, and caller-provided buffers are used without copying.
+class SourceBuffer {
+private:
+
+    const char* _data;
+    size_t _size;
+    bool _mapped;                   // Whether _data must be munmap'd
+    std::string _owned;             // Backing store for stream input
+
+public:
+
+    // Map a file read-only
+    SourceBuffer(const std::string& path);
+    // Read a stream until EOF
+    SourceBuffer(FILE* in);
+    // Borrow a buffer, which must outlive every Scanner using it
+    SourceBuffer(std::string_view text);
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+};
+
+class TokenStream;
+
 class Scanner {
 private:
 
-    FILE* input;            // Stream that file is stored in
+    std::shared_ptr<SourceBuffer> source;   // Shared so copies scan the same text
+    const char* cursor;             // Position of nextChar in the source
+    const char* end;                // One past the last source character
+    const char* tokStart;           // First character of the current lexeme
     bool closed;                    // Flag for whether input is closed or not
 
-    int lineNum;                    // Current line number
-    int charPos;                    // Character offset on current line
+    // Lines are only counted when a position is asked for, up to counted
+    int lineNum;                    // Line number at counted
+    const char* lineStart;          // First character of that line
+    const char* counted;            // Where line counting stopped
+
+    // Lexeme of the last token scanned when it is a message rather than
+    // source text, otherwise empty
+    std::string_view message;
 
-    std::string lex;                // Current lexeme being scanned in 
     int nextChar;                   // Contains the next char (-1 == EOF)
 
     // Read in a single char from input
     int readChar();
 
-    // Reset buffer
-    void resetBuf();
+    // Consume every character before p
+    void advanceTo(const char* p);
 
-    // Add to buffer
-    void bufferChar(int c);
+    // Bring lineNum and lineStart forward to p
+    void countLinesTo(const char* p);
 
-    // Makes a token with the lexeme and kind
-    Token makeToken(std::string lexeme, Token::Kind kind);
+    // Start a new lexeme at the last character read
+    void resetBuf();
+
+    // Scan one token, leaving its lexeme in [tokStart, cursor), without
+    // tracking line or char positions
+    Token::Kind scan();
 
     // Mark all consecutive characters as an error
-    Token getError();
+    Token::Kind getError();
 
     // Extract a number if possible
-    Token getNumber();
+    Token::Kind getNumber();
 
     // Extract a keyword or num if possible
-    Token getIdentOrKeyword();
+    Token::Kind getIdentOrKeyword();
 
     // Checks if next character could be in a valid token
     bool nextCharValid();
 
+    // Scan the whole of an already loaded source
+    Scanner(std::shared_ptr<SourceBuffer> src);
+
+    // Scan only source bytes [from, to), used for parallel chunks
+    Scanner(std::shared_ptr<SourceBuffer> src, size_t from, size_t to);
+
 public:
-    // Scan tokens from a given file
+    // Scan tokens from a given stream, read in full up front
     Scanner(FILE* in = stdin);
 
+    // Scan tokens from a memory-mapped file
+    explicit Scanner(const std::string& path);
+    explicit Scanner(const char* path);
+
+    // Scan tokens from a buffer in memory without copying it
+    explicit Scanner(std::string_view text);
+
     // Print scanning error
     void Error(const char* msg = "");
 
@@ -133,6 +205,14 @@ public:
 
     // Get next token from file
     Token next();
+
+    // Scan every remaining token into a stream, ending with SCAN_EOF
+    TokenStream tokenizeAll();
+
+    // Same result as tokenizeAll(), but large inputs are split into chunks at
+    // newlines outside comments and lexed on up to `threads` threads
+    // (0 means one per core)
+    TokenStream tokenizeParallel(unsigned threads = 0);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "SymbolTable.h"
+
+// INTERNER ===================================================================
+
+Interner::Interner(): slots(256, Slot{0, EMPTY}) {}
+
+// FNV-1a; identifiers are short, so this beats anything with a setup cost
+uint32_t Interner::hash(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h = (h ^ (unsigned char)c) * 16777619u;
+    }
+    return h;
+}
+
+uint32_t Interner::intern(std::string_view s) {
+    uint32_t h = hash(s);
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.id == EMPTY) {
+            slot = Slot{h, uint32_t(strings.size())};
+            strings.push_back(s);
+            if (strings.size() * 2 > slots.size()) {
+                grow();
+            }
+            return strings.size() - 1;
+        }
+        if (slot.hash == h && strings[slot.id] == s) {
+            return slot.id;
+        }
+    }
+}
+
+void Interner::grow() {
+    std::vector<Slot> old(slots.size() * 2, Slot{0, EMPTY});
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+
+    for (const Slot& slot : old) {
+        if (slot.id == EMPTY) {
+            continue;
+        }
+        size_t i = slot.hash & mask;
+        while (slots[i].id != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+}
+
+// SYMBOL TABLE ===============================================================
+
+uint32_t SymbolTable::intern(std::string_view name) {
+    uint32_t id = names.intern(name);
+    if (id >= bindings.size()) {
+        bindings.resize(names.size(), -1);
+    }
+    return id;
+}
+
+void SymbolTable::enterScope() {
+    scopeStarts.push_back(undoLog.size());
+}
+
+void SymbolTable::exitScope() {
+    uint32_t start = scopeStarts.back();
+    scopeStarts.pop_back();
+
+    // Give each name declared in the scope back to the symbol it shadowed
+    while (undoLog.size() > start) {
+        const Symbol& sym = symbols[undoLog.back()];
+        bindings[sym.name] = sym.shadowed;
+        undoLog.pop_back();
+    }
+}
+
+int32_t SymbolTable::declare(uint32_t name, Symbol::Kind kind, Node* decl) {
+    int32_t prev = bindings[name];
+    if (prev >= 0 && symbols[prev].depth == depth()) {
+        return -1;
+    }
+
+    int32_t index = symbols.size();
+    symbols.push_back(Symbol{name, kind, uint16_t(depth()), prev, 0, decl});
+    bindings[name] = index;
+    undoLog.push_back(index);
+    return index;
+}
@@ -0,0 +1,99 @@
+#ifndef _SYMBOL_TABLE_H_
+#define _SYMBOL_TABLE_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+struct Node;
+
+// Maps identifier text to small dense IDs, so that everything after the
+// parser compares and indexes names as integers. Open addressing with linear
+// probing; the strings themselves are views into the source.
+class Interner {
+private:
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;        // EMPTY when the slot is free
+    };
+
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    std::vector<Slot> slots;        // Power of two, at most half full
+    std::vector<std::string_view> strings;
+
+    static uint32_t hash(std::string_view s);
+    void grow();
+
+public:
+
+    Interner();
+
+    // ID of s, adding it if it is new
+    uint32_t intern(std::string_view s);
+
+    std::string_view operator[](uint32_t id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+};
+
+struct Symbol {
+    enum Kind : uint8_t { VARIABLE, PARAMETER, FUNCTION };
+
+    uint32_t name;          // Interned identifier
+    Kind kind;
+    uint16_t depth;         // Scope nesting, 0 for globals
+    int32_t shadowed;       // Symbol this one hides in an outer scope, or -1
+    uint32_t type;          // Variable type or function return type, set by the TypeChecker
+    Node* decl;             // Declaring NAME, PARAM or FUNC_DECL node
+};
+
+// Scoped symbol table. The innermost symbol for each name is found by
+// indexing an array with the name's interned ID. Declarations are recorded in
+// an undo log, so leaving a scope only restores the names it declared instead
+// of rebuilding any maps. Symbols are never removed; later passes refer to
+// them by index.
+class SymbolTable {
+private:
+
+    Interner names;
+    std::vector<Symbol> symbols;
+    std::vector<int32_t> bindings;      // Innermost symbol for each name ID, or -1
+    std::vector<int32_t> undoLog;       // Symbols in scope, innermost scope last
+    std::vector<uint32_t> scopeStarts;  // undoLog size when each open scope began
+
+public:
+
+    // Opens a scope for as long as it is alive
+    class Scope {
+    private:
+        SymbolTable& table;
+    public:
+        explicit Scope(SymbolTable& t): table(t) { table.enterScope(); }
+        ~Scope() { table.exitScope(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    uint32_t intern(std::string_view name);
+    std::string_view name(uint32_t id) const { return names[id]; }
+
+    void enterScope();
+    void exitScope();
+    int depth() const { return scopeStarts.size(); }
+
+    // Add a symbol to the current scope. Returns its index, or -1 if the name
+    // is already declared in this scope.
+    int32_t declare(uint32_t name, Symbol::Kind kind, Node* decl);
+
+    // Innermost visible symbol for name, or -1
+    int32_t lookup(uint32_t name) const {
+        return name < bindings.size() ? bindings[name] : -1;
+    }
+
+    const Symbol& operator[](int32_t i) const { return symbols[i]; }
+    Symbol& operator[](int32_t i) { return symbols[i]; }
+    size_t size() const { return symbols.size(); }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include "ScanKernels.h"
+#include "TokenStream.h"
+
+TokenStream::TokenStream(std::shared_ptr<SourceBuffer> src): source(src), lineHint(0) {}
+
+void TokenStream::reserve(size_t n) {
+    _kinds.reserve(n);
+    _offsets.reserve(n);
+    _lexemes.reserve(n);
+}
+
+void TokenStream::push(Token::Kind kind, uint32_t offset, std::string_view text) {
+    _kinds.push_back(kind);
+    _offsets.push_back(offset);
+    _lexemes.push_back(OUT_OF_LINE | outOfLine.size());
+    outOfLine.push_back(text);
+}
+
+void TokenStream::append(const TokenStream& other) {
+    if (!_kinds.empty() && _kinds.back() == Token::Kind::SCAN_EOF) {
+        _kinds.pop_back();
+        _offsets.pop_back();
+        _lexemes.pop_back();
+    }
+
+    _kinds.insert(_kinds.end(), other._kinds.begin(), other._kinds.end());
+    _offsets.insert(_offsets.end(), other._offsets.begin(), other._offsets.end());
+
+    // Out-of-line handles index the other stream's table, so rebase them
+    uint32_t shift = outOfLine.size();
+    for (uint32_t handle : other._lexemes) {
+        _lexemes.push_back(handle & OUT_OF_LINE ? handle + shift : handle);
+    }
+    outOfLine.insert(outOfLine.end(), other.outOfLine.begin(), other.outOfLine.end());
+}
+
+bool TokenStream::endsInComment() const {
+    size_t n = size();
+    if (n >= 2 && kind(n - 1) == Token::Kind::SCAN_EOF) {
+        n--;
+    }
+    if (n == 0 || kind(n - 1) != Token::Kind::ERROR) {
+        return false;
+    }
+
+    // Unterminated comments are the only errors reported at a "/*"
+    std::string_view at(source->data() + _offsets[n - 1], std::min<size_t>(2, source->size() - _offsets[n - 1]));
+    return at == "/*" && (_lexemes[n - 1] & OUT_OF_LINE);
+}
+
+std::string_view TokenStream::lexeme(size_t i) const {
+    Token::Kind k = kind(i);
+    if (Token::hasFixedText(k)) {
+        return Token::spelling(k);
+    }
+
+    uint32_t handle = _lexemes[i];
+    if (handle & OUT_OF_LINE) {
+        return outOfLine[handle & ~OUT_OF_LINE];
+    }
+    return std::string_view(source->data() + _offsets[i], handle);
+}
+
+void TokenStream::buildLineTable() const {
+    const char* begin = source->data();
+    const char* end = begin + source->size();
+
+    lineStarts.push_back(0);
+    for (const char* p = ScanKernels::findLineEnd(begin, end); p < end; 
+            p = ScanKernels::findLineEnd(p + 1, end)) {
+        lineStarts.push_back(p + 1 - begin);
+    }
+}
+
+size_t TokenStream::lineIndex(uint32_t offset) const {
+    if (lineStarts.empty()) {
+        buildLineTable();
+    }
+
+    auto contains = [&](size_t line) {
+        return line < lineStarts.size() && lineStarts[line] <= offset 
+            && (line + 1 == lineStarts.size() || offset < lineStarts[line + 1]);
+    };
+
+    // Tokens are usually looked up in order, so try the last line and the
+    // one after it before falling back to a binary search
+    if (!contains(lineHint)) {
+        if (contains(lineHint + 1)) {
+            lineHint++;
+        } else {
+            lineHint = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) 
+                - lineStarts.begin() - 1;
+        }
+    }
+
+    return lineHint;
+}
+
+int TokenStream::lineNumber(size_t i) const {
+    return lineIndex(_offsets[i]) + 1;
+}
+
+int TokenStream::charPosition(size_t i) const {
+    size_t line = lineIndex(_offsets[i]);
+    return _offsets[i] - lineStarts[line] + 1;
+}
+
+Token TokenStream::token(size_t i) const {
+    size_t line = lineIndex(_offsets[i]);
+    return Token(lexeme(i), line + 1, _offsets[i] - lineStarts[line] + 1, kind(i));
+}
+
+size_t TokenStream::bytesUsed() const {
+    return _kinds.capacity() * sizeof(uint8_t) + _offsets.capacity() * sizeof(uint32_t)
+        + _lexemes.capacity() * sizeof(uint32_t) + outOfLine.capacity() * sizeof(std::string_view)
+        + lineStarts.capacity() * sizeof(uint32_t);
+}
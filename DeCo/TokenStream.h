@@ -0,0 +1,76 @@
+#ifndef _TOKEN_STREAM_H_
+#define _TOKEN_STREAM_H_
+
+#include <cstdint>
+#include <vector>
+#include "Scanner.h"
+
+// Every token of a source, stored as parallel arrays instead of Token objects.
+// Positions are kept as byte offsets and converted to line/char on demand
+// through a line table that is only built the first time it is needed.
+class TokenStream {
+private:
+
+    std::shared_ptr<SourceBuffer> source;
+    std::vector<uint8_t> _kinds;
+    std::vector<uint32_t> _offsets;     // Byte offset of each lexeme
+    std::vector<uint32_t> _lexemes;     // Lexeme handles, see lexeme()
+
+    // Text that does not appear in the source, such as scanner messages
+    std::vector<std::string_view> outOfLine;
+
+    // Offset of the first character of each line, built lazily
+    mutable std::vector<uint32_t> lineStarts;
+    // Line of the last position looked up, so sequential lookups are O(1)
+    mutable size_t lineHint;
+
+    // Handles with this bit set index outOfLine, others are source lengths
+    static const uint32_t OUT_OF_LINE = 1u << 31;
+
+    void buildLineTable() const;
+
+    // 0-based line containing offset
+    size_t lineIndex(uint32_t offset) const;
+
+public:
+
+    TokenStream(std::shared_ptr<SourceBuffer> src);
+
+    // Append a token whose lexeme is the length bytes at offset in the source
+    void push(Token::Kind kind, uint32_t offset, uint32_t length) {
+        _kinds.push_back(kind);
+        _offsets.push_back(offset);
+        _lexemes.push_back(Token::hasFixedText(kind) ? 0 : length);
+    }
+
+    // Append a token at offset whose text is not in the source, such as a
+    // scanner message
+    void push(Token::Kind kind, uint32_t offset, std::string_view text);
+
+    // Add another stream over the same source, replacing this stream's
+    // trailing SCAN_EOF
+    void append(const TokenStream& other);
+
+    // Whether the last real token is an unterminated block comment
+    bool endsInComment() const;
+
+    void reserve(size_t n);
+
+    size_t size() const { return _kinds.size(); }
+    Token::Kind kind(size_t i) const { return Token::Kind(_kinds[i]); }
+    uint32_t offset(size_t i) const { return _offsets[i]; }
+
+    std::string_view lexeme(size_t i) const;
+    int lineNumber(size_t i) const;
+    int charPosition(size_t i) const;
+
+    // Rebuild the full Token, including its line and char position
+    Token token(size_t i) const;
+
+    const std::shared_ptr<SourceBuffer>& buffer() const { return source; }
+
+    // Heap bytes held by the arrays, not counting the source itself
+    size_t bytesUsed() const;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include <charconv>
+#include "TypeChecker.h"
+
+// Compound assignments map onto their operators by offset
+static_assert(Token::Kind::POW_ASSIGN - Token::Kind::ADD_ASSIGN == Token::Kind::POW - Token::Kind::ADD,
+    "Compound assignment operators must line up with their binary operators");
+
+static Token::Kind compoundOperator(Token::Kind assignOp) {
+    return Token::Kind(assignOp - Token::Kind::ADD_ASSIGN + Token::Kind::ADD);
+}
+
+// ERROR REPORTING ============================================================
+
+void TypeChecker::reportTypeError(const Node* n, const std::string& msg) {
+    errBuf.push_back("TypeError(" + std::to_string(unit.lineNumber(n)) + ","
+        + std::to_string(unit.charPosition(n)) + ")[" + msg + "]");
+}
+
+void TypeChecker::printErrorReport() {
+    std::cout << "TYPE ERROR REPORT:" << std::endl;
+    std::cout << "--------------------------------------------------------------------" << std::endl;
+    for (const std::string& msg : errBuf) {
+        std::cout << msg << "\n";
+    }
+}
+
+bool TypeChecker::hasError() {
+    return !errBuf.empty();
+}
+
+// DECLARATIONS ===============================================================
+
+// type { "[" integerLit "]" }, starting at dimension dim
+uint32_t TypeChecker::declaredType(const Node* typeNode, const Node* dim) {
+    if (!dim) {
+        return TypeTable::fromToken(typeNode->opKind());
+    }
+
+    uint32_t elem = declaredType(typeNode, dim->next);
+    std::string_view text = unit.text(dim);
+    int32_t length = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), length);
+
+    if (result.ec != std::errc() || length <= 0) {
+        reportTypeError(dim, "Array size " + std::string(text) + " must be a positive int.");
+        return TypeTable::ERROR;
+    }
+    if (elem == TypeTable::ERROR) {
+        return TypeTable::ERROR;
+    }
+    return types.array(elem, length);
+}
+
+// type { "[" "]" }
+uint32_t TypeChecker::paramType(const Node* typeNode) {
+    uint32_t t = TypeTable::fromToken(typeNode->opKind());
+    for (int i = 0; i < typeNode->aux; i++) {
+        t = types.array(t, TypeTable::UNSIZED);
+    }
+    return t;
+}
+
+void TypeChecker::varDecl(Node* n) {
+    Node* typeNode = n->child;
+    uint32_t t = declaredType(typeNode, typeNode->child);
+    typeNode->type = t;
+
+    for (Node* name = typeNode->next; name; name = name->next) {
+        name->type = t;
+        if (name->sym >= 0) {
+            symbols[name->sym].type = t;
+        }
+    }
+}
+
+void TypeChecker::funcDecl(Node* n) {
+    returnType = TypeTable::fromToken(n->opKind());
+    n->type = returnType;
+    if (n->sym >= 0) {
+        symbols[n->sym].type = returnType;
+    }
+
+    Node* c = n->child;
+    for (; c && c->kind == Node::PARAM; c = c->next) {
+        c->type = paramType(c->child);
+        if (c->sym >= 0) {
+            symbols[c->sym].type = c->type;
+        }
+    }
+
+    if (c) {
+        block(c);
+    }
+}
+
+// STATEMENTS =================================================================
+
+void TypeChecker::block(Node* n) {
+    for (Node* stat = n->child; stat; stat = stat->next) {
+        statement(stat);
+    }
+}
+
+void TypeChecker::statement(Node* n) {
+    switch (n->kind) {
+        case Node::VAR_DECL:
+            varDecl(n);
+            break;
+        case Node::ASSIGN:
+            assign(n);
+            break;
+        case Node::CALL:
+            call(n);
+            break;
+        case Node::IF:
+            condition(n->child);
+            block(n->child->next);
+            if (n->child->next->next) {
+                block(n->child->next->next);
+            }
+            break;
+        case Node::WHILE:
+            condition(n->child);
+            block(n->child->next);
+            break;
+        case Node::DO_WHILE:
+        case Node::REPEAT:
+            block(n->child);
+            condition(n->child->next);
+            break;
+        case Node::FOR: {
+            Node* init = n->child;
+            Node* cond = init->next;
+            Node* update = cond->next;
+            if (init->kind != Node::EMPTY) {
+                assign(init);
+            }
+            if (cond->kind != Node::EMPTY) {
+                condition(cond);
+            }
+            if (update->kind != Node::EMPTY) {
+                assign(update);
+            }
+            block(update->next);
+            break;
+        }
+        case Node::RETURN: {
+            uint32_t t = n->child ? expression(n->child) : TypeTable::VOID;
+            if (t != returnType && t != TypeTable::ERROR) {
+                reportTypeError(n, returnType == TypeTable::VOID ? "Cannot return a value from a void function."
+                    : "Function must return " + types.name(returnType) + " but returns " + types.name(t) + ".");
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void TypeChecker::assign(Node* n) {
+    Node* target = n->child;
+    uint32_t t = designator(target);
+    Token::Kind op = n->opKind();
+
+    if (t != TypeTable::ERROR && types.isArray(t)) {
+        reportTypeError(n, "Cannot assign to array type " + types.name(t) + ".");
+        t = TypeTable::ERROR;
+    }
+
+    if (op == Token::Kind::UNI_INC || op == Token::Kind::UNI_DEC) {
+        if (t != TypeTable::ERROR && !types.isNumeric(t)) {
+            reportTypeError(n, "Cannot apply " + std::string(Token::spelling(op)) + " to " + types.name(t) + ".");
+        }
+        return;
+    }
+
+    uint32_t value = expression(target->next);
+    if (op != Token::Kind::ASSIGN) {
+        value = binary(n, compoundOperator(op), t, value);
+    }
+
+    if (t != TypeTable::ERROR && value != TypeTable::ERROR && value != t) {
+        reportTypeError(n, "Cannot assign " + types.name(value) + " to " + types.name(t) + ".");
+    }
+}
+
+void TypeChecker::condition(Node* n) {
+    uint32_t t = expression(n);
+    if (t != TypeTable::BOOL && t != TypeTable::ERROR) {
+        reportTypeError(n, "Condition must be bool but is " + types.name(t) + ".");
+    }
+}
+
+// EXPRESSIONS ================================================================
+
+uint32_t TypeChecker::expression(Node* n) {
+    uint32_t t = TypeTable::ERROR;
+
+    switch (n->kind) {
+        case Node::LITERAL:
+            t = n->opKind() == Token::Kind::INT_VAL ? TypeTable::INT
+                : n->opKind() == Token::Kind::FLOAT_VAL ? TypeTable::FLOAT : TypeTable::BOOL;
+            break;
+        case Node::DESIGNATOR:
+            t = designator(n);
+            break;
+        case Node::CALL:
+            t = call(n);
+            if (t == TypeTable::VOID) {
+                reportTypeError(n, "Cannot use the result of void function " + std::string(unit.text(n)) + ".");
+                t = TypeTable::ERROR;
+            }
+            break;
+        case Node::NOT:
+            t = expression(n->child);
+            if (t != TypeTable::BOOL && t != TypeTable::ERROR) {
+                reportTypeError(n, "Cannot apply ! to " + types.name(t) + ".");
+                t = TypeTable::ERROR;
+            }
+            break;
+        case Node::BINARY: {
+            uint32_t left = expression(n->child);
+            uint32_t right = expression(n->child->next);
+            t = binary(n, n->opKind(), left, right);
+            break;
+        }
+        default:
+            break;
+    }
+
+    n->type = t;
+    return t;
+}
+
+uint32_t TypeChecker::binary(const Node* n, Token::Kind op, uint32_t left, uint32_t right) {
+    if (left == TypeTable::ERROR || right == TypeTable::ERROR) {
+        return TypeTable::ERROR;
+    }
+
+    switch (op) {
+        case Token::Kind::ADD:
+        case Token::Kind::SUB:
+        case Token::Kind::MUL:
+        case Token::Kind::DIV:
+        case Token::Kind::MOD:
+        case Token::Kind::POW:
+            if (left == right && types.isNumeric(left)) {
+                return left;
+            }
+            break;
+        case Token::Kind::AND:
+        case Token::Kind::OR:
+            if (left == TypeTable::BOOL && right == TypeTable::BOOL) {
+                return TypeTable::BOOL;
+            }
+            break;
+        case Token::Kind::EQUAL_TO:
+        case Token::Kind::NOT_EQUAL:
+            if (left == right && (types.isNumeric(left) || left == TypeTable::BOOL)) {
+                return TypeTable::BOOL;
+            }
+            break;
+        case Token::Kind::LESS_THAN:
+        case Token::Kind::LESS_EQUAL:
+        case Token::Kind::GREATER_THAN:
+        case Token::Kind::GREATER_EQUAL:
+            if (left == right && types.isNumeric(left)) {
+                return TypeTable::BOOL;
+            }
+            break;
+        default:
+            break;
+    }
+
+    reportTypeError(n, "Cannot apply " + std::string(Token::spelling(op)) + " to "
+        + types.name(left) + " and " + types.name(right) + ".");
+    return TypeTable::ERROR;
+}
+
+uint32_t TypeChecker::designator(Node* n) {
+    uint32_t t = TypeTable::ERROR;
+    if (n->sym >= 0) {
+        const Symbol& sym = symbols[n->sym];
+        if (sym.kind == Symbol::FUNCTION) {
+            reportTypeError(n, std::string(unit.text(n)) + " is a function, not a variable.");
+        } else {
+            t = sym.type;
+        }
+    }
+
+    for (Node* index = n->child; index; index = index->next) {
+        uint32_t i = expression(index);
+        if (i != TypeTable::INT && i != TypeTable::ERROR) {
+            reportTypeError(index, "Array index must be int but is " + types.name(i) + ".");
+        }
+
+        if (t == TypeTable::ERROR) {
+            continue;
+        }
+        if (!types.isArray(t)) {
+            reportTypeError(n, "Cannot index " + types.name(t) + " " + std::string(unit.text(n)) + ".");
+            t = TypeTable::ERROR;
+        } else {
+            t = types.element(t);
+        }
+    }
+
+    n->type = t;
+    return t;
+}
+
+uint32_t TypeChecker::call(Node* n) {
+    if (n->sym < 0) {
+        for (Node* arg = n->child; arg; arg = arg->next) {
+            expression(arg);
+        }
+        return n->type = TypeTable::ERROR;
+    }
+
+    const Symbol& sym = symbols[n->sym];
+    std::string name(unit.text(n));
+    if (sym.kind != Symbol::FUNCTION) {
+        reportTypeError(n, name + " is not a function.");
+        return n->type = TypeTable::ERROR;
+    }
+
+    // Arguments are matched against the PARAM children of the declaration
+    const Node* decl = sym.decl;
+    if (n->aux != decl->aux) {
+        reportTypeError(n, "Function " + name + " takes " + std::to_string(decl->aux)
+            + " arguments but got " + std::to_string(n->aux) + ".");
+    }
+
+    const Node* param = decl->child;
+    int position = 1;
+    for (Node* arg = n->child; arg; arg = arg->next, position++) {
+        uint32_t t = expression(arg);
+        bool hasParam = param && param->kind == Node::PARAM;
+
+        if (hasParam && t != TypeTable::ERROR && param->type != TypeTable::ERROR
+                && !types.accepts(param->type, t)) {
+            reportTypeError(arg, "Argument " + std::to_string(position) + " of " + name + " must be "
+                + types.name(param->type) + " but is " + types.name(t) + ".");
+        }
+        if (hasParam) {
+            param = param->next;
+        }
+    }
+
+    return n->type = sym.type;
+}
+
+// RUN THE CHECKER ============================================================
+
+TypeChecker::TypeChecker(CompilationUnit& u)
+    : unit(u), types(u.types()), symbols(u.symbols()), returnType(TypeTable::VOID) {}
+
+void TypeChecker::check() {
+    if (!unit.root()) {
+        return;
+    }
+
+    for (Node* decl = unit.root()->child; decl; decl = decl->next) {
+        if (decl->kind == Node::VAR_DECL) {
+            varDecl(decl);
+        } else {
+            funcDecl(decl);
+        }
+    }
+}
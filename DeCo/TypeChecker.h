@@ -0,0 +1,54 @@
+#ifndef _TYPE_CHECKER_H_
+#define _TYPE_CHECKER_H_
+
+#include <string>
+#include <vector>
+#include "AST.h"
+
+// Checks the types of a parsed CompilationUnit in one walk over its tree, in
+// source order. Declarations record their types on their symbols, and every
+// expression node gets the TypeTable ID of its value. Expressions that
+// contain an error get TypeTable::ERROR, which is accepted everywhere so that
+// one mistake is reported once.
+class TypeChecker {
+private:
+
+    CompilationUnit& unit;
+    TypeTable& types;
+    SymbolTable& symbols;
+    std::vector<std::string> errBuf;
+    uint32_t returnType;            // Of the function being checked
+
+    void reportTypeError(const Node* n, const std::string& msg);
+
+    // Types written in declarations
+    uint32_t declaredType(const Node* typeNode, const Node* dim);
+    uint32_t paramType(const Node* typeNode);
+
+    void varDecl(Node* n);
+    void funcDecl(Node* n);
+    void block(Node* n);
+    void statement(Node* n);
+    void assign(Node* n);
+    void condition(Node* n);
+
+    uint32_t expression(Node* n);
+    uint32_t binary(const Node* n, Token::Kind op, uint32_t left, uint32_t right);
+    uint32_t designator(Node* n);
+    uint32_t call(Node* n);
+
+public:
+
+    TypeChecker(CompilationUnit& u);
+
+    // Check the whole unit
+    void check();
+
+    // Print out any errors
+    void printErrorReport();
+
+    // Check if there were any type errors
+    bool hasError();
+};
+
+#endif
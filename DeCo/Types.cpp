@@ -0,0 +1,54 @@
+#include "Types.h"
+
+TypeTable::TypeTable() {
+    for (uint32_t t = 0; t < BUILTIN_COUNT; t++) {
+        entries.push_back(Entry{t, 0});
+    }
+}
+
+uint32_t TypeTable::array(uint32_t elem, int32_t length) {
+    uint64_t key = uint64_t(elem) << 32 | uint32_t(length);
+    auto it = arrays.find(key);
+    if (it != arrays.end()) {
+        return it->second;
+    }
+
+    uint32_t id = entries.size();
+    entries.push_back(Entry{elem, length});
+    arrays.emplace(key, id);
+    return id;
+}
+
+uint32_t TypeTable::fromToken(Token::Kind kind) {
+    switch (kind) {
+        case Token::Kind::VOID: return VOID;
+        case Token::Kind::BOOL: return BOOL;
+        case Token::Kind::INT: return INT;
+        case Token::Kind::FLOAT: return FLOAT;
+        default: return ERROR;
+    }
+}
+
+bool TypeTable::accepts(uint32_t param, uint32_t arg) const {
+    while (param != arg) {
+        if (!isArray(param) || !isArray(arg)) {
+            return false;
+        }
+        if (length(param) != UNSIZED && length(param) != length(arg)) {
+            return false;
+        }
+        param = element(param);
+        arg = element(arg);
+    }
+    return true;
+}
+
+std::string TypeTable::name(uint32_t t) const {
+    static const char* builtinNames[] = {"error", "void", "bool", "int", "float"};
+
+    std::string dims;
+    for (; isArray(t); t = element(t)) {
+        dims += length(t) == UNSIZED ? "[]" : "[" + std::to_string(length(t)) + "]";
+    }
+    return builtinNames[t] + dims;
+}
@@ -0,0 +1,64 @@
+#ifndef _TYPES_H_
+#define _TYPES_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Scanner.h"
+
+// Every type in a program, interned into one flat table so that types are
+// plain integer IDs and two types are equal exactly when their IDs are. The
+// scalar types have fixed IDs; each array type is an element type plus a
+// length, with UNSIZED for parameters declared as "int[]".
+class TypeTable {
+public:
+
+    enum Builtin : uint32_t {
+        ERROR,      // Result of an expression that already had an error
+        VOID,
+        BOOL,
+        INT,
+        FLOAT,
+
+        // Used for getting size of enum
+        BUILTIN_COUNT,
+    };
+
+    static const int32_t UNSIZED = -1;
+
+private:
+
+    struct Entry {
+        uint32_t elem;      // Element type of an array, or the type itself
+        int32_t length;     // Array length, UNSIZED, or 0 for scalars
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<uint64_t, uint32_t> arrays;  // (elem, length) to ID
+
+public:
+
+    TypeTable();
+
+    // The array of length elements of type elem
+    uint32_t array(uint32_t elem, int32_t length);
+
+    // Type named by "void", "bool", "int" or "float"
+    static uint32_t fromToken(Token::Kind kind);
+
+    bool isArray(uint32_t t) const { return t >= BUILTIN_COUNT; }
+    bool isNumeric(uint32_t t) const { return t == INT || t == FLOAT; }
+    uint32_t element(uint32_t t) const { return entries[t].elem; }
+    int32_t length(uint32_t t) const { return entries[t].length; }
+
+    // Whether a value of type arg can be passed for a parameter of type param:
+    // the same type, or arrays whose sizes match wherever param has one
+    bool accepts(uint32_t param, uint32_t arg) const;
+
+    std::string name(uint32_t t) const;
+
+    size_t size() const { return entries.size(); }
+};
+
+#endif
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include "Arithmetic.h"
+#include "Jit.h"
+#include "VM.h"
+
+VM::VM(const Program& p, size_t depth) : program(p), maxDepth(depth), jit(nullptr), threshold(0), _executed(0) {}
+
+bool VM::run(Dispatch dispatch) {
+#if DECO_THREADED_DISPATCH
+    if (dispatch == THREADED) {
+        return execute<true>();
+    }
+#endif
+    (void)dispatch;
+    return execute<false>();
+}
+
+// Operands of the instruction w, as registers of the current frame
+#define RA R[Bytecode::a(w)]
+#define RB R[Bytecode::b(w)]
+#define RC R[Bytecode::c(w)]
+
+#if DECO_THREADED_DISPATCH
+#define NEXT()                                      \
+    do {                                            \
+        w = code[pc++];                             \
+        executed++;                                 \
+        if constexpr (Threaded) {                   \
+            goto *labels[Bytecode::op(w)];          \
+        }                                           \
+        goto dispatch;                              \
+    } while (0)
+#define OP(name) case Bytecode::name: op_##name
+#else
+#define NEXT()                                      \
+    do {                                            \
+        w = code[pc++];                             \
+        executed++;                                 \
+        goto dispatch;                              \
+    } while (0)
+#define OP(name) case Bytecode::name
+#endif
+
+template <bool Threaded>
+bool VM::execute() {
+#if DECO_THREADED_DISPATCH
+    // In Bytecode::Op order
+    static const void* labels[] = {
+        &&op_MOV, &&op_GETX, &&op_SETX, &&op_LOADI, &&op_LOADW, &&op_LOADK,
+        &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_MOD, &&op_POW,
+        &&op_FADD, &&op_FSUB, &&op_FMUL, &&op_FDIV, &&op_FMOD, &&op_FPOW,
+        &&op_AND, &&op_OR, &&op_NOT,
+        &&op_EQ, &&op_NE, &&op_LT, &&op_LE, &&op_GT, &&op_GE,
+        &&op_FEQ, &&op_FNE, &&op_FLT, &&op_FLE, &&op_FGT, &&op_FGE,
+        &&op_LOADG, &&op_STOREG, &&op_GADDR, &&op_ALLOCA, &&op_LOAD, &&op_STORE,
+        &&op_JMP, &&op_JT, &&op_JF, &&op_CALL, &&op_RET, &&op_RETV,
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == Bytecode::OP_COUNT, "Missing opcode handler");
+    (void)labels;
+#endif
+
+    const uint32_t* code = program.code.data();
+    const int64_t* constants = program.constants.data();
+    const BytecodeFunction& main = program.functions[program.main];
+
+    _error.clear();
+    frames.clear();
+    calls.assign(program.functions.size(), 0);
+    registers.assign(std::max<size_t>(main.registers, 256), Value{0});
+    memory.assign(program.globalSlots + main.frameSlots, Value{0});
+
+    int32_t function = program.main;
+    uint32_t frameSize = main.registers;
+    uint32_t base = 0;
+    uint32_t memoryBase = program.globalSlots;
+    uint32_t memoryTop = memoryBase + main.frameSlots;
+    Value* R = registers.data();
+    Value* M = memory.data();
+    uint32_t pc = main.entry;
+    uint32_t w;
+    uint64_t executed = 0;
+
+    NEXT();
+dispatch:
+    switch (Bytecode::op(w)) {
+        OP(MOV):
+            RA = RB;
+            NEXT();
+        OP(GETX):
+            RA = R[Bytecode::bx(w)];
+            NEXT();
+        OP(SETX):
+            R[Bytecode::bx(w)] = RA;
+            NEXT();
+        OP(LOADI):
+            RA.i = Bytecode::sbx(w);
+            NEXT();
+        OP(LOADW):
+            RA.i = int32_t(code[pc++]);
+            NEXT();
+        OP(LOADK):
+            RA.i = constants[code[pc++]];
+            NEXT();
+
+        OP(ADD):
+            RA.i = Arithmetic::add(RB.i, RC.i);
+            NEXT();
+        OP(SUB):
+            RA.i = Arithmetic::sub(RB.i, RC.i);
+            NEXT();
+        OP(MUL):
+            RA.i = Arithmetic::mul(RB.i, RC.i);
+            NEXT();
+        OP(DIV):
+            RA.i = Arithmetic::div(RB.i, RC.i);
+            NEXT();
+        OP(MOD):
+            RA.i = Arithmetic::mod(RB.i, RC.i);
+            NEXT();
+        OP(POW):
+            RA.i = Arithmetic::pow(RB.i, RC.i);
+            NEXT();
+
+        OP(FADD):
+            RA.f = RB.f + RC.f;
+            NEXT();
+        OP(FSUB):
+            RA.f = RB.f - RC.f;
+            NEXT();
+        OP(FMUL):
+            RA.f = RB.f * RC.f;
+            NEXT();
+        OP(FDIV):
+            RA.f = RB.f / RC.f;
+            NEXT();
+        OP(FMOD):
+            RA.f = std::fmod(RB.f, RC.f);
+            NEXT();
+        OP(FPOW):
+            RA.f = std::pow(RB.f, RC.f);
+            NEXT();
+
+        OP(AND):
+            RA.i = RB.i & RC.i;
+            NEXT();
+        OP(OR):
+            RA.i = RB.i | RC.i;
+            NEXT();
+        OP(NOT):
+            RA.i = RB.i == 0;
+            NEXT();
+
+        OP(EQ):
+            RA.i = RB.i == RC.i;
+            NEXT();
+        OP(NE):
+            RA.i = RB.i != RC.i;
+            NEXT();
+        OP(LT):
+            RA.i = RB.i < RC.i;
+            NEXT();
+        OP(LE):
+            RA.i = RB.i <= RC.i;
+            NEXT();
+        OP(GT):
+            RA.i = RB.i > RC.i;
+            NEXT();
+        OP(GE):
+            RA.i = RB.i >= RC.i;
+            NEXT();
+
+        OP(FEQ):
+            RA.i = RB.f == RC.f;
+            NEXT();
+        OP(FNE):
+            RA.i = RB.f != RC.f;
+            NEXT();
+        OP(FLT):
+            RA.i = RB.f < RC.f;
+            NEXT();
+        OP(FLE):
+            RA.i = RB.f <= RC.f;
+            NEXT();
+        OP(FGT):
+            RA.i = RB.f > RC.f;
+            NEXT();
+        OP(FGE):
+            RA.i = RB.f >= RC.f;
+            NEXT();
+
+        OP(LOADG):
+            RA = M[Bytecode::bx(w)];
+            NEXT();
+        OP(STOREG):
+            M[Bytecode::bx(w)] = RA;
+            NEXT();
+        OP(GADDR):
+            RA.i = Bytecode::bx(w);
+            NEXT();
+        OP(ALLOCA): {
+            uint32_t at = memoryBase + Bytecode::bx(w);
+            std::fill(M + at, M + at + code[pc++], Value{0});
+            RA.i = at;
+            NEXT();
+        }
+        OP(LOAD): {
+            uint64_t p = uint64_t(RB.i) + uint64_t(RC.i);
+            if (p >= memoryTop) {
+                _error = "Load from " + std::to_string(int64_t(p)) + " outside memory in use";
+                goto fault;
+            }
+            RA = M[p];
+            NEXT();
+        }
+        OP(STORE): {
+            uint64_t p = uint64_t(RB.i) + uint64_t(RC.i);
+            if (p >= memoryTop) {
+                _error = "Store to " + std::to_string(int64_t(p)) + " outside memory in use";
+                goto fault;
+            }
+            M[p] = RA;
+            NEXT();
+        }
+
+        OP(JMP):
+            pc = Bytecode::ax(w);
+            NEXT();
+        OP(JT):
+            pc = RA.i ? code[pc] : pc + 1;
+            NEXT();
+        OP(JF):
+            pc = RA.i ? pc + 1 : code[pc];
+            NEXT();
+
+        OP(CALL): {
+            int32_t callee = Bytecode::bx(w);
+            const BytecodeFunction& g = program.functions[callee];
+            uint32_t count = Bytecode::a(w);
+            const uint32_t* words = code + pc + 1;
+            if (jit && (jit->compiled(callee) || (++calls[callee] == threshold && jit->compile(callee)))) {
+                arguments.resize(count);
+                for (uint32_t k = 0; k < count; k++) {
+                    arguments[k] = R[words[k / 2] >> (k & 1) * 16 & 0xFFFF];
+                }
+                Value result = jit->call(callee, arguments.data(), M);
+                if (code[pc] != Bytecode::NO_RESULT) {
+                    R[code[pc]] = result;
+                }
+                pc += 1 + (count + 1) / 2;
+                NEXT();
+            }
+            uint64_t calleeBase = uint64_t(base) + frameSize;
+            if (frames.size() >= maxDepth || calleeBase + g.registers > UINT32_MAX
+                || uint64_t(memoryTop) + g.frameSlots > UINT32_MAX) {
+                _error = "Call stack overflow calling " + g.name;
+                goto fault;
+            }
+            if (calleeBase + g.registers > registers.size()) {
+                registers.resize(std::max<size_t>(registers.size() * 2, calleeBase + g.registers));
+                R = registers.data() + base;
+            }
+            if (memoryTop + g.frameSlots > memory.size()) {
+                memory.resize(std::max<size_t>(memory.size() * 2, memoryTop + g.frameSlots));
+                M = memory.data();
+            }
+
+            // Two 16-bit argument registers to a word, after the result word
+            Value* args = registers.data() + calleeBase;
+            for (uint32_t k = 0; k < count; k++) {
+                args[g.params[k]] = R[words[k / 2] >> (k & 1) * 16 & 0xFFFF];
+            }
+            frames.push_back(Frame{pc + 1 + (count + 1) / 2, base, memoryBase, code[pc], function});
+
+            function = callee;
+            frameSize = g.registers;
+            base = calleeBase;
+            R = args;
+            memoryBase = memoryTop;
+            memoryTop += g.frameSlots;
+            pc = g.entry;
+            NEXT();
+        }
+        OP(RET):
+        OP(RETV): {
+            if (frames.empty()) {
+                goto done;
+            }
+            Value result = Bytecode::op(w) == Bytecode::RET ? RA : Value{0};
+            const Frame& caller = frames.back();
+            memoryTop = memoryBase;
+            memoryBase = caller.memoryBase;
+            base = caller.base;
+            function = caller.function;
+            frameSize = program.functions[function].registers;
+            R = registers.data() + base;
+            pc = caller.returnPc;
+            if (caller.result != Bytecode::NO_RESULT) {
+                R[caller.result] = result;
+            }
+            frames.pop_back();
+            NEXT();
+        }
+
+        default:
+            _error = "Bad opcode " + std::to_string(Bytecode::op(w)) + " at " + std::to_string(pc - 1);
+            goto fault;
+    }
+
+done:
+    _executed = executed;
+    return true;
+
+fault:
+    _executed = executed;
+    _error += " (in " + program.functions[function].name + ")";
+    return false;
+}
+
+#undef RA
+#undef RB
+#undef RC
+#undef NEXT
+#undef OP
@@ -0,0 +1,89 @@
+#ifndef _VM_H_
+#define _VM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Bytecode.h"
+
+// Computed goto needs the labels-as-values extension; other compilers only
+// get the switch
+#if defined(__GNUC__)
+#define DECO_THREADED_DISPATCH 1
+#else
+#define DECO_THREADED_DISPATCH 0
+#endif
+
+class Jit;
+
+// Runs a Program's main. Each call gets a frame of registers, stacked in one
+// vector, and the memory for its local arrays, stacked after the globals.
+//
+// The loop is written once and instantiated twice: THREADED jumps from each
+// instruction straight to the handler of the next through a table of label
+// addresses, and SWITCH goes back to a switch every time. LOAD and STORE
+// check their address against the memory in use; other faults, such as a
+// division by zero, behave as in Arithmetic.
+//
+// With a Jit, the VM is the first tier: a function called often enough is
+// compiled to machine code, and later calls run that instead, each counting
+// as one instruction executed.
+class VM {
+public:
+
+    enum Dispatch { THREADED, SWITCH };
+
+    union Value {
+        int64_t i;
+        double f;
+    };
+
+private:
+
+    struct Frame {
+        uint32_t returnPc;
+        uint32_t base;          // Caller's registers
+        uint32_t memoryBase;    // Caller's local arrays
+        uint32_t result;        // Caller's register for the result, or NO_RESULT
+        int32_t function;       // Caller
+    };
+
+    const Program& program;
+    size_t maxDepth;
+    Jit* jit;
+    uint32_t threshold;
+    std::vector<uint32_t> calls;        // Of each function, while it is interpreted
+    std::vector<Value> arguments;       // Of a call into machine code
+    std::vector<Value> registers;
+    std::vector<Value> memory;
+    std::vector<Frame> frames;
+    uint64_t _executed;
+    std::string _error;
+
+    template <bool Threaded>
+    bool execute();
+
+public:
+
+    explicit VM(const Program& p, size_t maxDepth = 100000);
+
+    // Compile a function with jit on its threshold-th call, or never if jit
+    // is null. The Jit must be for the Module this Program was made from
+    void setJit(Jit* j, uint32_t calls) {
+        jit = j;
+        threshold = calls;
+    }
+
+    // Run main from the start, with all globals zero. Returns false, with
+    // error() set, if the program faulted
+    bool run(Dispatch dispatch = THREADED);
+
+    const std::string& error() const { return _error; }
+
+    // Instructions executed by the last run, counting CALL and the rest once each
+    uint64_t executed() const { return _executed; }
+
+    Value global(uint32_t slot) const { return memory[slot]; }
+};
+
+#endif
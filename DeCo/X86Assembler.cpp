@@ -0,0 +1,453 @@
+#include "X86Assembler.h"
+
+const char* X86Assembler::names64[] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15",
+};
+
+const char* X86Assembler::names32[] = {
+    "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d",
+};
+
+// Only the low four have byte names without a REX prefix, which is all the
+// byte instructions here use
+const char* X86Assembler::names8[] = {"%al", "%cl", "%dl", "%bl"};
+
+const char* X86Assembler::conditionNames[] = {
+    "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+
+static const char* aluNames[] = {"addq", "orq", "adcq", "sbbq", "andq", "subq", "xorq", "cmpq"};
+
+X86Assembler::X86Assembler(std::ostream& o) : out(&o), origin(0), ripField(SIZE_MAX), ripTarget(0) {}
+
+X86Assembler::X86Assembler(uint64_t at) : out(nullptr), origin(at), ripField(SIZE_MAX), ripTarget(0) {}
+
+// TEXT =======================================================================
+
+std::string X86Assembler::text(const Operand& o, int width) {
+    switch (o.kind) {
+        case Operand::GPR:
+            return width == 64 ? names64[o.reg] : width == 32 ? names32[o.reg] : names8[o.reg];
+        case Operand::XMM:
+            return "%xmm" + std::to_string(o.reg);
+        case Operand::IMM:
+            return "$" + std::to_string(o.imm);
+        default:
+            break;
+    }
+    if (o.reg == RIP) {
+        return std::string(o.symbol) + (o.disp ? "+" + std::to_string(o.disp) : "") + "(%rip)";
+    }
+    std::string s = (o.disp ? std::to_string(o.disp) : "") + "(" + names64[o.reg];
+    if (o.index != NO_REGISTER) {
+        s += std::string(",") + names64[o.index] + "," + std::to_string(o.scale);
+    }
+    return s + ")";
+}
+
+void X86Assembler::text(const std::string& op, const std::string& operands) {
+    *out << "    " << op << (operands.empty() ? "" : " ") << operands << "\n";
+}
+
+void X86Assembler::directive(const std::string& d) {
+    if (out) {
+        *out << "    " << d << "\n";
+    }
+}
+
+// ENCODING ===================================================================
+
+void X86Assembler::dword(uint32_t d) {
+    for (int k = 0; k < 4; k++) {
+        byte(d >> 8 * k);
+    }
+}
+
+void X86Assembler::rex(bool w, uint8_t reg, const Operand& rm) {
+    uint8_t bits = w << 3 | (reg >> 3 & 1) << 2;
+    if (rm.kind == Operand::MEM) {
+        bits |= rm.index != NO_REGISTER ? (rm.index >> 3 & 1) << 1 : 0;
+        bits |= rm.reg != RIP ? rm.reg >> 3 & 1 : 0;
+    } else {
+        bits |= rm.reg >> 3 & 1;
+    }
+    if (bits) {
+        byte(0x40 | bits);
+    }
+}
+
+void X86Assembler::modrm(uint8_t reg, const Operand& rm) {
+    reg &= 7;
+    if (rm.kind != Operand::MEM) {
+        byte(0xC0 | reg << 3 | (rm.reg & 7));
+        return;
+    }
+    if (rm.reg == RIP) {
+        byte(0x05 | reg << 3);
+        ripField = code.size();
+        ripTarget = uint64_t(rm.imm) + rm.disp;
+        dword(0);
+        return;
+    }
+
+    // %rsp and %r12 as base need a SIB byte; %rbp and %r13 always need a
+    // displacement
+    uint8_t base = rm.reg & 7;
+    bool sib = rm.index != NO_REGISTER || base == RSP;
+    uint8_t mod = rm.disp == 0 && base != RBP ? 0 : rm.disp == int8_t(rm.disp) ? 1 : 2;
+    byte(mod << 6 | reg << 3 | (sib ? 4 : base));
+    if (sib) {
+        uint8_t scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        uint8_t index = rm.index != NO_REGISTER ? rm.index & 7 : 4;
+        byte(scale << 6 | index << 3 | base);
+    }
+    if (mod == 1) {
+        byte(rm.disp);
+    } else if (mod == 2) {
+        dword(rm.disp);
+    }
+}
+
+void X86Assembler::encode(bool w, std::initializer_list<uint8_t> opcode, uint8_t reg, const Operand& rm,
+                          uint8_t prefix) {
+    if (prefix) {
+        byte(prefix);
+    }
+    rex(w, reg, rm);
+    for (uint8_t b : opcode) {
+        byte(b);
+    }
+    modrm(reg, rm);
+}
+
+// A %rip displacement counts from the end of the instruction, which is only
+// known once any immediate after it is out
+void X86Assembler::endInstruction() {
+    if (ripField != SIZE_MAX) {
+        uint32_t disp = uint32_t(ripTarget - address());
+        for (int k = 0; k < 4; k++) {
+            code[ripField + k] = disp >> 8 * k;
+        }
+        ripField = SIZE_MAX;
+    }
+}
+
+// LABELS =====================================================================
+
+X86Assembler::Label X86Assembler::newLabel(const std::string& name) {
+    Label l{int32_t(labelNames.size())};
+    labelNames.push_back(name.empty() ? ".L" + std::to_string(l.id) : name);
+    labelAddress.push_back(UNBOUND);
+    return l;
+}
+
+void X86Assembler::bind(Label l) {
+    labelAddress[l.id] = address();
+    if (out) {
+        *out << labelNames[l.id] << ":\n";
+    }
+}
+
+void X86Assembler::bindAt(Label l, uint64_t at) {
+    labelAddress[l.id] = at;
+}
+
+void X86Assembler::rel32(Label target) {
+    fixups.push_back({code.size(), target.id});
+    dword(0);
+}
+
+bool X86Assembler::finish() {
+    bool ok = true;
+    for (const auto& fixup : fixups) {
+        uint64_t target = labelAddress[fixup.second];
+        int64_t disp = int64_t(target - (origin + fixup.first + 4));
+        ok = ok && target != UNBOUND && disp == int32_t(disp);
+        for (int k = 0; k < 4; k++) {
+            code[fixup.first + k] = uint32_t(disp) >> 8 * k;
+        }
+    }
+    fixups.clear();
+    return ok;
+}
+
+// INSTRUCTIONS ===============================================================
+
+void X86Assembler::movq(Operand to, Operand from) {
+    bool wide = from.kind == Operand::IMM && from.imm != int32_t(from.imm);
+    if (out) {
+        text(wide ? "movabsq" : "movq", text(from) + ", " + text(to));
+        return;
+    }
+    if (from.kind == Operand::IMM && wide) {
+        rex(true, 0, to);
+        byte(0xB8 + (to.reg & 7));
+        dword(uint32_t(from.imm));
+        dword(uint32_t(uint64_t(from.imm) >> 32));
+    } else if (from.kind == Operand::IMM) {
+        encode(true, {0xC7}, 0, to);
+        dword(uint32_t(from.imm));
+    } else if (to.kind == Operand::XMM) {
+        encode(true, {0x0F, 0x6E}, to.reg, from, 0x66);
+    } else if (from.kind == Operand::XMM) {
+        encode(true, {0x0F, 0x7E}, from.reg, to, 0x66);
+    } else if (from.kind == Operand::GPR) {
+        encode(true, {0x89}, from.reg, to);
+    } else {
+        encode(true, {0x8B}, to.reg, from);
+    }
+    endInstruction();
+}
+
+void X86Assembler::movsd(Operand to, Operand from) {
+    if (out) {
+        text("movsd", text(from) + ", " + text(to));
+        return;
+    }
+    if (to.kind == Operand::XMM) {
+        encode(false, {0x0F, 0x10}, to.reg, from, 0xF2);
+    } else {
+        encode(false, {0x0F, 0x11}, from.reg, to, 0xF2);
+    }
+    endInstruction();
+}
+
+void X86Assembler::movapd(uint8_t to, uint8_t from) {
+    if (out) {
+        text("movapd", text(xmm(from)) + ", " + text(xmm(to)));
+        return;
+    }
+    encode(false, {0x0F, 0x28}, to, xmm(from), 0x66);
+}
+
+void X86Assembler::movl(uint8_t to, uint32_t value) {
+    if (out) {
+        text("movl", "$" + std::to_string(value) + ", " + text(gpr(to), 32));
+        return;
+    }
+    rex(false, 0, gpr(to));
+    byte(0xB8 + (to & 7));
+    dword(value);
+}
+
+void X86Assembler::alu(Alu op, Operand to, Operand from) {
+    if (out) {
+        text(aluNames[op], text(from) + ", " + text(to));
+        return;
+    }
+    if (from.kind == Operand::IMM && from.imm == int8_t(from.imm)) {
+        encode(true, {0x83}, op, to);
+        byte(from.imm);
+    } else if (from.kind == Operand::IMM) {
+        encode(true, {0x81}, op, to);
+        dword(uint32_t(from.imm));
+    } else if (from.kind == Operand::GPR) {
+        encode(true, {uint8_t(op << 3 | 1)}, from.reg, to);
+    } else {
+        encode(true, {uint8_t(op << 3 | 3)}, to.reg, from);
+    }
+    endInstruction();
+}
+
+void X86Assembler::zero(uint8_t r) {
+    if (out) {
+        text("xorl", text(gpr(r), 32) + ", " + text(gpr(r), 32));
+        return;
+    }
+    encode(false, {0x31}, r, gpr(r));
+}
+
+void X86Assembler::imul(uint8_t to, Operand from) {
+    if (out) {
+        text("imulq", text(from) + ", " + text(gpr(to)));
+        return;
+    }
+    encode(true, {0x0F, 0xAF}, to, from);
+    endInstruction();
+}
+
+void X86Assembler::lea(uint8_t to, Operand from) {
+    if (out) {
+        text("leaq", text(from) + ", " + text(gpr(to)));
+        return;
+    }
+    encode(true, {0x8D}, to, from);
+    endInstruction();
+}
+
+void X86Assembler::sse(Sse op, uint8_t to, Operand from) {
+    if (out) {
+        static const char* names[] = {"addsd", "mulsd", "subsd", "divsd", "ucomisd", "xorpd"};
+        int k = op == ADDSD ? 0 : op == MULSD ? 1 : op == SUBSD ? 2 : op == DIVSD ? 3 : op == UCOMISD ? 4 : 5;
+        text(names[k], text(from) + ", " + text(xmm(to)));
+        return;
+    }
+    encode(false, {0x0F, op}, to, from, op == UCOMISD || op == XORPD ? 0x66 : 0xF2);
+    endInstruction();
+}
+
+void X86Assembler::test(uint8_t a, uint8_t b) {
+    if (out) {
+        text("testq", text(gpr(b)) + ", " + text(gpr(a)));
+        return;
+    }
+    encode(true, {0x85}, b, gpr(a));
+}
+
+void X86Assembler::testb(uint8_t r, uint8_t value) {
+    if (out) {
+        text("testb", "$" + std::to_string(value) + ", " + text(gpr(r), 8));
+        return;
+    }
+    encode(false, {0xF6}, 0, gpr(r));
+    byte(value);
+}
+
+void X86Assembler::setcc(Condition c, uint8_t r) {
+    if (out) {
+        text(std::string("set") + conditionNames[c], text(gpr(r), 8));
+        return;
+    }
+    encode(false, {0x0F, uint8_t(0x90 + c)}, 0, gpr(r));
+}
+
+void X86Assembler::movzbl(uint8_t to, uint8_t from) {
+    if (out) {
+        text("movzbl", text(gpr(from), 8) + ", " + text(gpr(to), 32));
+        return;
+    }
+    encode(false, {0x0F, 0xB6}, to, gpr(from));
+}
+
+void X86Assembler::andb(uint8_t to, uint8_t from) {
+    if (out) {
+        text("andb", text(gpr(from), 8) + ", " + text(gpr(to), 8));
+        return;
+    }
+    encode(false, {0x20}, from, gpr(to));
+}
+
+void X86Assembler::orb(uint8_t to, uint8_t from) {
+    if (out) {
+        text("orb", text(gpr(from), 8) + ", " + text(gpr(to), 8));
+        return;
+    }
+    encode(false, {0x08}, from, gpr(to));
+}
+
+void X86Assembler::shr1(uint8_t r) {
+    if (out) {
+        text("shrq", "$1, " + text(gpr(r)));
+        return;
+    }
+    encode(true, {0xD1}, 5, gpr(r));
+}
+
+void X86Assembler::neg(uint8_t r) {
+    if (out) {
+        text("negq", text(gpr(r)));
+        return;
+    }
+    encode(true, {0xF7}, 3, gpr(r));
+}
+
+void X86Assembler::idiv(uint8_t r) {
+    if (out) {
+        text("idivq", text(gpr(r)));
+        return;
+    }
+    encode(true, {0xF7}, 7, gpr(r));
+}
+
+void X86Assembler::cqto() {
+    if (out) {
+        text("cqto", "");
+        return;
+    }
+    byte(0x48);
+    byte(0x99);
+}
+
+void X86Assembler::repStosq() {
+    if (out) {
+        text("rep stosq", "");
+        return;
+    }
+    byte(0xF3);
+    byte(0x48);
+    byte(0xAB);
+}
+
+void X86Assembler::push(uint8_t r) {
+    if (out) {
+        text("pushq", text(gpr(r)));
+        return;
+    }
+    rex(false, 0, gpr(r));
+    byte(0x50 + (r & 7));
+}
+
+void X86Assembler::pop(uint8_t r) {
+    if (out) {
+        text("popq", text(gpr(r)));
+        return;
+    }
+    rex(false, 0, gpr(r));
+    byte(0x58 + (r & 7));
+}
+
+void X86Assembler::leave() {
+    if (out) {
+        text("leave", "");
+        return;
+    }
+    byte(0xC9);
+}
+
+void X86Assembler::ret() {
+    if (out) {
+        text("ret", "");
+        return;
+    }
+    byte(0xC3);
+}
+
+void X86Assembler::jmp(Label l) {
+    if (out) {
+        text("jmp", labelNames[l.id]);
+        return;
+    }
+    byte(0xE9);
+    rel32(l);
+}
+
+void X86Assembler::jcc(Condition c, Label l) {
+    if (out) {
+        text(std::string("j") + conditionNames[c], labelNames[l.id]);
+        return;
+    }
+    byte(0x0F);
+    byte(0x80 + c);
+    rel32(l);
+}
+
+void X86Assembler::call(Label l) {
+    if (out) {
+        text("call", labelNames[l.id]);
+        return;
+    }
+    byte(0xE8);
+    rel32(l);
+}
+
+void X86Assembler::callExternal(const char* name, uint64_t at) {
+    if (out) {
+        text("call", std::string(name) + "@PLT");
+        return;
+    }
+    movq(gpr(RAX), imm(int64_t(at)));
+    byte(0xFF);
+    byte(0xD0);
+}
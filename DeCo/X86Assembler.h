@@ -0,0 +1,154 @@
+#ifndef _X86_ASSEMBLER_H_
+#define _X86_ASSEMBLER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The x86-64 instructions X86Gen uses, written either as AT&T text for the
+// GNU assembler or as machine code into a byte buffer that will be placed at
+// a known address. Operands are 64 bits wide unless the name says otherwise.
+//
+// Jumps and calls go to labels, which finish() fills in once all are bound.
+// A label can also be bound to an absolute address, for code placed
+// earlier. Memory operands relative to %rip name a symbol in text and an
+// absolute address in machine code.
+class X86Assembler {
+public:
+
+    // Hardware register numbers
+    enum Register : uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+        RIP = 16, NO_REGISTER = 0xFF,
+    };
+
+    // Condition codes, in hardware order
+    enum Condition : uint8_t {
+        O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G,
+    };
+
+    // Two-operand integer ops, numbered as in the 0x81 opcode's /digit
+    enum Alu : uint8_t { ADD, OR, ADC, SBB, AND, SUB, XOR, CMP };
+
+    // Scalar double ops, by their second opcode byte
+    enum Sse : uint8_t { ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5C, DIVSD = 0x5E, UCOMISD = 0x2E, XORPD = 0x57 };
+
+    struct Operand {
+        enum Kind : uint8_t { GPR, XMM, MEM, IMM } kind;
+        uint8_t reg;            // Register, or base register of MEM
+        uint8_t index;          // Index register of MEM, or NO_REGISTER
+        uint8_t scale;
+        int32_t disp;
+        int64_t imm;            // IMM value, or absolute address for a MEM off %rip
+        const char* symbol;     // Symbol for a MEM off %rip, in text
+    };
+
+    static Operand gpr(uint8_t r) { return Operand{Operand::GPR, r, NO_REGISTER, 1, 0, 0, nullptr}; }
+    static Operand xmm(uint8_t r) { return Operand{Operand::XMM, r, NO_REGISTER, 1, 0, 0, nullptr}; }
+    static Operand imm(int64_t v) { return Operand{Operand::IMM, 0, NO_REGISTER, 1, 0, v, nullptr}; }
+    static Operand mem(uint8_t base, int32_t disp, uint8_t index = NO_REGISTER, uint8_t scale = 1) {
+        return Operand{Operand::MEM, base, index, scale, disp, 0, nullptr};
+    }
+    static Operand ripRelative(const char* symbol, int32_t disp, uint64_t address) {
+        return Operand{Operand::MEM, RIP, NO_REGISTER, 1, disp, int64_t(address), symbol};
+    }
+
+    struct Label {
+        int32_t id;
+    };
+
+private:
+
+    std::ostream* out;                  // Text goes here, or null for machine code
+    uint64_t origin;                    // Where code[0] will be
+    std::vector<uint8_t> code;
+    std::vector<std::string> labelNames;
+    std::vector<uint64_t> labelAddress; // Absolute, or UNBOUND
+    std::vector<std::pair<size_t, int32_t>> fixups;  // rel32 fields waiting for their label
+    size_t ripField;                    // disp32 of a %rip operand in the instruction being encoded
+    uint64_t ripTarget;
+
+    static constexpr uint64_t UNBOUND = UINT64_MAX;
+
+    static const char* names64[];
+    static const char* names32[];
+    static const char* names8[];
+    static const char* conditionNames[];
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void dword(uint32_t d);
+    void rex(bool w, uint8_t reg, const Operand& rm);
+    void modrm(uint8_t reg, const Operand& rm);
+    void encode(bool w, std::initializer_list<uint8_t> opcode, uint8_t reg, const Operand& rm, uint8_t prefix = 0);
+    void rel32(Label target);
+    void endInstruction();
+    void text(const std::string& op, const std::string& operands);
+    static std::string text(const Operand& o, int width = 64);
+
+public:
+
+    // Write text to out
+    explicit X86Assembler(std::ostream& out);
+
+    // Encode machine code to be placed at origin
+    explicit X86Assembler(uint64_t origin);
+
+    bool machineCode() const { return out == nullptr; }
+    const std::vector<uint8_t>& bytes() const { return code; }
+    uint64_t address() const { return origin + code.size(); }
+
+    // In text, name is printed where the label is bound; in machine code it
+    // is only for reading
+    Label newLabel(const std::string& name = "");
+    void bind(Label l);
+    void bindAt(Label l, uint64_t address);
+    bool isBound(Label l) const { return labelAddress[l.id] != UNBOUND; }
+    uint64_t labelAddressOf(Label l) const { return labelAddress[l.id]; }
+
+    // Emitted as is in text, dropped from machine code
+    void directive(const std::string& d);
+
+    // movq, movabsq, or movq between general and SSE registers, as the
+    // operands need
+    void movq(Operand to, Operand from);
+    void movsd(Operand to, Operand from);
+    void movapd(uint8_t to, uint8_t from);
+    void movl(uint8_t to, uint32_t value);
+    void alu(Alu op, Operand to, Operand from);
+    void zero(uint8_t r);
+    void imul(uint8_t to, Operand from);
+    void lea(uint8_t to, Operand from);
+    void sse(Sse op, uint8_t to, Operand from);
+    void test(uint8_t a, uint8_t b);
+    void testb(uint8_t r, uint8_t value);
+    void setcc(Condition c, uint8_t r);
+    void movzbl(uint8_t to, uint8_t from);
+    void andb(uint8_t to, uint8_t from);
+    void orb(uint8_t to, uint8_t from);
+    void shr1(uint8_t r);
+    void neg(uint8_t r);
+    void idiv(uint8_t r);
+    void cqto();
+    void repStosq();
+    void push(uint8_t r);
+    void pop(uint8_t r);
+    void leave();
+    void ret();
+    void jmp(Label l);
+    void jcc(Condition c, Label l);
+    void call(Label l);
+
+    // Call a C function: through the PLT in text, and by its address in
+    // machine code, which takes %rax
+    void callExternal(const char* name, uint64_t address);
+
+    // Fill in every jump and call; false if one has no label bound or is
+    // out of reach of a 32-bit displacement
+    bool finish();
+};
+
+#endif
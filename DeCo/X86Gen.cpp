@@ -0,0 +1,814 @@
+#include <algorithm>
+#include <cmath>
+#include "X86Gen.h"
+
+using Asm = X86Assembler;
+
+// The allocator's general registers, those calls clobber first
+const uint8_t X86Gen::allocatable[] = {
+    Asm::RSI, Asm::RDI, Asm::R8, Asm::R9, Asm::R10,
+    Asm::RBX, Asm::R12, Asm::R13, Asm::R14, Asm::R15,
+};
+
+static constexpr uint32_t GENERAL_REGISTERS = 10;
+static constexpr uint32_t PRESERVED = 0x1F << 5;
+
+// SSE registers the allocator hands out start at %xmm2
+static constexpr uint32_t FLOAT_REGISTERS = 14;
+static constexpr int32_t FIRST_XMM = 2;
+
+// System V argument registers, in order
+static const int32_t argumentGprs[] = {Asm::RDI, Asm::RSI, Asm::RDX, Asm::RCX, Asm::R8, Asm::R9};
+static constexpr uint32_t ARGUMENT_XMMS = 8;
+
+static uint64_t address(double (*f)(double, double)) {
+    return reinterpret_cast<uint64_t>(f);
+}
+
+X86Gen::X86Gen(Module& m)
+    : module(m), allocator({GENERAL_REGISTERS, PRESERVED}, {FLOAT_REGISTERS, 0}), as(nullptr), linkage(nullptr),
+      ipowLabel{0}, usesPow(false), fn(nullptr), fnIndex(0), arrays(0), libraryArea(0), stubs(0), epilogue{0} {}
+
+X86Assembler::Operand X86Gen::operand(Location l) {
+    switch (l.kind) {
+        case Location::GPR: return Asm::gpr(l.n);
+        case Location::XMM: return Asm::xmm(l.n);
+        case Location::MEM: return Asm::mem(Asm::RBP, l.n);
+        default: return Asm::mem(Asm::RSP, l.n);
+    }
+}
+
+// A global slot as a memory operand. In machine code the globals are not at
+// a fixed place, so their address is loaded from the cell into scratch first
+X86Assembler::Operand X86Gen::global(int32_t slot, uint8_t scratch) {
+    if (!linkage) {
+        return Asm::ripRelative("deco.globals", 8 * slot, 0);
+    }
+    as->movq(Asm::gpr(scratch), Asm::ripRelative("deco.globals.cell", 0, linkage->globalsCell));
+    return Asm::mem(scratch, 8 * slot);
+}
+
+// MOVES ======================================================================
+
+// Copy 64 bits, whatever they hold; memory to memory goes through %r11
+void X86Gen::move(Location to, Location from) {
+    if (to == from) {
+        return;
+    }
+    if (inMemory(to) && inMemory(from)) {
+        as->movq(Asm::gpr(Asm::R11), operand(from));
+        as->movq(operand(to), Asm::gpr(Asm::R11));
+    } else if (to.kind == Location::XMM && from.kind == Location::XMM) {
+        as->movapd(to.n, from.n);
+    } else if ((to.kind == Location::XMM && inMemory(from)) || (inMemory(to) && from.kind == Location::XMM)) {
+        as->movsd(operand(to), operand(from));
+    } else {
+        as->movq(operand(to), operand(from));
+    }
+}
+
+// Emit the moves as if done at once: a move goes when no other still reads
+// its target, and a cycle of them is broken by parking one value in %rax
+void X86Gen::parallelCopy() {
+    while (!moves.empty()) {
+        size_t ready = moves.size();
+        for (size_t k = 0; k < moves.size() && ready == moves.size(); k++) {
+            bool read = false;
+            for (size_t j = 0; j < moves.size() && !read; j++) {
+                read = j != k && moves[j].second == moves[k].first;
+            }
+            ready = read ? ready : k;
+        }
+        if (ready < moves.size()) {
+            move(moves[ready].first, moves[ready].second);
+            moves[ready] = moves.back();
+            moves.pop_back();
+            continue;
+        }
+        Location parked = moves[0].second;
+        move(gpr(Asm::RAX), parked);
+        for (auto& m : moves) {
+            m.second = m.second == parked ? gpr(Asm::RAX) : m.second;
+        }
+    }
+}
+
+// The moves for the PHIs of block to, coming from block from, leaving out
+// PHIs nothing reads
+void X86Gen::edgeMoves(int32_t from, int32_t to) {
+    moves.clear();
+    for (uint32_t i = fn->blocks[to].start; i < fn->blocks[to].end && fn->code[i].op == Instr::PHI; i++) {
+        const Instr& phi = fn->code[i];
+        if (!read[phi.dst]) {
+            continue;
+        }
+        for (int pair = 0; pair < phi.count; pair++) {
+            if (fn->operands[phi.b + 2 * pair] == from) {
+                Location value = location[fn->operands[phi.b + 2 * pair + 1]];
+                if (value != location[phi.dst]) {
+                    moves.push_back({location[phi.dst], value});
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Where System V passes arguments of these types: floats in the first eight
+// SSE registers, the rest in the six argument registers, and what does not
+// fit on the stack, in order, at 16(%rbp) for the callee and 0(%rsp) for
+// the caller
+void X86Gen::argumentLocations(const std::vector<Instr::Type>& types, std::vector<Location>& where,
+                               uint32_t& stackSlots, bool incoming) {
+    where.clear();
+    uint32_t gprs = 0;
+    uint32_t xmms = 0;
+    stackSlots = 0;
+    for (Instr::Type type : types) {
+        if (type == Instr::FLOAT && xmms < ARGUMENT_XMMS) {
+            where.push_back(xmm(xmms++));
+        } else if (type != Instr::FLOAT && gprs < 6) {
+            where.push_back(gpr(argumentGprs[gprs++]));
+        } else if (incoming) {
+            where.push_back(rbpSlot(16 + 8 * stackSlots++));
+        } else {
+            where.push_back(Location{Location::OUT, int32_t(8 * stackSlots++)});
+        }
+    }
+}
+
+// INSTRUCTIONS ===============================================================
+
+// v in a register: its own, or scratch when it was spilled
+X86Gen::Location X86Gen::general(int32_t v, int scratch) {
+    if (!inMemory(location[v])) {
+        return location[v];
+    }
+    Location r = fn->vregs[v] == Instr::FLOAT ? xmm(scratch) : gpr(scratch);
+    move(r, location[v]);
+    return r;
+}
+
+void X86Gen::store(int32_t v, Location from) {
+    move(location[v], from);
+}
+
+void X86Gen::constant(const Instr& in) {
+    int64_t bits = in.bits();
+    Location d = location[in.dst];
+    if (d.kind == Location::XMM && bits == 0) {
+        as->sse(Asm::XORPD, d.n, operand(d));
+    } else if (d.kind == Location::GPR || (bits == int32_t(bits) && d.kind != Location::XMM)) {
+        as->movq(operand(d), Asm::imm(bits));
+    } else {
+        as->movq(Asm::gpr(Asm::RAX), Asm::imm(bits));
+        store(in.dst, gpr(Asm::RAX));
+    }
+}
+
+// ADD, SUB, MUL, AND, OR on ints and bools, in two-address form
+void X86Gen::integerOp(const Instr& in) {
+    auto apply = [&](Location to, Location from) {
+        if (in.op == Instr::MUL) {
+            as->imul(to.n, operand(from));
+        } else {
+            Asm::Alu op = in.op == Instr::ADD ? Asm::ADD : in.op == Instr::SUB ? Asm::SUB
+                : in.op == Instr::AND ? Asm::AND : Asm::OR;
+            as->alu(op, operand(to), operand(from));
+        }
+    };
+    Location d = location[in.dst];
+    Location a = location[in.a];
+    Location b = location[in.b];
+    if (d.kind == Location::GPR && d != b) {
+        move(d, a);
+        apply(d, b);
+    } else if (d.kind == Location::GPR && in.op != Instr::SUB) {
+        apply(d, a);
+    } else {
+        move(gpr(Asm::RAX), a);
+        apply(gpr(Asm::RAX), b);
+        store(in.dst, gpr(Asm::RAX));
+    }
+}
+
+// idiv traps on x / 0 and INT64_MIN / -1, so both divisors get their own
+// path giving what Arithmetic does
+void X86Gen::divide(const Instr& in) {
+    bool mod = in.op == Instr::MOD;
+    Asm::Label byZero = as->newLabel();
+    Asm::Label byMinusOne = as->newLabel();
+    Asm::Label done = as->newLabel();
+    move(gpr(Asm::RAX), location[in.a]);
+    move(gpr(Asm::RCX), location[in.b]);
+    as->test(Asm::RCX, Asm::RCX);
+    as->jcc(Asm::E, byZero);
+    as->alu(Asm::CMP, Asm::gpr(Asm::RCX), Asm::imm(-1));
+    as->jcc(Asm::E, byMinusOne);
+    as->cqto();
+    as->idiv(Asm::RCX);
+    if (mod) {
+        as->movq(Asm::gpr(Asm::RAX), Asm::gpr(Asm::RDX));
+    }
+    as->jmp(done);
+    as->bind(byZero);
+    if (!mod) {
+        as->zero(Asm::RAX);
+    }
+    as->jmp(done);
+    as->bind(byMinusOne);
+    if (mod) {
+        as->zero(Asm::RAX);
+    } else {
+        as->neg(Asm::RAX);
+    }
+    as->bind(done);
+    store(in.dst, gpr(Asm::RAX));
+}
+
+void X86Gen::floatOp(const Instr& in) {
+    static const Asm::Sse ops[] = {Asm::ADDSD, Asm::SUBSD, Asm::MULSD, Asm::DIVSD};
+    Asm::Sse op = ops[in.op - Instr::ADD];
+    Location d = location[in.dst];
+    Location a = location[in.a];
+    Location b = location[in.b];
+    bool commutative = in.op == Instr::ADD || in.op == Instr::MUL;
+    if (d.kind == Location::XMM && d != b) {
+        move(d, a);
+        as->sse(op, d.n, operand(b));
+    } else if (d.kind == Location::XMM && commutative) {
+        as->sse(op, d.n, operand(a));
+    } else {
+        move(xmm(0), a);
+        as->sse(op, 0, operand(b));
+        store(in.dst, xmm(0));
+    }
+}
+
+void X86Gen::compare(const Instr& in) {
+    static const Asm::Condition conditions[] = {Asm::E, Asm::NE, Asm::L, Asm::LE, Asm::G, Asm::GE};
+    if (in.type != Instr::FLOAT) {
+        Location a = general(in.a, Asm::RAX);
+        as->alu(Asm::CMP, operand(a), operand(location[in.b]));
+        as->setcc(conditions[in.op - Instr::EQ], Asm::RAX);
+    } else {
+        // ucomisd sets CF and ZF like an unsigned compare, and PF too if
+        // either side is NaN, which makes every comparison but != false
+        Location a = general(in.a, 0);
+        Location b = general(in.b, 1);
+        switch (in.op) {
+            case Instr::EQ:
+                as->sse(Asm::UCOMISD, a.n, operand(b));
+                as->setcc(Asm::E, Asm::RAX);
+                as->setcc(Asm::NP, Asm::RCX);
+                as->andb(Asm::RAX, Asm::RCX);
+                break;
+            case Instr::NE:
+                as->sse(Asm::UCOMISD, a.n, operand(b));
+                as->setcc(Asm::NE, Asm::RAX);
+                as->setcc(Asm::P, Asm::RCX);
+                as->orb(Asm::RAX, Asm::RCX);
+                break;
+            case Instr::LT:
+            case Instr::LE:
+                as->sse(Asm::UCOMISD, b.n, operand(a));
+                as->setcc(in.op == Instr::LT ? Asm::A : Asm::AE, Asm::RAX);
+                break;
+            default:
+                as->sse(Asm::UCOMISD, a.n, operand(b));
+                as->setcc(in.op == Instr::GT ? Asm::A : Asm::AE, Asm::RAX);
+                break;
+        }
+    }
+    as->movzbl(Asm::RAX, Asm::RAX);
+    store(in.dst, gpr(Asm::RAX));
+}
+
+// fmod and pow from the C library clobber the registers calls are allowed
+// to, which the allocator assumed only CALL would do
+void X86Gen::libraryCall(const char* name, const Instr& in) {
+    for (size_t k = 0; k < saved.size(); k++) {
+        move(rbpSlot(libraryArea + 8 * k), saved[k]);
+    }
+    move(xmm(0), location[in.a]);
+    move(xmm(1), location[in.b]);
+    as->callExternal(name, in.op == Instr::MOD ? address(std::fmod) : address(std::pow));
+    for (size_t k = 0; k < saved.size(); k++) {
+        move(saved[k], rbpSlot(libraryArea + 8 * k));
+    }
+    store(in.dst, xmm(0));
+}
+
+void X86Gen::call(const Instr& in) {
+    const Function& callee = module.functions[in.a];
+    std::vector<Instr::Type> types;
+    for (int k = 0; k < in.count; k++) {
+        types.push_back(fn->vregs[fn->operands[in.b + k]]);
+    }
+    std::vector<Location> where;
+    uint32_t stackSlots;
+    argumentLocations(types, where, stackSlots, false);
+    moves.clear();
+    for (int k = 0; k < in.count; k++) {
+        Location value = location[fn->operands[in.b + k]];
+        if (value != where[k]) {
+            moves.push_back({where[k], value});
+        }
+    }
+    parallelCopy();
+    as->call(functionLabels[in.a]);
+    if (in.dst >= 0) {
+        store(in.dst, callee.returnType == Instr::FLOAT ? xmm(0) : gpr(Asm::RAX));
+    }
+}
+
+void X86Gen::instruction(const Instr& in) {
+    switch (in.op) {
+        case Instr::NOP:
+        case Instr::PHI:
+            break;
+        case Instr::CONST:
+            constant(in);
+            break;
+        case Instr::MOV:
+            move(location[in.dst], location[in.a]);
+            break;
+        case Instr::ADD:
+        case Instr::SUB:
+        case Instr::MUL:
+            if (in.type == Instr::FLOAT) {
+                floatOp(in);
+            } else {
+                integerOp(in);
+            }
+            break;
+        case Instr::DIV:
+            if (in.type == Instr::FLOAT) {
+                floatOp(in);
+            } else {
+                divide(in);
+            }
+            break;
+        case Instr::MOD:
+            if (in.type == Instr::FLOAT) {
+                libraryCall("fmod", in);
+            } else {
+                divide(in);
+            }
+            break;
+        case Instr::POW:
+            if (in.type == Instr::FLOAT) {
+                libraryCall("pow", in);
+            } else {
+                move(gpr(Asm::RAX), location[in.a]);
+                move(gpr(Asm::RCX), location[in.b]);
+                as->call(ipowLabel);
+                store(in.dst, gpr(Asm::RAX));
+                usesPow = true;
+            }
+            break;
+        case Instr::AND:
+        case Instr::OR:
+            integerOp(in);
+            break;
+        case Instr::NOT:
+            move(gpr(Asm::RAX), location[in.a]);
+            as->alu(Asm::XOR, Asm::gpr(Asm::RAX), Asm::imm(1));
+            store(in.dst, gpr(Asm::RAX));
+            break;
+        case Instr::EQ:
+        case Instr::NE:
+        case Instr::LT:
+        case Instr::LE:
+        case Instr::GT:
+        case Instr::GE:
+            compare(in);
+            break;
+        case Instr::LOADG: {
+            Location d = location[in.dst];
+            Location r = inMemory(d) ? gpr(Asm::R11) : d;
+            Asm::Operand g = global(in.a, Asm::R11);
+            if (r.kind == Location::XMM) {
+                as->movsd(operand(r), g);
+            } else {
+                as->movq(operand(r), g);
+            }
+            move(d, r);
+            break;
+        }
+        case Instr::STOREG: {
+            Location v = general(in.b, Asm::RAX);
+            Asm::Operand g = global(in.a, Asm::R11);
+            if (v.kind == Location::XMM) {
+                as->movsd(g, operand(v));
+            } else {
+                as->movq(g, operand(v));
+            }
+            break;
+        }
+        case Instr::GADDR:
+            as->lea(Asm::RAX, global(in.a, Asm::RAX));
+            store(in.dst, gpr(Asm::RAX));
+            break;
+        case Instr::ALLOCA: {
+            int32_t at = arrays + 8 * in.a;
+            if (in.b <= 8) {
+                for (int32_t k = 0; k < in.b; k++) {
+                    as->movq(Asm::mem(Asm::RBP, at + 8 * k), Asm::imm(0));
+                }
+            } else {
+                as->movq(Asm::gpr(Asm::R11), Asm::gpr(Asm::RDI));
+                as->lea(Asm::RDI, Asm::mem(Asm::RBP, at));
+                as->movq(Asm::gpr(Asm::RCX), Asm::imm(in.b));
+                as->zero(Asm::RAX);
+                as->repStosq();
+                as->movq(Asm::gpr(Asm::RDI), Asm::gpr(Asm::R11));
+            }
+            as->lea(Asm::RAX, Asm::mem(Asm::RBP, at));
+            store(in.dst, gpr(Asm::RAX));
+            break;
+        }
+        case Instr::OFFSET:
+        case Instr::LOAD: {
+            Asm::Operand address = Asm::mem(general(in.a, Asm::R11).n, 0, general(in.b, Asm::RAX).n, 8);
+            Location d = location[in.dst];
+            Location r = inMemory(d) ? gpr(Asm::RCX) : d;
+            if (in.op == Instr::OFFSET) {
+                as->lea(r.n, address);
+            } else if (r.kind == Location::XMM) {
+                as->movsd(operand(r), address);
+            } else {
+                as->movq(operand(r), address);
+            }
+            move(d, r);
+            break;
+        }
+        case Instr::STORE: {
+            Asm::Operand address = Asm::mem(general(in.a, Asm::R11).n, 0, general(in.b, Asm::RAX).n, 8);
+            Location v = location[in.dst];
+            if (inMemory(v)) {
+                move(gpr(Asm::RCX), v);
+                v = gpr(Asm::RCX);
+            }
+            if (v.kind == Location::XMM) {
+                as->movsd(address, operand(v));
+            } else {
+                as->movq(address, operand(v));
+            }
+            break;
+        }
+        case Instr::CALL:
+            call(in);
+            break;
+        default:
+            break;
+    }
+}
+
+// CONTROL FLOW ===============================================================
+
+void X86Gen::terminator(int32_t b, const Instr& in) {
+    if (in.op == Instr::RET) {
+        if (in.a >= 0) {
+            move(fn->vregs[in.a] == Instr::FLOAT ? xmm(0) : gpr(Asm::RAX), location[in.a]);
+        }
+        if (size_t(b) + 1 < fn->blocks.size()) {
+            as->jmp(epilogue);
+        }
+        return;
+    }
+    if (in.op == Instr::JMP) {
+        edgeMoves(b, in.a);
+        parallelCopy();
+        if (in.a != b + 1) {
+            as->jmp(blockLabels[in.a]);
+        }
+        return;
+    }
+
+    as->alu(Asm::CMP, operand(location[in.a]), Asm::imm(0));
+    int32_t whenTrue = in.b;
+    int32_t whenFalse = in.dst;
+    edgeMoves(b, whenTrue);
+    bool trueMoves = !moves.empty();
+    edgeMoves(b, whenFalse);
+    bool falseMoves = !moves.empty();
+
+    if (!trueMoves && !falseMoves) {
+        if (whenTrue == b + 1) {
+            as->jcc(Asm::E, blockLabels[whenFalse]);
+        } else {
+            as->jcc(Asm::NE, blockLabels[whenTrue]);
+            if (whenFalse != b + 1) {
+                as->jmp(blockLabels[whenFalse]);
+            }
+        }
+        return;
+    }
+
+    // Moves for one side go after the branch, for the other in a stub
+    // after those, unless that side needs none and the branch can go
+    // straight to its block
+    bool trueFirst = trueMoves;
+    int32_t first = trueFirst ? whenTrue : whenFalse;
+    int32_t second = trueFirst ? whenFalse : whenTrue;
+    bool stub = trueMoves && falseMoves;
+    Asm::Label stubLabel = as->newLabel(".L" + std::to_string(fnIndex) + "_s" + std::to_string(stubs++));
+    as->jcc(trueFirst ? Asm::E : Asm::NE, stub ? stubLabel : blockLabels[second]);
+    edgeMoves(b, first);
+    parallelCopy();
+    if (stub || first != b + 1) {
+        as->jmp(blockLabels[first]);
+    }
+    if (stub) {
+        as->bind(stubLabel);
+        edgeMoves(b, second);
+        parallelCopy();
+        if (second != b + 1) {
+            as->jmp(blockLabels[second]);
+        }
+    }
+}
+
+// FUNCTIONS ==================================================================
+
+// The frame, from %rbp down: callee-saved registers the function uses, spill
+// slots, room for registers saved around fmod and pow, local arrays, and
+// stack arguments of calls, with %rsp kept 16-byte aligned
+void X86Gen::function(size_t index) {
+    fn = &module.functions[index];
+    fnIndex = index;
+    allocator.allocate(*fn);
+
+    uint32_t usedGeneral = allocator.usedRegisters(RegisterAllocator::GENERAL);
+    uint32_t usedFloat = allocator.usedRegisters(RegisterAllocator::FLOAT);
+    std::vector<Location> calleeSaved;
+    saved.clear();
+    for (uint32_t r = 0; r < GENERAL_REGISTERS; r++) {
+        if (usedGeneral >> r & 1) {
+            (PRESERVED >> r & 1 ? calleeSaved : saved).push_back(gpr(allocatable[r]));
+        }
+    }
+    for (uint32_t r = 0; r < FLOAT_REGISTERS; r++) {
+        if (usedFloat >> r & 1) {
+            saved.push_back(xmm(FIRST_XMM + r));
+        }
+    }
+
+    bool library = false;
+    uint32_t outgoing = 0;
+    std::vector<Instr::Type> types;
+    std::vector<Location> where;
+    for (const Instr& in : fn->code) {
+        library = library || (in.type == Instr::FLOAT && (in.op == Instr::MOD || in.op == Instr::POW));
+        if (in.op == Instr::CALL) {
+            types.clear();
+            for (int k = 0; k < in.count; k++) {
+                types.push_back(fn->vregs[fn->operands[in.b + k]]);
+            }
+            uint32_t stackSlots;
+            argumentLocations(types, where, stackSlots, false);
+            outgoing = std::max(outgoing, stackSlots);
+        }
+    }
+    if (!library) {
+        saved.clear();
+    }
+
+    int32_t spills = -8 * int32_t(calleeSaved.size());
+    libraryArea = spills - 8 * int32_t(allocator.spillSlots() + saved.size());
+    arrays = libraryArea - 8 * int32_t(fn->frameSlots);
+    int64_t frameSize = -int64_t(arrays) + 8 * int64_t(outgoing);
+    frameSize = (frameSize + 15) & ~int64_t(15);
+
+    read.assign(fn->vregCount(), false);
+    for (Instr& in : fn->code) {
+        fn->forEachUse(in, [&](int32_t& v) { read[v] = true; });
+    }
+    location.assign(fn->vregCount(), Location{Location::NONE, 0});
+    for (size_t v = 0; v < location.size(); v++) {
+        if (allocator.reg(v) >= 0) {
+            bool isFloat = RegisterAllocator::classOf(fn->vregs[v]) == RegisterAllocator::FLOAT;
+            location[v] = isFloat ? xmm(FIRST_XMM + allocator.reg(v)) : gpr(allocatable[allocator.reg(v)]);
+        } else if (allocator.slot(v) >= 0) {
+            location[v] = rbpSlot(spills - 8 * (allocator.slot(v) + 1));
+        }
+    }
+
+    std::string prefix = ".L" + std::to_string(fnIndex);
+    blockLabels.clear();
+    for (size_t b = 0; b < fn->blocks.size(); b++) {
+        blockLabels.push_back(as->newLabel(prefix + "_" + std::to_string(b)));
+    }
+    epilogue = as->newLabel(prefix + "_ret");
+
+    std::string name = "deco_" + fn->name;
+    as->directive(".type " + name + ", @function");
+    if (linkage) {
+        linkage->functions[index] = as->address();
+    }
+    as->bind(functionLabels[index]);
+    as->push(Asm::RBP);
+    as->movq(Asm::gpr(Asm::RBP), Asm::gpr(Asm::RSP));
+    if (frameSize) {
+        as->alu(Asm::SUB, Asm::gpr(Asm::RSP), Asm::imm(frameSize));
+    }
+    for (size_t k = 0; k < calleeSaved.size(); k++) {
+        move(rbpSlot(-8 * int32_t(k + 1)), calleeSaved[k]);
+    }
+
+    types.assign(fn->vregs.begin(), fn->vregs.begin() + fn->params);
+    uint32_t stackSlots;
+    argumentLocations(types, where, stackSlots, true);
+    moves.clear();
+    for (uint32_t p = 0; p < fn->params; p++) {
+        if (location[p].kind != Location::NONE && location[p] != where[p]) {
+            moves.push_back({location[p], where[p]});
+        }
+    }
+    parallelCopy();
+
+    for (size_t b = 0; b < fn->blocks.size(); b++) {
+        as->bind(blockLabels[b]);
+        const BasicBlock& block = fn->blocks[b];
+        for (uint32_t i = block.start; i + 1 < block.end; i++) {
+            instruction(fn->code[i]);
+        }
+        terminator(b, fn->code[block.end - 1]);
+    }
+
+    as->bind(epilogue);
+    for (size_t k = 0; k < calleeSaved.size(); k++) {
+        move(calleeSaved[k], rbpSlot(-8 * int32_t(k + 1)));
+    }
+    as->leave();
+    as->ret();
+    as->directive(".size " + name + ", .-" + name);
+}
+
+// A way in from C++ for the function: takes its arguments as 8-byte slots at
+// %rdi and a place for the result at %rsi, and holds on to them over the
+// call in %rbx and %r12
+void X86Gen::entry(size_t index) {
+    const Function& f = module.functions[index];
+    std::vector<Instr::Type> types(f.vregs.begin(), f.vregs.begin() + f.params);
+    std::vector<Location> where;
+    uint32_t stackSlots;
+    argumentLocations(types, where, stackSlots, false);
+
+    linkage->entries[index] = as->address();
+    as->push(Asm::RBP);
+    as->movq(Asm::gpr(Asm::RBP), Asm::gpr(Asm::RSP));
+    as->push(Asm::RBX);
+    as->push(Asm::R12);
+    as->movq(Asm::gpr(Asm::RBX), Asm::gpr(Asm::RDI));
+    as->movq(Asm::gpr(Asm::R12), Asm::gpr(Asm::RSI));
+    if (stackSlots) {
+        as->alu(Asm::SUB, Asm::gpr(Asm::RSP), Asm::imm(16 * ((stackSlots + 1) / 2)));
+    }
+    for (size_t k = 0; k < where.size(); k++) {
+        Asm::Operand arg = Asm::mem(Asm::RBX, 8 * k);
+        if (where[k].kind == Location::OUT) {
+            as->movq(Asm::gpr(Asm::R11), arg);
+            as->movq(operand(where[k]), Asm::gpr(Asm::R11));
+        } else if (where[k].kind == Location::XMM) {
+            as->movsd(operand(where[k]), arg);
+        } else {
+            as->movq(operand(where[k]), arg);
+        }
+    }
+    as->call(functionLabels[index]);
+    if (f.returnType == Instr::FLOAT) {
+        as->movsd(Asm::mem(Asm::R12, 0), Asm::xmm(0));
+    } else if (f.returnType != Instr::VOID) {
+        as->movq(Asm::mem(Asm::R12, 0), Asm::gpr(Asm::RAX));
+    }
+    as->lea(Asm::RSP, Asm::mem(Asm::RBP, -16));
+    as->pop(Asm::R12);
+    as->pop(Asm::RBX);
+    as->pop(Asm::RBP);
+    as->ret();
+}
+
+// Integer power by repeated squaring, with Arithmetic's answers for negative
+// exponents: takes the base in %rax and the exponent in %rcx, and only
+// touches scratch registers
+void X86Gen::ipow() {
+    Asm::Label loop = as->newLabel();
+    Asm::Label even = as->newLabel();
+    Asm::Label done = as->newLabel();
+    Asm::Label negative = as->newLabel();
+    Asm::Label zero = as->newLabel();
+    as->directive(".type deco.ipow, @function");
+    as->bind(ipowLabel);
+    as->test(Asm::RCX, Asm::RCX);
+    as->jcc(Asm::S, negative);
+    as->movq(Asm::gpr(Asm::R11), Asm::gpr(Asm::RAX));
+    as->movl(Asm::RAX, 1);
+    as->bind(loop);
+    as->test(Asm::RCX, Asm::RCX);
+    as->jcc(Asm::E, done);
+    as->testb(Asm::RCX, 1);
+    as->jcc(Asm::E, even);
+    as->imul(Asm::RAX, Asm::gpr(Asm::R11));
+    as->bind(even);
+    as->imul(Asm::R11, Asm::gpr(Asm::R11));
+    as->shr1(Asm::RCX);
+    as->jmp(loop);
+    as->bind(done);
+    as->ret();
+    as->bind(negative);
+    as->alu(Asm::CMP, Asm::gpr(Asm::RAX), Asm::imm(1));
+    as->jcc(Asm::E, done);
+    as->alu(Asm::CMP, Asm::gpr(Asm::RAX), Asm::imm(-1));
+    as->jcc(Asm::NE, zero);
+    as->testb(Asm::RCX, 1);
+    as->jcc(Asm::NE, done);
+    as->movl(Asm::RAX, 1);
+    as->ret();
+    as->bind(zero);
+    as->zero(Asm::RAX);
+    as->ret();
+    as->directive(".size deco.ipow, .-deco.ipow");
+}
+
+void X86Gen::runtime() {
+    if (usesPow) {
+        ipow();
+    }
+
+    uint64_t globalBytes = 8 * uint64_t(module.globalSlots);
+    as->directive(".globl main");
+    as->directive(".type main, @function");
+    as->bind(as->newLabel("main"));
+    as->push(Asm::RBP);
+    as->movq(Asm::gpr(Asm::RBP), Asm::gpr(Asm::RSP));
+    as->call(functionLabels[module.main]);
+    as->movl(Asm::RDI, 1);
+    as->lea(Asm::RSI, Asm::ripRelative("deco.globals", 0, 0));
+    as->movq(Asm::gpr(Asm::RDX), Asm::imm(globalBytes));
+    as->callExternal("write", 0);
+    as->zero(Asm::RAX);
+    as->pop(Asm::RBP);
+    as->ret();
+    as->directive(".size main, .-main");
+
+    as->directive(".bss");
+    as->directive(".align 16");
+    as->bind(as->newLabel("deco.globals"));
+    as->directive(".zero " + std::to_string(std::max<uint64_t>(globalBytes, 8)));
+    as->directive(".section .note.GNU-stack,\"\",@progbits");
+}
+
+void X86Gen::generate(std::ostream& o) {
+    X86Assembler assembler(o);
+    as = &assembler;
+    linkage = nullptr;
+    usesPow = false;
+    stubs = 0;
+    functionLabels.clear();
+    for (const Function& f : module.functions) {
+        functionLabels.push_back(as->newLabel("deco_" + f.name));
+    }
+    ipowLabel = as->newLabel("deco.ipow");
+    as->directive(".text");
+    for (size_t i = 0; i < module.functions.size(); i++) {
+        function(i);
+    }
+    runtime();
+    as = nullptr;
+}
+
+bool X86Gen::compile(const std::vector<int32_t>& functions, X86Assembler& assembler, Linkage& l) {
+    as = &assembler;
+    linkage = &l;
+    usesPow = false;
+    stubs = 0;
+    l.functions.resize(module.functions.size(), 0);
+    l.entries.resize(module.functions.size(), 0);
+    functionLabels.clear();
+    for (size_t f = 0; f < module.functions.size(); f++) {
+        functionLabels.push_back(as->newLabel());
+        if (l.functions[f]) {
+            as->bindAt(functionLabels[f], l.functions[f]);
+        }
+    }
+    ipowLabel = as->newLabel();
+    if (l.ipow) {
+        as->bindAt(ipowLabel, l.ipow);
+    }
+
+    for (int32_t f : functions) {
+        function(f);
+    }
+    for (int32_t f : functions) {
+        entry(f);
+    }
+    if (usesPow && !l.ipow) {
+        l.ipow = as->address();
+        ipow();
+    }
+    as = nullptr;
+    linkage = nullptr;
+    return assembler.finish();
+}
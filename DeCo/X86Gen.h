@@ -0,0 +1,124 @@
+#ifndef _X86_GEN_H_
+#define _X86_GEN_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "IR.h"
+#include "RegisterAllocator.h"
+#include "X86Assembler.h"
+
+// Compiles a Module in SSA form to x86-64 assembly for the GNU assembler, in
+// AT&T syntax, following the System V ABI. The output is a whole program:
+// DeCo function f becomes deco_f, and a C main calls deco_main, writes the
+// globals to stdout as raw 8-byte slots, and returns 0, so that a test can
+// compare them with what another engine computed. Link it with the C and
+// math libraries, e.g. "gcc prog.s -lm".
+//
+// Ints, bools and pointers live in general registers and floats in SSE
+// registers, as RegisterAllocator assigns them; spilled vregs get stack
+// slots. %rax, %rcx, %rdx, %r11, %xmm0 and %xmm1 are never allocated and
+// serve as scratch. Pointers are machine addresses, so LOAD and STORE are
+// not bounds checked. Calls use the native stack with the standard argument
+// registers, and % and ^ on floats call fmod and pow.
+//
+// PHIs become a parallel copy at the end of each predecessor, as in
+// BytecodeGen. Blocks stay in order, and jumps to the next block are left out.
+//
+// The same code can instead go straight into memory as machine code, a few
+// functions at a time, for Jit. There the globals are wherever a cell in
+// memory points, and the C library is called by address.
+class X86Gen {
+public:
+
+    // What machine code compiled by earlier calls to compile() is linked
+    // against; compile() adds what it places
+    struct Linkage {
+        std::vector<uint64_t> functions;    // Address of each function, or 0 if not compiled
+        std::vector<uint64_t> entries;      // Of its entry stub, see compile()
+        uint64_t ipow;                      // Of the integer power helper, or 0
+        uint64_t globalsCell;               // Of 8 bytes holding the address of global slot 0
+    };
+
+private:
+
+    // Where a value is: a register (general ones by hardware number, SSE
+    // ones as %xmm<n>) or 8 bytes at an offset from %rbp, or from %rsp for
+    // outgoing arguments
+    struct Location {
+        enum Kind : uint8_t { NONE, GPR, XMM, MEM, OUT } kind;
+        int32_t n;
+
+        bool operator==(const Location& o) const { return kind == o.kind && n == o.n; }
+        bool operator!=(const Location& o) const { return !(*this == o); }
+    };
+
+    Module& module;
+    RegisterAllocator allocator;
+    X86Assembler* as;
+    Linkage* linkage;                   // Null when writing text
+    std::vector<X86Assembler::Label> functionLabels;
+    X86Assembler::Label ipowLabel;
+    bool usesPow;
+
+    // The function being compiled
+    Function* fn;
+    size_t fnIndex;
+    std::vector<Location> location;     // Of each vreg
+    std::vector<bool> read;             // Whether anything reads each vreg
+    std::vector<std::pair<Location, Location>> moves;  // Parallel copy being built, as (to, from)
+    std::vector<Location> saved;        // Registers to save around calls into the C library
+    int32_t arrays;                     // Offset of frame slot 0 from %rbp
+    int32_t libraryArea;                // Offset of where saved goes
+    uint32_t stubs;                     // Labels made so far for edge moves
+    std::vector<X86Assembler::Label> blockLabels;
+    X86Assembler::Label epilogue;
+
+    static const uint8_t allocatable[];
+
+    static Location gpr(int32_t n) { return Location{Location::GPR, n}; }
+    static Location xmm(int32_t n) { return Location{Location::XMM, n}; }
+    static Location rbpSlot(int32_t offset) { return Location{Location::MEM, offset}; }
+
+    static X86Assembler::Operand operand(Location l);
+    static bool inMemory(Location l) { return l.kind == Location::MEM || l.kind == Location::OUT; }
+    X86Assembler::Operand global(int32_t slot, uint8_t scratch);
+
+    void move(Location to, Location from);
+    void parallelCopy();
+    void edgeMoves(int32_t from, int32_t to);
+    void argumentLocations(const std::vector<Instr::Type>& types, std::vector<Location>& where, uint32_t& stackSlots, bool incoming);
+
+    Location general(int32_t v, int scratch);
+    void store(int32_t v, Location from);
+    void constant(const Instr& in);
+    void integerOp(const Instr& in);
+    void divide(const Instr& in);
+    void floatOp(const Instr& in);
+    void compare(const Instr& in);
+    void libraryCall(const char* name, const Instr& in);
+    void call(const Instr& in);
+    void instruction(const Instr& in);
+    void terminator(int32_t b, const Instr& in);
+    void function(size_t index);
+    void entry(size_t index);
+    void ipow();
+    void runtime();
+
+public:
+
+    explicit X86Gen(Module& m);
+
+    // Write the whole program as assembly
+    void generate(std::ostream& out);
+
+    // Compile the given functions into as, which makes machine code, along
+    // with an entry stub for each, void(const int64_t* args, int64_t* result),
+    // that C++ can call. Functions they call must be among them or already
+    // in linkage. Returns false if a jump is out of reach
+    bool compile(const std::vector<int32_t>& functions, X86Assembler& as, Linkage& linkage);
+};
+
+#endif
@@ -0,0 +1,1549 @@
+#include <chrono>
+#include <ctype.h>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../BytecodeGen.h"
+#include "../CharClass.h"
+#include "../DeadCode.h"
+#include "../GVN.h"
+#include "../IRGen.h"
+#include "../Inliner.h"
+#include "../Jit.h"
+#include "../Loops.h"
+#include "../SCCP.h"
+#include "../SSA.h"
+#include "../ScanKernels.h"
+#include "../SymbolTable.h"
+#include "../Parser.h"
+#include "../RegisterAllocator.h"
+#include "../Scanner.h"
+#include "../TokenStream.h"
+#include "../TypeChecker.h"
+#include "../VM.h"
+
+using Kind = Token::Kind;
+using Clock = std::chrono::steady_clock;
+
+// Keep results observable so the optimizer cannot drop timed loops
+static volatile size_t sink;
+
+// Count heap allocations, for passes that should not make any
+static size_t allocations;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+template <typename F>
+static double timeIt(F f) {
+    Clock::time_point start = Clock::now();
+    f();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Identifier-heavy DeCo text in the shape our code generator emits
+static std::string identCorpus(size_t bytes) {
+    static const char* words[] = {
+        "int", "float", "bool", "main", "function", "call", "return", "for",
+        "while", "if", "else", "true", "false", "void", "tmp_value", "idx",
+        "counter_12", "result", "intermediate_sum", "row", "col", "mainLoop",
+        "functional", "i", "j", "k", "acc_0", "iffy", "format", "boolean",
+    };
+    std::mt19937 rng(42);
+    std::string out;
+    out.reserve(bytes + 64);
+    while (out.size() < bytes) {
+        out += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        out += (rng() % 8 == 0) ? '\n' : ' ';
+    }
+    return out;
+}
+
+// A valid DeCo program built from many copies of a loop-heavy function
+static std::string programCorpus(size_t bytes) {
+    std::string out = "int g0, g1, g2;\nfloat scale;\nbool flag;\n\n";
+    int n = 0;
+    while (out.size() < bytes) {
+        std::string f = "f" + std::to_string(n++);
+        out += "// helper " + f + "\n"
+            "function " + f + "(int a, int b, int[] data): int {\n"
+            "    int t, i;\n"
+            "    float acc;\n"
+            "    t = a;\n"
+            "    acc = 0.5;\n"
+            "    for (i = 0; i < 8; i++) {\n"
+            "        t = t + (a * i - b) / 3 + i % 5;\n"
+            "        data[i] = t * 2 - data[i];\n"
+            "        if (t > 1000) {\n"
+            "            t -= 1000;\n"
+            "        } else {\n"
+            "            t += 1;\n"
+            "        }\n"
+            "        acc *= 1.25;\n"
+            "    }\n"
+            "    while ((t > 50) && !(t == 77)) {\n"
+            "        t -= 7;\n"
+            "    }\n"
+            "    return t;\n"
+            "}\n\n";
+    }
+
+    out += "main() : void {\n    int[8] data;\n";
+    for (int i = 0; i < n; i++) {
+        out += "    g" + std::to_string(i % 3) + " = call f" + std::to_string(i) + "(" 
+            + std::to_string(i) + ", g" + std::to_string((i + 1) % 3) + ", data);\n";
+    }
+    out += "}\n";
+    return out;
+}
+
+// KEYWORDS ===================================================================
+
+// The if/else chain getIdentOrKeyword() used before the perfect hash
+static Kind chainKeyword(std::string_view lex) {
+    if (lex == "void") return Kind::VOID;
+    else if (lex == "bool") return Kind::BOOL;
+    else if (lex == "int") return Kind::INT;
+    else if (lex == "float") return Kind::FLOAT;
+    else if (lex == "true") return Kind::TRUE;
+    else if (lex == "false") return Kind::FALSE;
+    else if (lex == "if") return Kind::IF;
+    else if (lex == "else") return Kind::ELSE;
+    else if (lex == "while") return Kind::WHILE;
+    else if (lex == "do") return Kind::DO;
+    else if (lex == "for") return Kind::FOR;
+    else if (lex == "repeat") return Kind::REPEAT;
+    else if (lex == "until") return Kind::UNTIL;
+    else if (lex == "call") return Kind::CALL;
+    else if (lex == "return") return Kind::RETURN;
+    else if (lex == "main") return Kind::MAIN;
+    else if (lex == "function") return Kind::FUNC;
+    return Kind::IDENT;
+}
+
+static void benchKeywords() {
+    std::string text = identCorpus(32 << 20);
+
+    // Split once so only the lookup itself is timed
+    std::vector<std::string_view> words;
+    for (size_t i = 0; i < text.size();) {
+        size_t j = text.find_first_of(" \n", i);
+        words.emplace_back(text.data() + i, j - i);
+        i = j + 1;
+    }
+
+    size_t chainSum = 0, hashSum = 0;
+    double chain = timeIt([&] {
+        for (std::string_view w : words) chainSum += chainKeyword(w);
+    });
+    double hash = timeIt([&] {
+        for (std::string_view w : words) hashSum += Token::keyword(w);
+    });
+    sink = chainSum + hashSum;
+
+    if (chainSum != hashSum) {
+        std::cout << "keywords: MISMATCH between if-chain and perfect hash" << std::endl;
+    }
+    std::cout << "keywords: " << words.size() << " lookups, if-chain "
+        << chain * 1e9 / words.size() << " ns/lookup, perfect hash "
+        << hash * 1e9 / words.size() << " ns/lookup (" << chain / hash << "x)" << std::endl;
+
+    size_t tokens = 0;
+    double scan = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        while (s.hasNext()) {
+            s.next();
+            tokens++;
+        }
+    });
+    std::cout << "keywords: scanned " << tokens << " tokens at "
+        << text.size() / scan / 1e6 << " MB/s" << std::endl;
+}
+
+// SCAN KERNELS ===============================================================
+
+// Generated code with comment banners, deep indentation and long names
+static std::string bannerCorpus(size_t bytes) {
+    std::mt19937 rng(7);
+    std::string out;
+    out.reserve(bytes + 512);
+    while (out.size() < bytes) {
+        switch (rng() % 4) {
+            case 0:
+                out += "/*" + std::string(76, '*') + "\n * generated block "
+                    + std::to_string(rng()) + "\n " + std::string(76, '*') + "*/\n";
+                break;
+            case 1:
+                out += "// " + std::string(60, '-') + "\n";
+                break;
+            default:
+                out += std::string(4 * (1 + rng() % 6), ' ') 
+                    + "generated_intermediate_value_" + std::to_string(rng() % 1000) 
+                    + " = accumulator_for_row_and_column + 1234567;\n";
+        }
+    }
+    return out;
+}
+
+// Byte-at-a-time equivalents of the kernels, as the scanner used to run
+static const char* scalarSkip(const char* p, const char* end, bool (*keep)(unsigned char)) {
+    while (p < end && keep(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static void benchKernels() {
+    std::string text = bannerCorpus(64 << 20);
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    // Walk the corpus alternating between runs of each class
+    auto walk = [&](auto skipSpace, auto skipIdent, auto findLine) {
+        size_t steps = 0;
+        for (const char* p = begin; p < end; steps++) {
+            p = skipSpace(p, end);
+            p = skipIdent(p, end);
+            if (p < end && !ScanKernels::isSpace(*p) && !ScanKernels::isIdentChar(*p)) {
+                p = findLine(p, end) + 1;
+            }
+        }
+        return steps;
+    };
+
+    size_t scalarSteps = 0, simdSteps = 0;
+    double scalar = timeIt([&] {
+        scalarSteps = walk(
+            [](const char* p, const char* e) { return scalarSkip(p, e, ScanKernels::isSpace); },
+            [](const char* p, const char* e) { return scalarSkip(p, e, ScanKernels::isIdentChar); },
+            [](const char* p, const char* e) { 
+                return scalarSkip(p, e, [](unsigned char c) { return c != '\n'; }); 
+            });
+    });
+    double simd = timeIt([&] {
+        simdSteps = walk(ScanKernels::skipWhitespace, ScanKernels::skipIdentChars, 
+            ScanKernels::findLineEnd);
+    });
+    sink = scalarSteps + simdSteps;
+
+    if (scalarSteps != simdSteps) {
+        std::cout << "kernels: MISMATCH between scalar and vector walks" << std::endl;
+    }
+    std::cout << "kernels: run skipping, byte loop " << text.size() / scalar / 1e6 
+        << " MB/s, vector " << text.size() / simd / 1e6 << " MB/s (" 
+        << scalar / simd << "x)" << std::endl;
+
+    const char* last = nullptr;
+    size_t lines = 0;
+    double count = timeIt([&] { lines = ScanKernels::countNewlines(begin, end, last); });
+    sink = lines;
+    std::cout << "kernels: newline counting " << text.size() / count / 1e6 << " MB/s" << std::endl;
+
+    size_t tokens = 0;
+    double scan = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        while (s.hasNext()) {
+            s.next();
+            tokens++;
+        }
+    });
+    std::cout << "kernels: scanned comment-heavy corpus, " << tokens << " tokens at "
+        << text.size() / scan / 1e6 << " MB/s" << std::endl;
+}
+
+// CHARACTER CLASSES ==========================================================
+
+// Scanner::nextCharValid() as it was before the class table
+static bool switchBoundary(int c) {
+    switch (c) {
+        case '&': case '|': case '!': case '+': case '-': case '*': case '/': 
+        case '%': case '^': case '=': case '<': case '>': case '(': case ')': 
+        case '{': case '}': case '[': case ']': case ',': case ':': case ';':
+            return true;
+        default:
+            return isspace(c) || isalnum(c) || c == EOF;
+    }
+}
+
+static void benchCharClass() {
+    std::string text = identCorpus(16 << 20) + bannerCorpus(16 << 20);
+
+    size_t switchCount = 0, tableCount = 0;
+    double viaSwitch = timeIt([&] {
+        for (unsigned char c : text) {
+            switchCount += switchBoundary(c) + (isalpha(c) ? 2 : 0) + (isdigit(c) ? 4 : 0);
+        }
+    });
+    double viaTable = timeIt([&] {
+        for (unsigned char c : text) {
+            tableCount += CharClass::is(c, CharClass::TOKEN_BOUNDARY)
+                + (CharClass::is(c, CharClass::LETTER) ? 2 : 0) 
+                + (CharClass::is(c, CharClass::DIGIT) ? 4 : 0);
+        }
+    });
+    sink = switchCount + tableCount;
+
+    if (switchCount != tableCount) {
+        std::cout << "charclass: MISMATCH between ctype/switch and table" << std::endl;
+    }
+    std::cout << "charclass: classify, ctype/switch " << text.size() / viaSwitch / 1e6 
+        << " MB/s, table " << text.size() / viaTable / 1e6 << " MB/s (" 
+        << viaSwitch / viaTable << "x)" << std::endl;
+
+    size_t tokens = 0;
+    double scan = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        while (s.hasNext()) {
+            s.next();
+            tokens++;
+        }
+    });
+    std::cout << "charclass: scanned mixed corpus, " << tokens << " tokens at "
+        << text.size() / scan / 1e6 << " MB/s" << std::endl;
+}
+
+// TOKEN STREAM ===============================================================
+
+static void benchStream() {
+    std::string text = programCorpus(32 << 20);
+
+    size_t pulled = 0;
+    double viaNext = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        while (s.hasNext()) {
+            s.next();
+            pulled++;
+        }
+    });
+
+    TokenStream tokens(nullptr);
+    double viaStream = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        tokens = s.tokenizeAll();
+    });
+
+    double lines = timeIt([&] { sink = tokens.lineNumber(tokens.size() - 1); });
+
+    size_t count = tokens.size();
+    bool failed = false;
+    double parse = timeIt([&] {
+        Parser p(std::move(tokens));
+        p.parse();
+        failed = p.hasError();
+    });
+
+    std::cout << "stream: " << text.size() / 1e6 << " MB, " << count << " tokens" 
+        << (pulled == count ? "" : " (MISMATCH with next())") 
+        << (failed ? " (PARSE ERRORS)" : "") << std::endl;
+    std::cout << "stream: next() loop " << viaNext * 1e3 << " ms, tokenizeAll " 
+        << viaStream * 1e3 << " ms, line table " << lines * 1e3 << " ms, parse " 
+        << parse * 1e3 << " ms" << std::endl;
+}
+
+// AST =======================================================================
+
+static void benchAst() {
+    std::string text = programCorpus(32 << 20);
+    Scanner s{std::string_view(text)};
+    TokenStream tokens = s.tokenizeAll();
+
+    std::unique_ptr<Parser> parser(new Parser(std::move(tokens)));
+    double parse = timeIt([&] { parser->parse(); });
+    bool failed = parser->hasError();
+    size_t nodes = parser->unit().nodes();
+
+    parser->unit().printMemoryReport();
+    double release = timeIt([&] { parser.reset(); });
+
+    std::cout << "ast: " << nodes << " nodes" << (failed ? " (PARSE ERRORS)" : "")
+        << ", parse " << parse * 1e3 << " ms, release " << release * 1e3 << " ms" << std::endl;
+}
+
+// TYPE CHECKING ==============================================================
+
+static void benchTypes() {
+    std::string text = programCorpus(32 << 20);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+
+    TypeChecker checker(parser.unit());
+    size_t before = allocations;
+    double check = timeIt([&] { checker.check(); });
+    size_t allocated = allocations - before;
+
+    std::cout << "types: checked " << parser.unit().nodes() << " nodes in " << check * 1e3 << " ms ("
+        << parser.unit().nodes() / check / 1e6 << "M nodes/s), " << allocated << " heap allocations, "
+        << parser.unit().types().size() << " types" 
+        << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+}
+
+// IR GENERATION ==============================================================
+
+static void benchIr() {
+    std::string text = programCorpus(32 << 20);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+
+    Module module;
+    IRGen gen(parser.unit());
+    size_t before = allocations;
+    double lower = timeIt([&] { module = gen.generate(); });
+    size_t allocated = allocations - before;
+
+    size_t instrs = module.instructionCount();
+    size_t vregs = 0;
+    for (const Function& f : module.functions) {
+        vregs += f.vregCount();
+    }
+
+    std::cout << "ir: " << parser.unit().nodes() << " nodes to " << instrs << " instructions, "
+        << module.blockCount() << " blocks, " << vregs << " vregs in " << lower * 1e3 << " ms ("
+        << instrs / lower / 1e6 << "M instructions/s), " << instrs * sizeof(Instr) / double(1 << 20)
+        << " MB of code, " << double(allocated) / module.functions.size() << " allocations per function"
+        << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+}
+
+// CFG AND SSA ================================================================
+
+// One main() with the given number of rounds of branches and loops over a few
+// variables, about 17 blocks per round
+static std::string hugeMain(int rounds) {
+    std::string out = "main() : void {\n    int a, b, c, i;\n    float x;\n    bool done;\n";
+    for (int k = 0; k < rounds; k++) {
+        std::string n = std::to_string(k % 97);
+        out += "    if (a > " + n + ") { a = a - b; } else { b = b + " + n + "; }\n"
+            "    while (b < " + n + ") { b += 3; c = c + b; }\n"
+            "    for (i = 0; i < 4; i++) { c = c * 2 - a; if (c > 1000) { c -= 1000; } }\n"
+            "    repeat { a += 1; x = x * 1.5; } until (a > " + n + ");\n"
+            "    do { c -= 1; done = (c < a) || done; } while ((c > " + n + ") && !done);\n";
+    }
+    return out + "}\n";
+}
+
+// Dominator sets by iterating dom(b) = {b} + intersection of dom(p) over
+// predecessors p, one bitset per block, for checking the CFG's answers
+static bool sameDominators(const CFG& cfg) {
+    size_t n = cfg.size();
+    size_t words = (n + 63) / 64;
+    std::vector<uint64_t> dom(n * words, ~uint64_t(0));
+    std::fill(dom.begin(), dom.begin() + words, 0);
+    dom[0] |= 1;
+
+    std::vector<uint64_t> meet(words);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < cfg.rpo().size(); i++) {
+            int32_t b = cfg.rpo()[i];
+            std::fill(meet.begin(), meet.end(), ~uint64_t(0));
+            for (int32_t p : cfg.predecessors(b)) {
+                if (cfg.reachable(p)) {
+                    for (size_t w = 0; w < words; w++) {
+                        meet[w] &= dom[p * words + w];
+                    }
+                }
+            }
+            meet[b / 64] |= uint64_t(1) << (b % 64);
+            if (!std::equal(meet.begin(), meet.end(), dom.begin() + b * words)) {
+                std::copy(meet.begin(), meet.end(), dom.begin() + b * words);
+                changed = true;
+            }
+        }
+    }
+
+    for (int32_t b : cfg.rpo()) {
+        for (int32_t a : cfg.rpo()) {
+            bool inSet = dom[b * words + a / 64] >> (a % 64) & 1;
+            if (inSet != cfg.dominates(a, b)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void benchSsa() {
+    std::string text = hugeMain(1000);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+    Module module = IRGen(parser.unit()).generate();
+    Function& f = module.functions[module.main];
+
+    CFG cfg;
+    double graph = timeIt([&] { cfg.build(f); });
+    size_t edges = 0;
+    for (size_t b = 0; b < cfg.size(); b++) {
+        edges += cfg.successors(b).size();
+    }
+    bool checked = sameDominators(cfg);
+
+    SSABuilder ssa;
+    size_t phis = 0;
+    size_t instrs = f.code.size();
+    double convert = timeIt([&] { phis = ssa.build(f); });
+
+    // Every vreg must now be written at most once
+    std::vector<uint8_t> written(f.vregCount());
+    bool single = true;
+    for (const Instr& in : f.code) {
+        if (in.definesDst()) {
+            single = single && !written[in.dst];
+            written[in.dst] = 1;
+        }
+    }
+
+    std::cout << "ssa: main with " << cfg.size() << " blocks, " << edges << " edges, "
+        << cfg.loopHeaders().size() << " loops, " << instrs << " instructions" 
+        << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+    std::cout << "ssa: CFG, dominators and frontiers " << graph * 1e3 << " ms"
+        << (checked ? " (match bitset dominators)" : " (DIFFER FROM BITSET DOMINATORS)") << std::endl;
+    std::cout << "ssa: conversion " << convert * 1e3 << " ms, " << phis << " phis, "
+        << f.vregCount() << " vregs" << (single ? "" : " (NOT SINGLE ASSIGNMENT)") << std::endl;
+
+    // The same on the many small functions of the program corpus
+    std::string corpus = programCorpus(8 << 20);
+    Scanner cs{std::string_view(corpus)};
+    Parser corpusParser(cs.tokenizeAll());
+    corpusParser.parse();
+    TypeChecker corpusChecker(corpusParser.unit());
+    corpusChecker.check();
+    Module small = IRGen(corpusParser.unit()).generate();
+
+    phis = 0;
+    size_t before = allocations;
+    convert = timeIt([&] {
+        for (Function& g : small.functions) {
+            phis += ssa.build(g);
+        }
+    });
+    std::cout << "ssa: " << small.functions.size() << " corpus functions (" << small.blockCount() 
+        << " blocks) in " << convert * 1e3 << " ms, " << phis << " phis, " 
+        << double(allocations - before) / small.functions.size() << " allocations per function" << std::endl;
+}
+
+// OPTIMIZER ================================================================
+
+// Functions full of literal arithmetic and branches on flags that are always
+// false, the way expressions like i-3-3*5/2+8 show up in real DeCo code
+static std::string constantCorpus(size_t bytes) {
+    std::string out = "int g0;\n\n";
+    int n = 0;
+    while (out.size() < bytes) {
+        std::string f = "k" + std::to_string(n++);
+        out += "function " + f + "(int a): int {\n"
+            "    int k, s, i;\n"
+            "    bool debug;\n"
+            "    float r;\n"
+            "    k = 7;\n"
+            "    debug = k > 9;\n"
+            "    s = k - 3 - 3 * 5 / 2 + 8;\n"
+            "    r = 2.0 ^ 10.0 / 4.0 - 1.5;\n"
+            "    if (debug) {\n"
+            "        g0 = s * a;\n"
+            "    }\n"
+            "    while (debug && (a > s)) {\n"
+            "        a -= k % 4;\n"
+            "    }\n"
+            "    for (i = 0; i < 8; i++) {\n"
+            "        s = s + (k * 4 % 3) ^ 2 + a / (k - 7);\n"
+            "        if ((r > 100.0) || debug) {\n"
+            "            s += 1;\n"
+            "        }\n"
+            "    }\n"
+            "    return s + k % 0;\n"
+            "}\n\n";
+    }
+
+    out += "main() : void {\n";
+    for (int i = 0; i < n; i++) {
+        out += "    g0 = call k" + std::to_string(i) + "(g0);\n";
+    }
+    return out + "}\n";
+}
+
+// One main() computing a single value through a chain of n dependent
+// statements, with a dead statement after each
+static std::string chainMain(int n) {
+    std::string out = "int g0;\n\nmain() : void {\n    int a, b, unused;\n    b = g0;\n";
+    for (int k = 0; k < n; k++) {
+        out += "    a = a + b * " + std::to_string(k % 13) + ";\n    unused = a - " + std::to_string(k) + ";\n";
+    }
+    return out + "    g0 = a;\n}\n";
+}
+
+static void benchOptimizer() {
+    struct Input {
+        const char* name;
+        std::string text;
+    };
+    Input inputs[] = {
+        {"constant-heavy", constantCorpus(8 << 20)},
+        {"program corpus", programCorpus(8 << 20)},
+        {"branchy main", hugeMain(1000)},
+        {"300k-statement chain", chainMain(300000)},
+    };
+
+    for (const Input& input : inputs) {
+        Scanner s{std::string_view(input.text)};
+        Parser parser(s.tokenizeAll());
+        parser.parse();
+        TypeChecker checker(parser.unit());
+        checker.check();
+        Module module = IRGen(parser.unit()).generate();
+
+        UnreachableBlockElimination unreachable;
+        Inliner inliner;
+        SSABuilder ssa;
+        ConstantPropagation sccp;
+        ValueNumbering gvn;
+        LoopOptimization loops;
+        DeadCodeElimination dce;
+        PassManager passes;
+        passes.add(unreachable);
+        passes.add(inliner);
+        passes.add(ssa);
+        passes.add(sccp);
+        passes.add(gvn);
+        passes.add(loops);
+        passes.add(gvn);
+        passes.add(dce);
+        passes.run(module);
+
+        std::cout << "opt: " << input.name << ", " << module.functions.size() << " functions"
+            << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+        passes.printReport();
+    }
+}
+
+// VALUE NUMBERING ==========================================================
+
+// Matrix and stencil kernels that name the same elements several times in
+// their loop bodies
+static std::string arrayCorpus(size_t bytes) {
+    std::string out = "int[16][16] ga, gb, gc;\n\n";
+    int n = 0;
+    while (out.size() < bytes) {
+        std::string k = std::to_string(n++);
+        out += "function mul" + k + "(int[][] a, int[][] b, int[][] c, int n): void {\n"
+            "    int i, j, k;\n"
+            "    for (i = 0; i < n; i++) {\n"
+            "        for (j = 0; j < n; j++) {\n"
+            "            c[i][j] = 0;\n"
+            "            for (k = 0; k < n; k++) {\n"
+            "                c[i][j] = c[i][j] + a[i][k] * b[k][j];\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "}\n\n"
+            "function smooth" + k + "(int[][] a, int[][] out, int n): void {\n"
+            "    int i, j;\n"
+            "    for (i = 1; i < n - 1; i++) {\n"
+            "        for (j = 1; j < n - 1; j++) {\n"
+            "            out[i][j] = (a[i - 1][j] + a[i + 1][j] + a[i][j - 1] + a[i][j + 1] + 4 * a[i][j]) / 8;\n"
+            "            if (out[i][j] > a[i][j]) {\n"
+            "                out[i][j] = a[i][j] + (out[i][j] - a[i][j]) / 2;\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "}\n\n"
+            "function swap" + k + "(int[][] a, int n): void {\n"
+            "    int i, j, t;\n"
+            "    for (i = 0; i < n; i++) {\n"
+            "        for (j = i + 1; j < n; j++) {\n"
+            "            t = a[i][j];\n"
+            "            a[i][j] = a[j][i];\n"
+            "            a[j][i] = t;\n"
+            "        }\n"
+            "    }\n"
+            "}\n\n";
+    }
+
+    out += "main() : void {\n";
+    for (int i = 0; i < n; i++) {
+        std::string k = std::to_string(i);
+        out += "    call mul" + k + "(ga, gb, gc, 16);\n    call smooth" + k + "(gc, ga, 16);\n"
+            "    call swap" + k + "(gb, 16);\n";
+    }
+    return out + "}\n";
+}
+
+// The kernels above, run on data, with a checksum in global 0
+static const char* gvnKernel =
+    "int checksum;\n"
+    "int[32][32] a, b, c, d;\n\n"
+    "function mul(int[][] a, int[][] b, int[][] c, int n): void {\n"
+    "    int i, j, k;\n"
+    "    for (i = 0; i < n; i++) {\n"
+    "        for (j = 0; j < n; j++) {\n"
+    "            c[i][j] = 0;\n"
+    "            for (k = 0; k < n; k++) {\n"
+    "                c[i][j] = c[i][j] + a[i][k] * b[k][j];\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "}\n\n"
+    "function smooth(int[][] a, int[][] out, int n): void {\n"
+    "    int i, j;\n"
+    "    for (i = 1; i < n - 1; i++) {\n"
+    "        for (j = 1; j < n - 1; j++) {\n"
+    "            out[i][j] = (a[i - 1][j] + a[i + 1][j] + a[i][j - 1] + a[i][j + 1] + 4 * a[i][j]) / 8;\n"
+    "            if (out[i][j] > a[i][j]) {\n"
+    "                out[i][j] = a[i][j] + (out[i][j] - a[i][j]) / 2;\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "}\n\n"
+    "function swap(int[][] a, int n): void {\n"
+    "    int i, j, t;\n"
+    "    for (i = 0; i < n; i++) {\n"
+    "        for (j = i + 1; j < n; j++) {\n"
+    "            t = a[i][j];\n"
+    "            a[i][j] = a[j][i];\n"
+    "            a[j][i] = t;\n"
+    "        }\n"
+    "    }\n"
+    "}\n\n"
+    "main() : void {\n"
+    "    int i, j, r;\n"
+    "    for (i = 0; i < 32; i++) {\n"
+    "        for (j = 0; j < 32; j++) {\n"
+    "            a[i][j] = (i * 7 + j * 3) % 10;\n"
+    "            b[i][j] = (i + 2 * j) % 5;\n"
+    "        }\n"
+    "    }\n"
+    "    for (r = 0; r < 30; r++) {\n"
+    "        call mul(a, b, c, 32);\n"
+    "        call smooth(c, d, 32);\n"
+    "        call swap(b, 32);\n"
+    "        checksum = checksum + c[r][31 - r] + d[r + 1][30 - r];\n"
+    "    }\n"
+    "}\n";
+
+static const int64_t gvnKernelChecksum = 17211;
+
+static void benchGvn() {
+    std::string text = arrayCorpus(4 << 20);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+    Module base = IRGen(parser.unit()).generate();
+
+    UnreachableBlockElimination unreachable;
+    SSABuilder ssa;
+    ConstantPropagation sccp;
+    DeadCodeElimination dce;
+    ValueNumbering gvn;
+
+    // The same pipeline with and without value numbering
+    Module without = base;
+    PassManager plain;
+    plain.add(unreachable);
+    plain.add(ssa);
+    plain.add(sccp);
+    plain.add(dce);
+    plain.run(without);
+
+    Module with = base;
+    PassManager numbered;
+    numbered.add(unreachable);
+    numbered.add(ssa);
+    numbered.add(sccp);
+    numbered.add(gvn);
+    numbered.add(dce);
+    numbered.run(with);
+
+    size_t before = without.instructionCount();
+    size_t after = with.instructionCount();
+    std::cout << "gvn: array kernels, " << base.functions.size() << " functions"
+        << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+    numbered.printReport();
+    std::cout << "gvn: " << before << " instructions without value numbering, " << after << " with ("
+        << 100.0 * (before - after) / before << "% fewer)" << std::endl;
+
+    // What that is worth at run time, through the same two pipelines
+    Scanner ks{std::string_view(gvnKernel)};
+    Parser kernelParser(ks.tokenizeAll());
+    kernelParser.parse();
+    TypeChecker kernelChecker(kernelParser.unit());
+    kernelChecker.check();
+    Module kernel = IRGen(kernelParser.unit()).generate();
+
+    uint64_t executed[2];
+    double seconds[2];
+    for (int numbering = 0; numbering < 2; numbering++) {
+        Module module = kernel;
+        (numbering ? numbered : plain).run(module);
+        BytecodeGen codegen(module);
+        Program program = codegen.generate();
+        VM vm(program);
+        bool ok = true;
+        seconds[numbering] = timeIt([&] { ok = vm.run(); });
+        executed[numbering] = vm.executed();
+        sink = vm.global(0).i;
+
+        std::cout << "gvn: kernel in the VM " << (numbering ? "with" : "without") << " value numbering, "
+            << executed[numbering] / 1e6 << "M instructions in " << seconds[numbering] * 1e3 << " ms";
+        if (codegen.hasError() || !ok) {
+            std::cout << " (" << (ok ? "BYTECODE ERRORS" : vm.error()) << ")";
+        } else if (vm.global(0).i != gvnKernelChecksum) {
+            std::cout << " (wrong result " << vm.global(0).i << ")";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "gvn: " << 100.0 * (double(executed[0]) - executed[1]) / executed[0] << "% fewer instructions executed, "
+        << 100.0 * (seconds[0] - seconds[1]) / seconds[0] << "% less time" << std::endl;
+}
+
+// LOOPS ====================================================================
+
+static void benchLoops() {
+    std::string text = arrayCorpus(4 << 20);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+    Module module = IRGen(parser.unit()).generate();
+
+    UnreachableBlockElimination unreachable;
+    Inliner inliner;
+    SSABuilder ssa;
+    ConstantPropagation sccp;
+    ValueNumbering gvn;
+    LoopOptimization loops;
+    DeadCodeElimination dce;
+    PassManager passes;
+    passes.add(unreachable);
+    passes.add(inliner);
+    passes.add(ssa);
+    passes.add(sccp);
+    passes.add(gvn);
+    passes.add(loops);
+    passes.add(gvn);
+    passes.add(dce);
+    passes.run(module);
+
+    std::cout << "loops: array kernels, " << module.functions.size() << " functions"
+        << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+    passes.printReport();
+    std::cout << "loops: most improved:\n";
+    loops.printLoops(module, std::cout, 5);
+}
+
+// INLINING =================================================================
+
+// Loops over global arrays that go through small accessor functions, the
+// way generated code does, plus a recursive function the inliner must leave
+// as it is
+static std::string accessorCorpus(size_t bytes) {
+    std::string out = "int[64] data;\nint size;\n\n"
+        "function fib(int n): int {\n"
+        "    if (n < 2) {\n"
+        "        return n;\n"
+        "    }\n"
+        "    return call fib(n - 1) + call fib(n - 2);\n"
+        "}\n\n";
+    int n = 0;
+    while (out.size() < bytes) {
+        std::string k = std::to_string(n++);
+        out += "function width" + k + "(): int {\n"
+            "    return 6;\n"
+            "}\n\n"
+            "function get" + k + "(int i): int {\n"
+            "    return data[i];\n"
+            "}\n\n"
+            "function set" + k + "(int i, int v): void {\n"
+            "    data[i] = v;\n"
+            "}\n\n"
+            "function clamp" + k + "(int x, int lo, int hi): int {\n"
+            "    if (x < lo) {\n"
+            "        return lo;\n"
+            "    }\n"
+            "    if (x > hi) {\n"
+            "        return hi;\n"
+            "    }\n"
+            "    return x;\n"
+            "}\n\n"
+            "function blur" + k + "(): void {\n"
+            "    int i, v;\n"
+            "    for (i = 1; i < size - 1; i++) {\n"
+            "        v = call get" + k + "(i - 1) + call get" + k + "(i) * call width" + k + "() + call get" + k + "(i + 1);\n"
+            "        call set" + k + "(i, call clamp" + k + "(v / 8, 0, 255));\n"
+            "    }\n"
+            "    call set" + k + "(0, call fib(call width" + k + "()));\n"
+            "}\n\n";
+    }
+
+    out += "main() : void {\n    size = 64;\n";
+    for (int i = 0; i < n; i++) {
+        out += "    call blur" + std::to_string(i) + "();\n";
+    }
+    return out + "}\n";
+}
+
+static size_t callCount(const Module& module) {
+    size_t calls = 0;
+    for (const Function& f : module.functions) {
+        for (const Instr& in : f.code) {
+            calls += in.op == Instr::CALL;
+        }
+    }
+    return calls;
+}
+
+static void benchInline() {
+    std::string text = accessorCorpus(4 << 20);
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+    Module base = IRGen(parser.unit()).generate();
+    std::cout << "inline: accessor loops, " << base.functions.size() << " functions, " << callCount(base)
+        << " calls" << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << std::endl;
+
+    // The full pipeline at a few budgets, 0 only taking callees no bigger
+    // than the call itself
+    for (size_t budget : {size_t(0), size_t(10), size_t(40), size_t(200)}) {
+        Module module = base;
+        UnreachableBlockElimination unreachable;
+        Inliner inliner(budget);
+        SSABuilder ssa;
+        ConstantPropagation sccp;
+        ValueNumbering gvn;
+        LoopOptimization loops;
+        DeadCodeElimination dce;
+        PassManager passes;
+        passes.add(unreachable);
+        passes.add(inliner);
+        passes.add(ssa);
+        passes.add(sccp);
+        passes.add(gvn);
+        passes.add(loops);
+        passes.add(gvn);
+        passes.add(dce);
+        passes.run(module);
+
+        std::cout << "inline: budget " << budget << ": " << module.instructionCount() << " instructions, "
+            << callCount(module) << " calls left (";
+        inliner.printCounters(std::cout);
+        std::cout << ")" << std::endl;
+        if (budget == 40) {
+            passes.printReport();
+        }
+    }
+}
+
+// REGISTER ALLOCATION ======================================================
+
+// One long loop body over 16 int and 4 float variables, calling a recursive
+// function the inliner keeps now and then, so plenty of values are live
+// across calls; statements sets how many vregs it comes to
+static std::string pressureMain(int statements) {
+    std::mt19937 rng(11);
+    std::string out = "int sink;\nfloat fsink;\n\n"
+        "function step(int x): int {\n"
+        "    if (x < 0) {\n"
+        "        return call step(x + 7);\n"
+        "    }\n"
+        "    return x % 7;\n"
+        "}\n\n"
+        "main() : void {\n"
+        "    int i, v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15;\n"
+        "    float x0, x1, x2, x3;\n"
+        "    for (i = 0; i < 100; i++) {\n";
+    auto v = [&]() { return "v" + std::to_string(rng() % 16); };
+    auto x = [&]() { return "x" + std::to_string(rng() % 4); };
+    static const char* ops[] = {" + ", " - ", " * "};
+    for (int k = 0; k < statements; k++) {
+        switch (rng() % 8) {
+            case 0:
+                out += "        " + v() + " = call step(" + v() + " + i);\n";
+                break;
+            case 1:
+                out += "        " + x() + " = " + x() + " * 0.5 + " + x() + ";\n";
+                break;
+            default:
+                out += "        " + v() + " = " + v() + ops[rng() % 3] + v() + ops[rng() % 3] + std::to_string(k) + ";\n";
+                break;
+        }
+    }
+    out += "    }\n    sink = v0";
+    for (int k = 1; k < 16; k++) {
+        out += " + v" + std::to_string(k);
+    }
+    return out + ";\n    fsink = x0 + x1 + x2 + x3;\n}\n";
+}
+
+static void benchRegalloc() {
+    // Shaped like x86-64 under System V: 12 general registers of which 5
+    // survive calls, and 14 SSE registers of which none do
+    RegisterAllocator allocator({12, 0x1F << 7}, {14, 0});
+
+    for (int statements : {220, 3400, 34000}) {
+        std::string text = pressureMain(statements);
+        Scanner s{std::string_view(text)};
+        Parser parser(s.tokenizeAll());
+        parser.parse();
+        TypeChecker checker(parser.unit());
+        checker.check();
+        Module module = IRGen(parser.unit()).generate();
+
+        UnreachableBlockElimination unreachable;
+        Inliner inliner;
+        SSABuilder ssa;
+        ConstantPropagation sccp;
+        ValueNumbering gvn;
+        LoopOptimization loops;
+        DeadCodeElimination dce;
+        PassManager passes;
+        passes.add(unreachable);
+        passes.add(inliner);
+        passes.add(ssa);
+        passes.add(sccp);
+        passes.add(gvn);
+        passes.add(loops);
+        passes.add(gvn);
+        passes.add(dce);
+        passes.run(module);
+
+        Function& f = module.functions[module.main];
+        const int rounds = 20;
+        double seconds = timeIt([&] {
+            for (int r = 0; r < rounds; r++) {
+                allocator.allocate(f);
+            }
+        }) / rounds;
+        sink = allocator.spillSlots();
+
+        size_t intervals = 0;
+        for (size_t v = 0; v < f.vregCount(); v++) {
+            intervals += allocator.hasInterval(v);
+        }
+        std::cout << "regalloc: " << f.vregCount() << " vregs, " << f.code.size() << " instructions"
+            << (parser.hasError() || checker.hasError() ? " (ERRORS)" : "") << ": " << seconds * 1e3 << " ms ("
+            << seconds * 1e9 / f.vregCount() << " ns/vreg), " << intervals << " intervals, "
+            << allocator.spillCount() << " spilled into " << allocator.spillSlots() << " slots" << std::endl;
+    }
+}
+
+// BYTECODE VM ================================================================
+
+// Loop kernels, each storing a checksum in a global
+static const char* matmulKernel =
+    "float sum;\n"
+    "float[48][48] a, b, c;\n\n"
+    "function mul(float[][] a, float[][] b, float[][] c, int n): void {\n"
+    "    int i, j, k;\n"
+    "    float s;\n"
+    "    for (i = 0; i < n; i++) {\n"
+    "        for (j = 0; j < n; j++) {\n"
+    "            s = 0.0;\n"
+    "            for (k = 0; k < n; k++) {\n"
+    "                s = s + a[i][k] * b[k][j];\n"
+    "            }\n"
+    "            c[i][j] = s;\n"
+    "        }\n"
+    "    }\n"
+    "}\n\n"
+    "main() : void {\n"
+    "    int i, j, r;\n"
+    "    float x;\n"
+    "    for (i = 0; i < 48; i++) {\n"
+    "        for (j = 0; j < 48; j++) {\n"
+    "            x = x + 0.25;\n"
+    "            a[i][j] = x;\n"
+    "            b[j][i] = 1.0 - x * 0.01;\n"
+    "        }\n"
+    "    }\n"
+    "    for (r = 0; r < 20; r++) {\n"
+    "        call mul(a, b, c, 48);\n"
+    "        sum = sum + c[r][47 - r];\n"
+    "    }\n"
+    "}\n";
+
+static const char* sieveKernel =
+    "int primes;\n\n"
+    "function sieve(int[] composite, int n): int {\n"
+    "    int i, j, count;\n"
+    "    i = 2;\n"
+    "    while (i < n) {\n"
+    "        composite[i] = 0;\n"
+    "        i = i + 1;\n"
+    "    }\n"
+    "    i = 2;\n"
+    "    while (i < n) {\n"
+    "        if (composite[i] == 0) {\n"
+    "            count = count + 1;\n"
+    "            j = i * i;\n"
+    "            while (j < n) {\n"
+    "                composite[j] = 1;\n"
+    "                j = j + i;\n"
+    "            }\n"
+    "        }\n"
+    "        i = i + 1;\n"
+    "    }\n"
+    "    return count;\n"
+    "}\n\n"
+    "main() : void {\n"
+    "    int[200000] composite;\n"
+    "    int r;\n"
+    "    for (r = 0; r < 10; r++) {\n"
+    "        primes = primes + call sieve(composite, 200000);\n"
+    "    }\n"
+    "}\n";
+
+static const char* fibKernel =
+    "int result;\n\n"
+    "function fib(int n): int {\n"
+    "    if (n < 2) {\n"
+    "        return n;\n"
+    "    }\n"
+    "    return call fib(n - 1) + call fib(n - 2);\n"
+    "}\n\n"
+    "main() : void {\n"
+    "    result = call fib(29);\n"
+    "}\n";
+
+// Compile a kernel, through the whole optimizer or only as far as SSA form
+static Module kernelModule(const char* text, bool optimize) {
+    Scanner s{std::string_view(text)};
+    Parser parser(s.tokenizeAll());
+    parser.parse();
+    TypeChecker checker(parser.unit());
+    checker.check();
+    if (parser.hasError() || checker.hasError()) {
+        std::cout << "vm: kernel has errors" << std::endl;
+    }
+    Module module = IRGen(parser.unit()).generate();
+
+    UnreachableBlockElimination unreachable;
+    Inliner inliner;
+    SSABuilder ssa;
+    ConstantPropagation sccp;
+    ValueNumbering gvn;
+    LoopOptimization loops;
+    DeadCodeElimination dce;
+    PassManager passes;
+    passes.add(unreachable);
+    if (optimize) {
+        passes.add(inliner);
+    }
+    passes.add(ssa);
+    if (optimize) {
+        passes.add(sccp);
+        passes.add(gvn);
+        passes.add(loops);
+        passes.add(gvn);
+        passes.add(dce);
+    }
+    passes.run(module);
+    return module;
+}
+
+static Program compileKernel(Module& module) {
+    BytecodeGen codegen(module);
+    Program program = codegen.generate();
+    if (codegen.hasError()) {
+        codegen.printErrorReport();
+    }
+    return program;
+}
+
+static void benchVm() {
+    struct Kernel {
+        const char* name;
+        const char* text;
+        int64_t expected;   // Bits of global 0 after a run
+    };
+    static const Kernel kernels[] = {
+        {"matmul", matmulKernel, -4533360629149545267},
+        {"sieve", sieveKernel, 179840},
+        {"fib", fibKernel, 514229},
+    };
+
+    for (const Kernel& k : kernels) {
+        for (bool optimize : {false, true}) {
+            Module module = kernelModule(k.text, optimize);
+            Program program = compileKernel(module);
+            std::cout << "vm: " << k.name << (optimize ? ", optimized: " : ", SSA only: ") << program.code.size()
+                << " words";
+            for (VM::Dispatch dispatch : {VM::SWITCH, VM::THREADED}) {
+                VM vm(program);
+                bool ok = true;
+                double seconds = timeIt([&] { ok = vm.run(dispatch); });
+                sink = vm.global(0).i;
+                std::cout << "; " << (dispatch == VM::THREADED ? "threaded " : "switch ") << seconds * 1e3 << " ms, "
+                    << vm.executed() / 1e6 << "M instructions (" << vm.executed() / seconds / 1e6 << "M/s)";
+                if (!ok) {
+                    std::cout << " (" << vm.error() << ")";
+                } else if (vm.global(0).i != k.expected) {
+                    std::cout << " (wrong result " << vm.global(0).i << ")";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+// JIT ========================================================================
+
+// Each kernel run as machine code from the start, and tiered, starting in
+// the VM and compiling a function on its second call. Latency is for main
+// and everything it calls, from the IR to code ready to run
+static void benchJit() {
+    struct Kernel {
+        const char* name;
+        const char* text;
+        int64_t expected;   // Bits of global 0 after a run
+    };
+    static const Kernel kernels[] = {
+        {"matmul", matmulKernel, -4533360629149545267},
+        {"sieve", sieveKernel, 179840},
+        {"fib", fibKernel, 514229},
+    };
+
+    for (const Kernel& k : kernels) {
+        for (bool optimize : {false, true}) {
+            Module module = kernelModule(k.text, optimize);
+            Program program = compileKernel(module);
+            std::cout << "jit: " << k.name << (optimize ? ", optimized: " : ", SSA only: ");
+
+            Jit jit(module);
+            if (!jit.compile(module.main)) {
+                std::cout << jit.error() << std::endl;
+                continue;
+            }
+            size_t bytes = 0;
+            double latency = 0;
+            for (const Jit::Stats& stats : jit.stats()) {
+                bytes += stats.bytes;
+                latency += stats.seconds;
+            }
+            double native = timeIt([&] { jit.run(); });
+            sink = jit.global(0).i;
+
+            VM vm(program);
+            double interpreted = timeIt([&] { vm.run(); });
+            sink = vm.global(0).i;
+
+            Jit tier(module);
+            VM tiered(program);
+            tiered.setJit(&tier, 2);
+            double mixed = timeIt([&] { tiered.run(); });
+            sink = tiered.global(0).i;
+
+            std::cout << bytes << " bytes compiled in " << latency * 1e6 << " us; native " << native * 1e3
+                << " ms, VM " << interpreted * 1e3 << " ms, tiered " << mixed * 1e3 << " ms ("
+                << tier.stats().size() << " functions compiled)";
+            if (jit.global(0).i != k.expected) {
+                std::cout << " (native result " << jit.global(0).i << " is wrong)";
+            }
+            if (vm.global(0).i != k.expected) {
+                std::cout << " (VM result " << vm.global(0).i << " is wrong)";
+            }
+            if (tiered.global(0).i != k.expected) {
+                std::cout << " (tiered result " << tiered.global(0).i << " is wrong)";
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+// SYMBOL TABLE ===============================================================
+
+// The usual alternative: one hash map per open scope, searched innermost first
+struct MapScopes {
+    std::vector<std::unordered_map<std::string, int>> scopes{1};
+    int next = 0;
+
+    void enter() { scopes.emplace_back(); }
+    void exit() { scopes.pop_back(); }
+    bool declare(std::string_view name) { return scopes.back().emplace(std::string(name), next++).second; }
+    int lookup(std::string_view name) const {
+        std::string key(name);
+        for (size_t i = scopes.size(); i-- > 0;) {
+            auto it = scopes[i].find(key);
+            if (it != scopes[i].end()) {
+                return it->second;
+            }
+        }
+        return -1;
+    }
+};
+
+// Open depth nested scopes, declaring perScope names in each and looking up
+// lookups names visible from that level, then close them all
+template <typename Declare, typename Lookup, typename Enter, typename Exit>
+static size_t nestedWorkload(const std::vector<std::string>& names, int depth, int perScope, 
+        int lookups, Declare declare, Lookup lookup, Enter enter, Exit exit) {
+    size_t found = 0;
+    std::mt19937 rng(3);
+    for (int d = 0; d < depth; d++) {
+        enter();
+        for (int i = 0; i < perScope; i++) {
+            declare(names[d * perScope + i]);
+        }
+        for (int i = 0; i < lookups; i++) {
+            found += lookup(names[rng() % ((d + 1) * perScope)]) >= 0;
+        }
+    }
+    for (int d = 0; d < depth; d++) {
+        exit();
+    }
+    return found;
+}
+
+static void benchSymbols() {
+    const int globals = 10000, lookups = 2000000;
+    std::vector<std::string> names;
+    for (int i = 0; i < globals; i++) {
+        names.push_back("name_" + std::to_string(i));
+    }
+
+    // Thousands of globals, looked up from a few scopes down
+    std::mt19937 rng(1);
+    std::vector<int> order(lookups);
+    for (int& i : order) {
+        i = rng() % globals;
+    }
+
+    SymbolTable table;
+    MapScopes maps;
+    size_t found = 0;
+    double tableInsert = timeIt([&] {
+        for (const std::string& n : names) {
+            table.declare(table.intern(n), Symbol::VARIABLE, nullptr);
+        }
+    });
+    double mapInsert = timeIt([&] {
+        for (const std::string& n : names) {
+            maps.declare(n);
+        }
+    });
+    for (int i = 0; i < 4; i++) {
+        table.enterScope();
+        maps.enter();
+    }
+    double tableLookup = timeIt([&] {
+        for (int i : order) {
+            found += table.lookup(table.intern(names[i])) >= 0;
+        }
+    });
+    double mapLookup = timeIt([&] {
+        for (int i : order) {
+            found += maps.lookup(names[i]) >= 0;
+        }
+    });
+    sink = found;
+
+    std::cout << "symbols: " << globals << " globals, insert " << tableInsert * 1e3 << " ms (maps "
+        << mapInsert * 1e3 << " ms), " << lookups / 1e6 << "M lookups 4 scopes down " 
+        << tableLookup * 1e3 << " ms (maps " << mapLookup * 1e3 << " ms)" << std::endl;
+
+    // Deep nesting, with lookups from every level
+    const int depth = 1000, perScope = 4, perLevel = 200;
+    std::vector<std::string> nested;
+    for (int i = 0; i < depth * perScope; i++) {
+        nested.push_back("v" + std::to_string(i));
+    }
+
+    SymbolTable deep;
+    MapScopes deepMaps;
+    double tableDeep = timeIt([&] {
+        found = nestedWorkload(nested, depth, perScope, perLevel,
+            [&](const std::string& n) { deep.declare(deep.intern(n), Symbol::VARIABLE, nullptr); },
+            [&](const std::string& n) { return deep.lookup(deep.intern(n)); },
+            [&] { deep.enterScope(); }, [&] { deep.exitScope(); });
+    });
+    double mapDeep = timeIt([&] {
+        found += nestedWorkload(nested, depth, perScope, perLevel,
+            [&](const std::string& n) { deepMaps.declare(n); },
+            [&](const std::string& n) { return deepMaps.lookup(n); },
+            [&] { deepMaps.enter(); }, [&] { deepMaps.exit(); });
+    });
+    sink = found;
+
+    std::cout << "symbols: " << depth << " nested scopes, " << depth * perLevel / 1e3 
+        << "k lookups " << tableDeep * 1e3 << " ms (maps " << mapDeep * 1e3 << " ms)" << std::endl;
+
+    // The same through the parser
+    std::string program;
+    for (int i = 0; i < globals; i++) {
+        program += "int " + names[i] + ";\n";
+    }
+    program += "main() : void {\n";
+    for (int i = 0; i < depth; i++) {
+        program += "if (true) { int " + nested[i] + ";\n" + names[i % globals] + " = " + nested[i] + " + " 
+            + names[(i * 7) % globals] + ";\n";
+    }
+    program += std::string(depth, '}') + "\n}\n";
+
+    Scanner sc{std::string_view(program)};
+    Parser parser(sc.tokenizeAll());
+    double parse = timeIt([&] { parser.parse(); });
+    std::cout << "symbols: parsed " << globals << " globals and " << depth << " nested blocks in " 
+        << parse * 1e3 << " ms, " << parser.unit().symbols().size() << " symbols" 
+        << (parser.hasError() ? " (ERRORS)" : "") << std::endl;
+}
+
+// ERROR RECOVERY =============================================================
+
+// programCorpus() with one typo in roughly every everyLines lines
+static std::string brokenCorpus(size_t bytes, int everyLines) {
+    std::string text = programCorpus(bytes);
+    std::mt19937 rng(7);
+    std::string out;
+    out.reserve(text.size() + text.size() / everyLines);
+
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd;
+
+        if (rng() % everyLines == 0) {
+            size_t at;
+            switch (rng() % 4) {
+                case 0:     // Missing semicolon
+                    if ((at = line.rfind(';')) != std::string::npos) line.erase(at, 1);
+                    break;
+                case 1:     // Missing close paren
+                    if ((at = line.rfind(')')) != std::string::npos) line.erase(at, 1);
+                    break;
+                case 2:     // Stray character
+                    line.insert(line.size() / 2, " $ ");
+                    break;
+                case 3:     // Doubled operand
+                    if ((at = line.find('=')) != std::string::npos) line.insert(at + 1, " 1 1");
+                    break;
+            }
+        }
+        out += line;
+    }
+    return out;
+}
+
+static void benchErrors() {
+    std::string clean = programCorpus(8 << 20);
+    std::string broken = brokenCorpus(8 << 20, 20);
+
+    for (const std::string* text : {&clean, &broken}) {
+        Scanner s{std::string_view(*text)};
+        Parser p(s.tokenizeAll(), SIZE_MAX);
+        double parse = timeIt([&] { p.parse(); });
+        size_t errors = p.errorCount();
+
+        std::cout << "errors: " << (text == &clean ? "clean " : "broken") << " "
+            << text->size() / 1e6 << " MB, " << errors << " errors, parse " << parse * 1e3
+            << " ms (" << text->size() / parse / 1e6 << " MB/s)" << std::endl;
+
+        // Stopping at the first error takes one compile per error, each
+        // parsing half of the file on average
+        if (errors > 0) {
+            std::cout << "errors: " << errors / parse << " errors/s in one pass, vs ~"
+                << errors * parse / 2 << " s of compiles stopping at the first error" << std::endl;
+        }
+    }
+}
+
+// PARALLEL LEXING ============================================================
+
+static bool sameTokens(const TokenStream& a, const TokenStream& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a.kind(i) != b.kind(i) || a.offset(i) != b.offset(i) || a.lexeme(i) != b.lexeme(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void benchParallel() {
+    std::string text = programCorpus(64 << 20);
+
+    TokenStream serial(nullptr);
+    double base = timeIt([&] {
+        Scanner s{std::string_view(text)};
+        serial = s.tokenizeAll();
+    });
+    std::cout << "parallel: " << text.size() / 1e6 << " MB, " << serial.size()
+        << " tokens, hardware threads " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "parallel: tokenizeAll " << base * 1e3 << " ms" << std::endl;
+
+    for (unsigned threads : {2u, 4u, 8u}) {
+        TokenStream tokens(nullptr);
+        double t = timeIt([&] {
+            Scanner s{std::string_view(text)};
+            tokens = s.tokenizeParallel(threads);
+        });
+        std::cout << "parallel: " << threads << " threads " << t * 1e3 << " ms ("
+            << base / t << "x)" << (sameTokens(serial, tokens) ? "" : " (MISMATCH)") << std::endl;
+    }
+}
+
+// DRIVER =====================================================================
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"keywords", benchKeywords},
+    {"kernels", benchKernels},
+    {"charclass", benchCharClass},
+    {"stream", benchStream},
+    {"ast", benchAst},
+    {"errors", benchErrors},
+    {"symbols", benchSymbols},
+    {"types", benchTypes},
+    {"ir", benchIr},
+    {"ssa", benchSsa},
+    {"opt", benchOptimizer},
+    {"gvn", benchGvn},
+    {"loops", benchLoops},
+    {"inline", benchInline},
+    {"regalloc", benchRegalloc},
+    {"vm", benchVm},
+    {"jit", benchJit},
+    {"parallel", benchParallel},
+};
+
+// Run every benchmark, or only those named on the command line
+int main(int argc, char** argv) {
+    for (const Benchmark& b : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || strcmp(argv[i], b.name) == 0;
+        }
+        if (selected) {
+            b.run();
+        }
+    }
+}
@@ -1,11 +1,19 @@
 #include <iostream>
 #include "../Scanner.h"
 #include "../Parser.h"
+#include "../TypeChecker.h"
+#include "../BytecodeGen.h"
+#include "../DeadCode.h"
+#include "../GVN.h"
+#include "../IRGen.h"
+#include "../Inliner.h"
+#include "../Loops.h"
+#include "../SCCP.h"
+#include "../SSA.h"
+#include "../VM.h"
 
 int main() {
-    FILE* fp;
-    fp = fopen("test-files/parse-test.txt", "r");
-    Scanner scanner(fp);
+    Scanner scanner("test-files/parse-test.txt");
 
     // while (scanner.hasNext()) {
     //     std::cout << scanner.next() << std::endl;
@@ -18,5 +26,57 @@ int main() {
 
     if (parser.hasError()) {
         parser.printErrorReport();
+        return 1;
     }
+
+    TypeChecker checker(parser.unit());
+    checker.check();
+
+    if (checker.hasError()) {
+        checker.printErrorReport();
+        return 1;
+    }
+
+    // parser.unit().printTree();
+    // parser.unit().printMemoryReport();
+
+    Module module = IRGen(parser.unit()).generate();
+
+    UnreachableBlockElimination unreachable;
+    Inliner inliner;
+    SSABuilder ssa;
+    ConstantPropagation sccp;
+    ValueNumbering gvn;
+    LoopOptimization loops;
+    DeadCodeElimination dce;
+    PassManager passes;
+    passes.add(unreachable);
+    passes.add(inliner);
+    passes.add(ssa);
+    passes.add(sccp);
+    passes.add(gvn);
+    passes.add(loops);
+    passes.add(gvn);
+    passes.add(dce);
+    passes.run(module);
+
+    // module.print();
+    // passes.printReport();
+
+    BytecodeGen codegen(module);
+    Program program = codegen.generate();
+
+    if (codegen.hasError()) {
+        codegen.printErrorReport();
+        return 1;
+    }
+
+    // program.print();
+
+    // parse-test.txt never finishes; point the scanner at a program that does
+    // VM vm(program);
+    // if (!vm.run()) {
+    //     std::cout << "VM ERROR: " << vm.error() << std::endl;
+    //     return 1;
+    // }
 }
\ No newline at end of file
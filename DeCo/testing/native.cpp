@@ -0,0 +1,141 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../BytecodeGen.h"
+#include "../DeadCode.h"
+#include "../GVN.h"
+#include "../IRGen.h"
+#include "../Inliner.h"
+#include "../Jit.h"
+#include "../Loops.h"
+#include "../Parser.h"
+#include "../SCCP.h"
+#include "../SSA.h"
+#include "../Scanner.h"
+#include "../TypeChecker.h"
+#include "../VM.h"
+#include "../X86Gen.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Compile one program to native code with gcc, and in memory with the JIT,
+// run both, and check that they leave the same globals as the bytecode VM.
+// Without optimize the program only goes as far as SSA form, so dead values
+// and PHIs are still there for the backends to handle
+static bool check(const char* path, bool optimize) {
+    Scanner scanner(path);
+    Parser parser(scanner);
+    parser.parse();
+    if (parser.hasError()) {
+        parser.printErrorReport();
+        return false;
+    }
+    TypeChecker checker(parser.unit());
+    checker.check();
+    if (checker.hasError()) {
+        checker.printErrorReport();
+        return false;
+    }
+    Module module = IRGen(parser.unit()).generate();
+
+    UnreachableBlockElimination unreachable;
+    Inliner inliner;
+    SSABuilder ssa;
+    ConstantPropagation sccp;
+    ValueNumbering gvn;
+    LoopOptimization loops;
+    DeadCodeElimination dce;
+    PassManager passes;
+    passes.add(unreachable);
+    if (optimize) {
+        passes.add(inliner);
+    }
+    passes.add(ssa);
+    if (optimize) {
+        passes.add(sccp);
+        passes.add(gvn);
+        passes.add(loops);
+        passes.add(gvn);
+        passes.add(dce);
+    }
+    passes.run(module);
+    std::string name = std::string(path) + (optimize ? ", optimized" : ", SSA only");
+
+    BytecodeGen codegen(module);
+    Program program = codegen.generate();
+    if (codegen.hasError()) {
+        codegen.printErrorReport();
+        return false;
+    }
+    VM vm(program);
+    Clock::time_point start = Clock::now();
+    if (!vm.run()) {
+        std::cout << name << ": VM ERROR: " << vm.error() << std::endl;
+        return false;
+    }
+    double vmSeconds = since(start);
+
+    {
+        std::ofstream out("native-out.s");
+        X86Gen(module).generate(out);
+    }
+    if (std::system("gcc -o native-out native-out.s -lm") != 0) {
+        std::cout << name << ": native-out.s did not assemble and link" << std::endl;
+        return false;
+    }
+
+    // The program writes its globals to stdout when main returns
+    start = Clock::now();
+    FILE* run = popen("./native-out", "r");
+    std::vector<int64_t> globals(module.globalSlots);
+    size_t got = run ? fread(globals.data(), sizeof(int64_t), globals.size(), run) : 0;
+    int status = run ? pclose(run) : -1;
+    double nativeSeconds = since(start);
+    if (status != 0 || got != globals.size()) {
+        std::cout << name << ": native-out failed, status " << status << ", " << got << " of "
+            << globals.size() << " globals" << std::endl;
+        return false;
+    }
+
+    Jit jit(module);
+    if (!jit.compile(module.main)) {
+        std::cout << name << ": JIT ERROR: " << jit.error() << std::endl;
+        return false;
+    }
+    start = Clock::now();
+    jit.run();
+    double jitSeconds = since(start);
+
+    size_t mismatches = 0;
+    for (uint32_t g = 0; g < module.globalSlots; g++) {
+        if (globals[g] != vm.global(g).i || jit.global(g).i != vm.global(g).i) {
+            if (mismatches++ < 10) {
+                std::cout << name << ": global slot " << g << " is " << globals[g] << " native, "
+                    << jit.global(g).i << " in the JIT, " << vm.global(g).i << " in the VM" << std::endl;
+            }
+        }
+    }
+    jit.printReport();
+    std::cout << name << ": " << module.globalSlots - mismatches << " of " << module.globalSlots
+        << " global slots match (VM " << vmSeconds * 1e3 << " ms, native " << nativeSeconds * 1e3
+        << " ms with process start, JIT " << jitSeconds * 1e3 << " ms)" << std::endl;
+    return mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok = check(argv[i], false) && ok;
+        ok = check(argv[i], true) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,19 +1,27 @@
 #include <stdio.h>
+#include <stdexcept>
 #include "Parser.h"
 #include "Scanner.h"
+#include "Semantics.h"
 
 token current_token;
-extern char token_buffer[];
-extern int curr_buffer_idx;
+
+// The token next_token() scanned to look at, until match() takes it. Its
+// lexeme is still in token_buffer then, since nothing is scanned in between
+static bool peeked = false;
+static token peeked_token;
 
 void Parser::system_goal() {
     /* <system goal> ::= <program> SCANEOF */
+    peeked = false;
     program();
     match(token::SCANEOF);
+    Semantics::finish();
 }
 
 void Parser::program() {
     /* <program> ::= BEGIN <statement list> END */
+    Semantics::start();
     match(token::BEGIN);
     statement_list();
     match(token::END);
@@ -37,13 +45,15 @@ void Parser::statement_list() {
 
 void Parser::statement() {
     token next = next_token();
+    expr_rec target, source;
 
     switch (next) {
         case token::ID:
-            /* <statement> ::= ID := <expression>; */
-            match(token::ID);
+            /* <statement> ::= ID := <expression>; #assign($1, $3) */
+            ident(target);
             match(token::ASSIGNOP);
-            expression();
+            expression(source);
+            Semantics::assign(target, source);
             match(token::SEMICOLON);
             break;
         case token::READ:
@@ -69,120 +79,118 @@ void Parser::statement() {
 }
 
 void Parser::id_list() {
-    /* <id list> ::= ID {, ID} */
-    match(token::ID);
+    /* <id list> ::= ID #read_id {, ID #read_id} */
+    expr_rec id;
+    ident(id);
+    Semantics::read_id(id);
     while (next_token() == token::COMMA) {
         match(token::COMMA);
-        match(token::ID);
+        ident(id);
+        Semantics::read_id(id);
     }
 }
 
 void Parser::expr_list() {
-    /* <expr list> ::= <expression> {, <expression>} */
-    expression();
+    /* <expr list> ::= <expression> #write_expr {, <expression> #write_expr} */
+    expr_rec e;
+    expression(e);
+    Semantics::write_expr(e);
     while (next_token() == token::COMMA) {
         match(token::COMMA);
-        expression();
+        expression(e);
+        Semantics::write_expr(e);
     }
 }
 
-void Parser::expression() {
-    /* <expression> ::= <primary> {<add op> <primary>} */
-    primary();
+void Parser::expression(expr_rec& result) {
+    /* <expression> ::= <primary> {<add op> <primary> #gen_infix} */
+    expr_rec left_operand, right_operand;
+    op_rec op;
+
+    primary(left_operand);
     while (true) {
         switch(next_token()) {
             case token::PLUSOP:
             case token::MINUSOP:
-                add_op();
-                primary();
+                add_op(op);
+                primary(right_operand);
+                left_operand = Semantics::gen_infix(left_operand, op, right_operand);
+                break;
             default:
+                result = left_operand;
                 return;
         }
     }
 }
 
-void Parser::primary() {
+void Parser::primary(expr_rec& operand) {
     token next = next_token();
     switch (next) {
         case token::LPAREN:
             /* <primary> ::= (<expression>) */
             match(token::LPAREN);
-            expression();
+            expression(operand);
             match(token::RPAREN);
             break;
         case token::ID:
             /* <primary> ::= ID */
-            match(token::ID);
+            ident(operand);
             break;
         case token::INTLITERAL:
-            /* <primary> ::= INTLITERAL */
+            /* <primary> ::= INTLITERAL #process_literal */
             match(token::INTLITERAL);
+            operand = Semantics::process_literal();
             break;
         default:
             syntax_error(next);
     }
 }
 
-void Parser::add_op() {
+void Parser::add_op(op_rec& op) {
     token next = next_token();
     switch(next) {
         case token::PLUSOP:
-            /* <add op> ::= PLUSOP */
+            /* <add op> ::= PLUSOP #process_op */
             match(token::PLUSOP);
+            op = Semantics::process_op();
             break;
         case token::MINUSOP:
-            /* <add op> ::= MINUSOP */
+            /* <add op> ::= MINUSOP #process_op */
             match(token::MINUSOP);
+            op = Semantics::process_op();
             break;
         default:
             syntax_error(next);
     }
 }
 
+void Parser::ident(expr_rec& id) {
+    /* <ident> ::= ID #process_id */
+    match(token::ID);
+    id = Semantics::process_id();
+}
+
 void Parser::match(token t) {
-    token next = scanner();
+    token next = peeked ? peeked_token : scanner();
+    peeked = false;
     if (t != next) {
         syntax_error(next);
     }
     current_token = next;
 }
 
-token Parser::next_token() {
-    token next = scanner();
+void Parser::syntax_error(token t) {
+    static const char* names[] = {
+        "begin", "end", "read", "write", "identifier", "literal", "(", ")", ";",
+        ",", ":=", "+", "-", "end of file"
+    };
+    throw std::runtime_error(std::string("Syntax error at ") + names[t]);
+}
 
-    switch (next) {
-        case token::BEGIN:
-        case token::END:
-        case token::ID:
-        case token::WRITE:
-        case token::READ:
-        case token::INTLITERAL:
-            for (int i = curr_buffer_idx - 1; i >= 0; i--) {
-                ungetc(token_buffer[i], stdin);
-            }
-            break;
-        case token::ASSIGNOP:
-            ungetc('=', stdin); ungetc(':', stdin);
-            break; 
-        case token::COMMA:
-            ungetc(',', stdin);
-            break;   
-        case token::LPAREN:
-            ungetc('(', stdin);
-            break;
-        case token::MINUSOP:
-            ungetc('-', stdin);
-            break;
-        case token::PLUSOP:
-            ungetc('+', stdin);
-            break;
-        case token::RPAREN:
-            ungetc(')', stdin);
-            break;
-        case token::SEMICOLON:
-            ungetc(';', stdin);
-            break;
+token Parser::next_token() {
+    if (!peeked) {
+        peeked_token = scanner();
+        peeked = true;
     }
-
-    return next;
-}
\ No newline at end of file
+    return peeked_token;
+}
@@ -2,6 +2,7 @@
 #define _PARSER_H_
 
 #include "Scanner.h"
+#include "Semantics.h"
 
 namespace Parser {
     void system_goal();
@@ -10,9 +11,10 @@ namespace Parser {
     void statement();
     void id_list();
     void expr_list();
-    void expression();
-    void primary();
-    void add_op();
+    void expression(expr_rec& result);
+    void primary(expr_rec& operand);
+    void add_op(op_rec& op);
+    void ident(expr_rec& id);
     void match(token t);
     token next_token();
     void syntax_error(token t);
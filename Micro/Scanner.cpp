@@ -1,9 +1,38 @@
 #include <stdio.h>
-#include <ctype.h>
 #include <stdexcept>
+#include <string>
 #include <string.h>
 #include "Scanner.h"
 
+// Character classes, looked up with a single load instead of <ctype.h>
+enum char_class : unsigned char {
+    SPACE = 1, LETTER = 2, DIGIT = 4, UNDERSCORE = 8
+};
+
+struct class_table {
+    unsigned char classes[256] = {};
+
+    constexpr void add(const char* chars, unsigned char cls) {
+        for (; *chars; chars++) {
+            classes[(unsigned char)*chars] |= cls;
+        }
+    }
+
+    constexpr class_table() {
+        add(" \t\n\v\f\r", SPACE);
+        add("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ", LETTER);
+        add("0123456789", DIGIT);
+        add("_", UNDERSCORE);
+    }
+};
+
+static constexpr class_table char_classes;
+
+// EOF has no class
+static inline bool is_class(int c, unsigned char mask) {
+    return c >= 0 && (char_classes.classes[(unsigned char)c] & mask);
+}
+
 char token_buffer[32];
 int curr_buffer_idx = 0;
 
@@ -32,7 +61,7 @@ token check_reserved() {
 
 void lexical_error(int c) {
     if (c == -2) { throw std::runtime_error("Identifier is too long"); }
-    throw std::runtime_error("Unidentified character: " + char(c));
+    throw std::runtime_error(std::string("Unidentified character: ") + char(c));
 }
 
 token scanner() {
@@ -44,9 +73,9 @@ token scanner() {
     }
 
     while ((in_char = getchar()) != EOF) {
-        if (isspace(in_char)) { // Skip whitespace
+        if (is_class(in_char, SPACE)) { // Skip whitespace
             continue;
-        } else if (isalpha(in_char)) {
+        } else if (is_class(in_char, LETTER)) {
             /*
              * ID ::= LETTER | ID LETTER
              *               | ID DIGIT
@@ -54,19 +83,19 @@ token scanner() {
              */
             buffer_char(in_char);
 
-            for (c = getchar(); isalnum(c) || c == '_'; c = getchar()) {
+            for (c = getchar(); is_class(c, LETTER | DIGIT | UNDERSCORE); c = getchar()) {
                 buffer_char(c);
             }
 
             ungetc(c, stdin);
             return check_reserved();
-        } else if (isdigit(in_char)) {
+        } else if (is_class(in_char, DIGIT)) {
             /*
              * INTLITERAL ::= DIGIT | INTLITERAL DIGIT
              */
             buffer_char(in_char);
 
-            for (c = getchar(); isdigit(c); c = getchar()) {
+            for (c = getchar(); is_class(c, DIGIT); c = getchar()) {
                 buffer_char(c);
             }
 
@@ -95,7 +124,7 @@ token scanner() {
             // Looking for --, comment start
             c = getchar();
             if (c == '-') {
-                while ((in_char = getchar()) != '\n');
+                while ((in_char = getchar()) != '\n' && in_char != EOF);
             } else {
                 ungetc(c, stdin);
                 return MINUSOP;
@@ -0,0 +1,124 @@
+#include <string.h>
+#include <unordered_set>
+#include "Scanner.h"
+#include "Semantics.h"
+
+extern token current_token;
+extern char token_buffer[];
+extern int curr_buffer_idx;
+
+// Output is gathered here and written a block at a time, rather than with a
+// printf per instruction
+static const size_t OUTPUT_SIZE = 1 << 16;
+static char output_buffer[OUTPUT_SIZE];
+static size_t output_used = 0;
+static FILE* output = nullptr;
+
+// Every variable and temporary declared so far
+static std::unordered_set<std::string> symbol_table;
+static int max_temp = 0;
+
+void Semantics::set_output(FILE* out) {
+    output = out;
+}
+
+void Semantics::flush() {
+    if (output_used > 0) {
+        fwrite(output_buffer, 1, output_used, output ? output : stdout);
+        output_used = 0;
+    }
+}
+
+static void emit(const char* s, size_t length) {
+    if (output_used + length > OUTPUT_SIZE) {
+        Semantics::flush();
+        if (length > OUTPUT_SIZE) {
+            fwrite(s, 1, length, output ? output : stdout);
+            return;
+        }
+    }
+    memcpy(output_buffer + output_used, s, length);
+    output_used += length;
+}
+
+static void emit(const std::string& s) {
+    emit(s.data(), s.size());
+}
+
+// OP A,B,C, leaving out operands that are not used
+static void generate(const char* op, const std::string& a = "", const std::string& b = "", const std::string& c = "") {
+    emit(op, strlen(op));
+    const std::string* operands[] = {&a, &b, &c};
+    int used = c.empty() ? (b.empty() ? (a.empty() ? 0 : 1) : 2) : 3;
+    for (int i = 0; i < used; i++) {
+        emit(i == 0 ? " " : ",", 1);
+        emit(*operands[i]);
+    }
+    emit("\n", 1);
+}
+
+// Declare s the first time it is seen; all variables are integers
+static void check_id(const std::string& s) {
+    if (symbol_table.insert(s).second) {
+        generate("Declare", s, "Integer");
+    }
+}
+
+static std::string get_temp() {
+    std::string name = "Temp&" + std::to_string(++max_temp);
+    check_id(name);
+    return name;
+}
+
+// The operand an expression record stands for
+static const std::string& extract(const expr_rec& e) {
+    return e.name;
+}
+
+static const char* extract(op_rec op) {
+    return op.op == PLUS ? "Add" : "Sub";
+}
+
+void Semantics::start() {
+    symbol_table.clear();
+    max_temp = 0;
+    output_used = 0;
+}
+
+void Semantics::finish() {
+    generate("Halt");
+    flush();
+}
+
+void Semantics::assign(const expr_rec& target, const expr_rec& source) {
+    generate("Store", extract(source), target.name);
+}
+
+void Semantics::read_id(const expr_rec& in_var) {
+    generate("Read", in_var.name, "Integer");
+}
+
+void Semantics::write_expr(const expr_rec& out_expr) {
+    generate("Write", extract(out_expr), "Integer");
+}
+
+expr_rec Semantics::gen_infix(const expr_rec& e1, op_rec op, const expr_rec& e2) {
+    expr_rec e_rec{TEMPEXPR, get_temp()};
+    generate(extract(op), extract(e1), extract(e2), e_rec.name);
+    return e_rec;
+}
+
+op_rec Semantics::process_op() {
+    return op_rec{current_token == PLUSOP ? PLUS : MINUS};
+}
+
+// token_buffer is not terminated when the lexeme fills it
+expr_rec Semantics::process_id() {
+    expr_rec e_rec{IDEXPR, std::string(token_buffer, curr_buffer_idx)};
+    check_id(e_rec.name);
+    return e_rec;
+}
+
+expr_rec Semantics::process_literal() {
+    return expr_rec{LITERALEXPR, std::string(token_buffer, curr_buffer_idx)};
+}
@@ -0,0 +1,43 @@
+#ifndef _SEMANTICS_H_
+#define _SEMANTICS_H_
+
+#include <stdio.h>
+#include <string>
+
+// Semantic records, passed between the parsing routines
+enum op_kind { PLUS, MINUS };
+
+struct op_rec {
+    op_kind op;
+};
+
+enum expr_kind { IDEXPR, LITERALEXPR, TEMPEXPR };
+
+struct expr_rec {
+    expr_kind kind;
+    std::string name;   // Variable or temporary, or the digits of a literal
+};
+
+// The semantic routines called by the parser. Each writes its three-address
+// instructions, OP A,B,C, to a buffer that goes out in large blocks
+namespace Semantics {
+    // Where the code goes, stdout unless set before start()
+    void set_output(FILE* out);
+
+    void start();
+    void finish();
+    void assign(const expr_rec& target, const expr_rec& source);
+    void read_id(const expr_rec& in_var);
+    void write_expr(const expr_rec& out_expr);
+    expr_rec gen_infix(const expr_rec& e1, op_rec op, const expr_rec& e2);
+
+    // Records for the token just matched
+    op_rec process_op();
+    expr_rec process_id();
+    expr_rec process_literal();
+
+    // Write out what is buffered
+    void flush();
+};
+
+#endif
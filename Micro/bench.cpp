@@ -0,0 +1,131 @@
+#include <chrono>
+#include <functional>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "Parser.h"
+#include "Scanner.h"
+#include "Semantics.h"
+
+using Clock = std::chrono::steady_clock;
+
+extern char token_buffer[];
+extern int curr_buffer_idx;
+
+static const char* INPUT = "bench-input.txt";
+
+// Keep results observable so the optimizer cannot drop timed loops
+static volatile size_t sink;
+
+template <typename F>
+static double timeIt(F f) {
+    Clock::time_point start = Clock::now();
+    f();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A Micro program of about the given size: reads, writes and assignments
+// with nested expressions, over a few hundred variables, and some comments
+static std::string generate_program(size_t bytes) {
+    std::mt19937 rng(7);
+    std::string text = "begin\n";
+    auto name = [&] { return "var_" + std::to_string(rng() % 400); };
+    std::function<std::string(int)> expression = [&](int depth) {
+        std::string e = rng() % 3 == 0 ? std::to_string(rng() % 100000) : name();
+        for (int terms = rng() % 4; terms > 0; terms--) {
+            e += rng() % 2 ? " + " : " - ";
+            e += depth < 2 && rng() % 4 == 0 ? "(" + expression(depth + 1) + ")" : name();
+        }
+        return e;
+    };
+    while (text.size() < bytes) {
+        switch (rng() % 8) {
+            case 0:
+                text += "    read(" + name() + ", " + name() + ");\n";
+                break;
+            case 1:
+                text += "    write(" + expression(0) + ", " + expression(0) + ");\n";
+                break;
+            case 2:
+                text += "    -- " + name() + " is updated below\n";
+                break;
+            default:
+                text += "    " + name() + " := " + expression(0) + ";\n";
+                break;
+        }
+    }
+    return text + "end\n";
+}
+
+static void reopen_input() {
+    if (!freopen(INPUT, "r", stdin)) {
+        perror(INPUT);
+    }
+}
+
+// The parser's lookahead before it kept a peeked token: scan, push the
+// lexeme back with ungetc, and scan it again when it is matched
+static token rescan_next_token() {
+    static const char punctuation[] = {'(', ')', ';', ',', '=', '+', '-'};
+    token next = scanner();
+    if (next == ASSIGNOP) {
+        ungetc('=', stdin);
+        ungetc(':', stdin);
+    } else if (next >= LPAREN && next <= MINUSOP) {
+        ungetc(punctuation[next - LPAREN], stdin);
+    } else if (next != SCANEOF) {
+        for (int i = curr_buffer_idx - 1; i >= 0; i--) {
+            ungetc(token_buffer[i], stdin);
+        }
+    }
+    return next;
+}
+
+// Scanning every token once, as the parser does now, against looking at
+// each one first and scanning it again
+static void bench_scan(size_t bytes) {
+    size_t tokens = 0;
+    reopen_input();
+    double once = timeIt([&] {
+        while (scanner() != SCANEOF) {
+            tokens++;
+        }
+    });
+
+    size_t rescanned = 0;
+    reopen_input();
+    double twice = timeIt([&] {
+        while (rescan_next_token() != SCANEOF) {
+            scanner();
+            rescanned++;
+        }
+    });
+    sink = tokens + rescanned;
+
+    printf("scan: %zu tokens; once %.1f ms (%.0f MB/s), rescanned %.1f ms (%.0f MB/s), %.2fx\n", tokens,
+           once * 1e3, bytes / once / 1e6, twice * 1e3, bytes / twice / 1e6, twice / once);
+}
+
+// The whole compiler, source to three-address code, with the code thrown away
+static void bench_compile(size_t bytes) {
+    FILE* null = fopen("/dev/null", "w");
+    Semantics::set_output(null);
+    reopen_input();
+    double seconds = timeIt([] { Parser::system_goal(); });
+    Semantics::set_output(nullptr);
+    fclose(null);
+    printf("compile: %.1f ms (%.0f MB/s)\n", seconds * 1e3, bytes / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+    size_t bytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8 << 20;
+    std::string text = generate_program(bytes);
+    FILE* f = fopen(INPUT, "w");
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+
+    bench_scan(text.size());
+    bench_compile(text.size());
+    remove(INPUT);
+}
@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include <stdexcept>
+#include "Parser.h"
+
+// Compile the Micro program on stdin to three-address code on stdout
+int main() {
+    try {
+        Parser::system_goal();
+    } catch (const std::runtime_error& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}